@@ -0,0 +1,206 @@
+#include "ams_app.h"
+#include <string.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "ams_conn_params.h"
+
+#define MESSAGE_BUFFER_SIZE                 128                                               /**< Size of the buffer receiving the full value of truncated attributes. */
+#define TRACK_QUIET_INTERVAL_MS             500                                               /**< Time without Track updates after which a partially updated track is reported. */
+#define FAST_MIN_CONN_INTERVAL              MSEC_TO_UNITS(20, UNIT_1_25_MS)                   /**< Minimum acceptable connection interval while AMS is busy (20 ms). */
+#define FAST_MAX_CONN_INTERVAL              MSEC_TO_UNITS(40, UNIT_1_25_MS)                   /**< Maximum acceptable connection interval while AMS is busy (40 ms). */
+#define FAST_SLAVE_LATENCY                  0                                                 /**< Slave latency while AMS is busy. */
+#define AMS_IDLE_DELAY_MS                   2000                                              /**< Time AMS must stay idle before the idle connection parameters are requested. */
+
+static ble_ams_c_t                      m_ams_c;
+static uint8_t                          m_apple_message_buffer[MESSAGE_BUFFER_SIZE];
+static ble_ams_c_evt_handler_t          m_evt_handler;                                    /**< Event handler of the user, may be NULL. */
+static dm_handle_t                      m_peer_handle;                                    /**< Identifes the peer that is currently connected. */
+static bool                             m_link_secured = false;                           /**< Whether the link to the current peer is encrypted. */
+
+/**@brief Function for subscribing to the media information and the supported commands.
+ *
+ * @details All writes are queued at once and pipelined by the AMS client.
+ */
+static void ams_subscribe(void)
+{
+    static const uint8_t player_attrs[] =
+    {
+        BLE_AMS_PLAYER_ATTRIBUTE_ID_NAME,
+        BLE_AMS_PLAYER_ATTRIBUTE_ID_PLAYBACK_INFO,
+        BLE_AMS_PLAYER_ATTRIBUTE_ID_VOLUME
+    };
+    static const uint8_t queue_attrs[] =
+    {
+        BLE_AMS_QUEUE_ATTRIBUTE_ID_INDEX,
+        BLE_AMS_QUEUE_ATTRIBUTE_ID_COUNT,
+        BLE_AMS_QUEUE_ATTRIBUTE_ID_SHUFFLE_MODE,
+        BLE_AMS_QUEUE_ATTRIBUTE_ID_REPEAT_MODE
+    };
+    static const uint8_t track_attrs[] =
+    {
+        BLE_AMS_TRACK_ATTRIBUTE_ID_ARTIST,
+        BLE_AMS_TRACK_ATTRIBUTE_ID_ALBUM,
+        BLE_AMS_TRACK_ATTRIBUTE_ID_TITLE,
+        BLE_AMS_TRACK_ATTRIBUTE_ID_DURATION
+    };
+    uint32_t err_code;
+
+    err_code = ble_ams_c_enable_notif_remote_control(&m_ams_c);
+    if (err_code == NRF_ERROR_INVALID_STATE)
+    {
+        // AMS has not been discovered on this master (yet).
+        return;
+    }
+    APP_ERROR_CHECK(err_code);
+
+    err_code = ble_ams_c_entity_update_subscribe(&m_ams_c,
+                                                 BLE_AMS_ENTITY_ID_TRACK,
+                                                 track_attrs,
+                                                 sizeof(track_attrs));
+    APP_ERROR_CHECK(err_code);
+
+    err_code = ble_ams_c_entity_update_subscribe(&m_ams_c,
+                                                 BLE_AMS_ENTITY_ID_QUEUE,
+                                                 queue_attrs,
+                                                 sizeof(queue_attrs));
+    APP_ERROR_CHECK(err_code);
+
+    err_code = ble_ams_c_entity_update_subscribe(&m_ams_c,
+                                                 BLE_AMS_ENTITY_ID_PLAYER,
+                                                 player_attrs,
+                                                 sizeof(player_attrs));
+    APP_ERROR_CHECK(err_code);
+}
+
+static void on_ams_c_evt(ble_ams_c_evt_t * p_evt)
+{
+    uint32_t err_code;
+
+    switch (p_evt->evt_type)
+    {
+        case BLE_AMS_C_EVT_DISCOVER_COMPLETE:
+            if (m_link_secured)
+            {
+                ams_subscribe();
+            }
+            else
+            {
+                // AMS requires an encrypted link, subscribe once it is secured.
+                err_code = dm_security_setup_req(&m_peer_handle);
+                APP_ERROR_CHECK(err_code);
+            }
+            break;
+
+        case BLE_AMS_C_EVT_ACTIVITY_CHANGED:
+            ams_conn_params_on_activity(p_evt->data.busy);
+            break;
+
+        default:
+            //No implementation needed
+            break;
+    }
+
+    if (m_evt_handler != NULL)
+    {
+        m_evt_handler(p_evt);
+    }
+}
+
+static void apple_notification_error_handler(uint32_t nrf_error)
+{
+    APP_ERROR_HANDLER(nrf_error);
+}
+
+/**@brief Function for initializing the controller switching the connection parameters with the
+ *        AMS activity.
+ */
+static void conn_params_init(uint32_t timer_prescaler)
+{
+    ams_conn_params_init_t ctrl_init;
+    uint32_t               err_code;
+
+    // The preferred parameters change with the AMS activity, a refused request is not fatal.
+    ctrl_init.fast_params.min_conn_interval = FAST_MIN_CONN_INTERVAL;
+    ctrl_init.fast_params.max_conn_interval = FAST_MAX_CONN_INTERVAL;
+    ctrl_init.fast_params.slave_latency     = FAST_SLAVE_LATENCY;
+    ctrl_init.fast_params.conn_sup_timeout  = AMS_APP_CONN_SUP_TIMEOUT;
+    ctrl_init.idle_params.min_conn_interval = AMS_APP_IDLE_MIN_CONN_INTERVAL;
+    ctrl_init.idle_params.max_conn_interval = AMS_APP_IDLE_MAX_CONN_INTERVAL;
+    ctrl_init.idle_params.slave_latency     = AMS_APP_IDLE_SLAVE_LATENCY;
+    ctrl_init.idle_params.conn_sup_timeout  = AMS_APP_CONN_SUP_TIMEOUT;
+    ctrl_init.idle_delay                    = APP_TIMER_TICKS(AMS_IDLE_DELAY_MS, timer_prescaler);
+
+    err_code = ams_conn_params_init(&ctrl_init);
+    APP_ERROR_CHECK(err_code);
+}
+
+void ams_app_init(const ams_app_init_t * p_init)
+{
+    ble_ams_c_init_t ams_init_obj;
+    uint32_t         err_code;
+
+    m_evt_handler  = p_init->evt_handler;
+    m_link_secured = false;
+
+    memset(&ams_init_obj, 0, sizeof(ams_init_obj));
+    memset(m_apple_message_buffer, 0, MESSAGE_BUFFER_SIZE);
+
+    ams_init_obj.evt_handler         = on_ams_c_evt;
+    ams_init_obj.message_buffer_size = MESSAGE_BUFFER_SIZE;
+    ams_init_obj.p_message_buffer    = m_apple_message_buffer;
+    ams_init_obj.error_handler       = apple_notification_error_handler;
+    ams_init_obj.timer_prescaler     = p_init->timer_prescaler;
+    ams_init_obj.track_quiet_ticks   = APP_TIMER_TICKS(TRACK_QUIET_INTERVAL_MS, p_init->timer_prescaler);
+    ams_init_obj.hvx_deferred        = true;
+    ams_init_obj.latency_policy      = BLE_AMS_C_LATENCY_POLICY_WAKE_ON_ACTIVITY;
+    ams_init_obj.idle_local_latency  = AMS_APP_IDLE_LOCAL_LATENCY;
+
+    err_code = ble_ams_c_init(&m_ams_c, &ams_init_obj);
+    APP_ERROR_CHECK(err_code);
+
+    conn_params_init(p_init->timer_prescaler);
+}
+
+ble_ams_c_t * ams_app_client_get(void)
+{
+    return &m_ams_c;
+}
+
+void ams_app_on_ble_evt(ble_evt_t * p_ble_evt)
+{
+    uint32_t err_code;
+
+    ams_conn_params_on_ble_evt(p_ble_evt);
+    ble_ams_c_on_ble_evt(&m_ams_c, p_ble_evt);
+
+    if (p_ble_evt->header.evt_id == BLE_GAP_EVT_DISCONNECTED)
+    {
+        // Only a record that changed during the connection is written.
+        err_code = ble_ams_c_service_store(&m_ams_c);
+        APP_ERROR_CHECK(err_code);
+    }
+}
+
+void ams_app_on_dm_evt(dm_handle_t const * p_handle, dm_event_t const * p_event)
+{
+    switch (p_event->event_id)
+    {
+        case DM_EVT_CONNECTION:
+            m_peer_handle = (*p_handle);
+            break;
+
+        case DM_EVT_LINK_SECURED:
+            m_link_secured = true;
+            ams_subscribe();
+            break;
+
+        case DM_EVT_DISCONNECTION:
+            m_link_secured = false;
+            break;
+    }
+
+    // After the switch, the client may complete discovery from its cache on DM_EVT_LINK_SECURED.
+    ble_ams_c_on_device_manager_evt(&m_ams_c, p_handle, p_event);
+}
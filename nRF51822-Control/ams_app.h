@@ -0,0 +1,61 @@
+#ifndef AMS_APP_H__
+#define AMS_APP_H__
+
+#include <stdint.h>
+#include "ble.h"
+#include "app_util.h"
+#include "device_manager.h"
+#include "ble_ams_c.h"
+
+/**@file
+ *
+ * @brief Use of the AMS client by the example application.
+ *
+ * @details Initializes the AMS client and the connection parameter controller, secures the link
+ *          once AMS is discovered, subscribes to the media information once the link is secured
+ *          and stores the service record on disconnection. The firmware and the host benchmarks
+ *          both build this file, so the benchmarks run the application as it is flashed.
+ */
+
+#define AMS_APP_IDLE_MIN_CONN_INTERVAL      MSEC_TO_UNITS(300, UNIT_1_25_MS)                  /**< Minimum acceptable connection interval while AMS is idle (300 ms). */
+#define AMS_APP_IDLE_MAX_CONN_INTERVAL      MSEC_TO_UNITS(320, UNIT_1_25_MS)                  /**< Maximum acceptable connection interval while AMS is idle (320 ms). */
+#define AMS_APP_IDLE_SLAVE_LATENCY          3                                                 /**< Slave latency while AMS is idle. */
+#define AMS_APP_IDLE_LOCAL_LATENCY          (2 * AMS_APP_IDLE_SLAVE_LATENCY)                  /**< Local connection latency while AMS is idle, a multiple of the slave latency within half the supervision timeout. */
+#define AMS_APP_CONN_SUP_TIMEOUT            MSEC_TO_UNITS(6000, UNIT_10_MS)                   /**< Connection supervisory timeout (6 seconds, the longest iOS accepts). */
+
+/**@brief AMS application init structure. */
+typedef struct
+{
+    uint32_t                            timer_prescaler;                                  /**< Value of the RTC1 PRESCALER register app_timer runs with. */
+    ble_ams_c_evt_handler_t             evt_handler;                                      /**< Called with every client event once the application has handled it. May be NULL. */
+} ams_app_init_t;
+
+/**@brief Function for initializing the AMS client and the connection parameter controller.
+ *
+ * @details app_timer must be initialized first, the Connection Parameters module before the
+ *          first connection.
+ *
+ * @param[in]   p_init       Init structure.
+ */
+void ams_app_init(const ams_app_init_t * p_init);
+
+/**@brief Function for getting the AMS client instance, e.g. to send remote commands. */
+ble_ams_c_t * ams_app_client_get(void);
+
+/**@brief Function for handling the Application's BLE Stack events.
+ *
+ *
+ * @details Call after ble_conn_params_on_ble_evt.
+ *
+ * @param[in]   p_ble_evt    Event received from the BLE stack.
+ */
+void ams_app_on_ble_evt(ble_evt_t * p_ble_evt);
+
+/**@brief Function for handling the Device Manager events.
+ *
+ * @param[in]   p_handle     Device Manager handle of the peer.
+ * @param[in]   p_event      Device Manager event.
+ */
+void ams_app_on_dm_evt(dm_handle_t const * p_handle, dm_event_t const * p_event);
+
+#endif // AMS_APP_H__
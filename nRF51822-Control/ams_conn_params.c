@@ -0,0 +1,92 @@
+#include "ams_conn_params.h"
+#include <stddef.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "ble_conn_params.h"
+#include "app_timer.h"
+
+static ams_conn_params_init_t   m_init;                                                   /**< Parameters to switch between. */
+static app_timer_id_t           m_idle_timer_id;                                          /**< Timer measuring how long the AMS client has been idle. */
+static uint16_t                 m_conn_handle   = BLE_CONN_HANDLE_INVALID;                /**< Handle of the current connection. */
+static bool                     m_fast_wanted   = false;                                  /**< Whether the fast parameters should be in use. */
+static bool                     m_fast_set      = false;                                  /**< Whether the fast parameters are the preferred ones in ble_conn_params. */
+
+/**@brief Function for making the wanted parameters the preferred ones, which starts the
+ *        negotiation with the master if the current ones do not fit.
+ *
+ * @details A request refused while another update is in progress is retried on the next
+ *          BLE_GAP_EVT_CONN_PARAM_UPDATE.
+ */
+static void params_request(void)
+{
+    if ((m_conn_handle == BLE_CONN_HANDLE_INVALID) || (m_fast_wanted == m_fast_set))
+    {
+        return;
+    }
+
+    if (ble_conn_params_change_conn_params(m_fast_wanted ? &m_init.fast_params
+                                                         : &m_init.idle_params) == NRF_SUCCESS)
+    {
+        m_fast_set = m_fast_wanted;
+    }
+}
+
+/**@brief Function for handling the end of the idle delay.
+ */
+static void idle_timeout_handler(void * p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    m_fast_wanted = false;
+    params_request();
+}
+
+uint32_t ams_conn_params_init(const ams_conn_params_init_t * p_init)
+{
+    m_init        = *p_init;
+    m_conn_handle = BLE_CONN_HANDLE_INVALID;
+    m_fast_wanted = false;
+    m_fast_set    = false;
+
+    return app_timer_create(&m_idle_timer_id, APP_TIMER_MODE_SINGLE_SHOT, idle_timeout_handler);
+}
+
+void ams_conn_params_on_ble_evt(const ble_evt_t * p_ble_evt)
+{
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GAP_EVT_CONNECTED:
+            m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            break;
+
+        case BLE_GAP_EVT_DISCONNECTED:
+            m_conn_handle = BLE_CONN_HANDLE_INVALID;
+            m_fast_wanted = false;
+            (void)app_timer_stop(m_idle_timer_id);
+            break;
+
+        case BLE_GAP_EVT_CONN_PARAM_UPDATE:
+            params_request();
+            break;
+
+        default:
+            // No implementation needed.
+            break;
+    }
+}
+
+void ams_conn_params_on_activity(bool busy)
+{
+    (void)app_timer_stop(m_idle_timer_id);
+
+    if (busy)
+    {
+        m_fast_wanted = true;
+        params_request();
+    }
+    else if (m_fast_wanted)
+    {
+        // Stay fast for a while, the next command or read often follows shortly.
+        (void)app_timer_start(m_idle_timer_id, m_init.idle_delay, NULL);
+    }
+}
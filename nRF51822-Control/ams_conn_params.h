@@ -0,0 +1,49 @@
+#ifndef AMS_CONN_PARAMS_H__
+#define AMS_CONN_PARAMS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "ble_gap.h"
+
+/**@file
+ *
+ * @brief Connection parameter controller following the activity of the AMS client.
+ *
+ * @details A short connection interval is requested as soon as the client starts exchanging
+ *          data with the master (discovery, subscriptions, long reads, remote commands), and a
+ *          long interval with slave latency once it has been idle for a while. The requests go
+ *          through the @ref ble_sdk_lib_conn_params module, which must be initialized first.
+ */
+
+/**@brief Connection parameter controller init structure. */
+typedef struct
+{
+    ble_gap_conn_params_t               fast_params;                                      /**< Parameters requested while the AMS client is busy. */
+    ble_gap_conn_params_t               idle_params;                                      /**< Parameters requested once the AMS client has been idle for idle_delay. */
+    uint32_t                            idle_delay;                                       /**< app_timer ticks the client must stay idle before idle_params are requested. */
+} ams_conn_params_init_t;
+
+/**@brief Function for initializing the connection parameter controller.
+ *
+ * @param[in]   p_init       Parameters to switch between, copied by the controller.
+ *
+ * @return      NRF_SUCCESS on success, otherwise the error from app_timer_create.
+ */
+uint32_t ams_conn_params_init(const ams_conn_params_init_t * p_init);
+
+/**@brief Function for handling the Application's BLE Stack events.
+ *
+ * @details Call after ble_conn_params_on_ble_evt.
+ *
+ * @param[in]   p_ble_evt    Event received from the BLE stack.
+ */
+void ams_conn_params_on_ble_evt(const ble_evt_t * p_ble_evt);
+
+/**@brief Function for passing BLE_AMS_C_EVT_ACTIVITY_CHANGED to the controller.
+ *
+ * @param[in]   busy         Whether the AMS client is exchanging data with the master.
+ */
+void ams_conn_params_on_activity(bool busy);
+
+#endif // AMS_CONN_PARAMS_H__
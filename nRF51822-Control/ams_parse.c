@@ -0,0 +1,126 @@
+#include "ams_parse.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include "nrf_error.h"
+
+#define MILLI_INTEGER_MAX                   ((uint32_t)INT32_MAX / 10)                        /**< Largest value in thousandths that another integer digit can be appended to without wrapping. */
+
+uint32_t ams_parse_milli(const uint8_t * p_text,
+                         uint16_t        len,
+                         char            separator,
+                         int32_t *       p_milli,
+                         uint16_t *      p_consumed)
+{
+    uint32_t value    = 0;
+    uint32_t scale    = 1000;
+    uint16_t index    = 0;
+    bool     negative = false;
+    bool     digits   = false;
+    bool     fraction = false;
+
+    if ((len > 0) && (p_text[0] == '-'))
+    {
+        negative = true;
+        index++;
+    }
+
+    for (; (index < len) && (p_text[index] != (uint8_t)separator); index++)
+    {
+        uint8_t digit = (uint8_t)(p_text[index] - '0');
+
+        if (index >= AMS_PARSE_FIELD_MAX_LENGTH)
+        {
+            return NRF_ERROR_DATA_SIZE;
+        }
+
+        if (digit <= 9)
+        {
+            digits = true;
+            if (!fraction)
+            {
+                if (value > MILLI_INTEGER_MAX)
+                {
+                    return NRF_ERROR_DATA_SIZE;
+                }
+                value = value * 10 + digit * 1000;
+            }
+            else
+            {
+                // Scale reaches zero after the third decimal, further digits add nothing.
+                scale /= 10;
+                value += digit * scale;
+            }
+
+            if (value > INT32_MAX)
+            {
+                return NRF_ERROR_DATA_SIZE;
+            }
+        }
+        else if ((p_text[index] == '.') && !fraction)
+        {
+            fraction = true;
+        }
+        else
+        {
+            return NRF_ERROR_INVALID_DATA;
+        }
+    }
+
+    if (!digits)
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    *p_milli = negative ? -(int32_t)value : (int32_t)value;
+
+    if (p_consumed != NULL)
+    {
+        *p_consumed = (index < len) ? (index + 1) : index;
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t ams_parse_milli_list(const uint8_t * p_text,
+                              uint16_t        len,
+                              char            separator,
+                              int32_t *       p_values,
+                              uint8_t         count)
+{
+    uint16_t consumed;
+    uint8_t  i;
+
+    for (i = 0; i < count; i++)
+    {
+        uint32_t err_code = ams_parse_milli(p_text, len, separator, &p_values[i], &consumed);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+
+        p_text += consumed;
+        len    -= consumed;
+    }
+
+    return NRF_SUCCESS;
+}
+
+uint32_t ams_parse_permille(const uint8_t * p_text, uint16_t len, uint16_t * p_permille)
+{
+    int32_t  value;
+    uint32_t err_code;
+
+    err_code = ams_parse_milli(p_text, len, AMS_PARSE_SEPARATOR_NONE, &value, NULL);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    if ((value < 0) || (value > 1000))
+    {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    *p_permille = (uint16_t)value;
+    return NRF_SUCCESS;
+}
@@ -0,0 +1,71 @@
+#ifndef AMS_PARSE_H__
+#define AMS_PARSE_H__
+
+#include <stdint.h>
+
+/**@file
+ *
+ * @brief Integer only parsers for the decimal strings sent by the Apple Media Service.
+ *
+ * @details AMS sends numeric attributes as text, e.g. "0.5957915" for Player/Volume, "201.990"
+ *          for Track/Duration and "1,1.0,16.127" for Player/PlaybackInfo. These functions turn
+ *          them into thousandths (milliseconds, per mille, rate x 1000) without floating point.
+ *          Digits past the third decimal are checked but truncated.
+ */
+
+#ifndef AMS_PARSE_FIELD_MAX_LENGTH
+#define AMS_PARSE_FIELD_MAX_LENGTH          24                                                /**< Maximum number of characters in one numeric field, longer fields are rejected. */
+#endif
+
+#define AMS_PARSE_SEPARATOR_NONE            '\0'                                              /**< Separator to pass when the whole text is a single field. */
+
+/**@brief Function for parsing one decimal field into thousandths.
+ *
+ * @param[in]   p_text      Text to parse, not NUL terminated.
+ * @param[in]   len         Number of characters in p_text.
+ * @param[in]   separator   Character ending the field, or AMS_PARSE_SEPARATOR_NONE.
+ * @param[out]  p_milli     Value of the field in thousandths.
+ * @param[out]  p_consumed  Number of characters used, including the separator. May be NULL.
+ *
+ * @retval NRF_SUCCESS              The field was parsed.
+ * @retval NRF_ERROR_INVALID_DATA   The field is empty or not a decimal number.
+ * @retval NRF_ERROR_DATA_SIZE      The field is too long, or its value does not fit.
+ */
+uint32_t ams_parse_milli(const uint8_t * p_text,
+                         uint16_t        len,
+                         char            separator,
+                         int32_t *       p_milli,
+                         uint16_t *      p_consumed);
+
+/**@brief Function for parsing a list of decimal fields, e.g. Player/PlaybackInfo, into
+ *        thousandths. Fields after the first count are ignored.
+ *
+ * @param[in]   p_text      Text to parse, not NUL terminated.
+ * @param[in]   len         Number of characters in p_text.
+ * @param[in]   separator   Character between fields.
+ * @param[out]  p_values    Array receiving count values in thousandths.
+ * @param[in]   count       Number of fields to parse.
+ *
+ * @retval NRF_SUCCESS              All fields were parsed.
+ * @retval NRF_ERROR_INVALID_DATA   A field is missing, empty or not a decimal number.
+ * @retval NRF_ERROR_DATA_SIZE      A field is too long, or its value does not fit.
+ */
+uint32_t ams_parse_milli_list(const uint8_t * p_text,
+                              uint16_t        len,
+                              char            separator,
+                              int32_t *       p_values,
+                              uint8_t         count);
+
+/**@brief Function for parsing a fraction between 0 and 1, e.g. Player/Volume, into per mille.
+ *
+ * @param[in]   p_text      Text to parse, not NUL terminated.
+ * @param[in]   len         Number of characters in p_text.
+ * @param[out]  p_permille  Value in the range 0 to 1000.
+ *
+ * @retval NRF_SUCCESS              The value was parsed.
+ * @retval NRF_ERROR_INVALID_DATA   The text is not a decimal number, or is outside 0 to 1.
+ * @retval NRF_ERROR_DATA_SIZE      The text is too long.
+ */
+uint32_t ams_parse_permille(const uint8_t * p_text, uint16_t len, uint16_t * p_permille);
+
+#endif // AMS_PARSE_H__
@@ -1,5 +1,6 @@
 #include "ble_ams_c.h"
 #include <string.h>
+#include <stddef.h>
 #include <stdbool.h>
 #include "ble_err.h"
 #include "ble_srv_common.h"
@@ -7,94 +8,67 @@
 #include "nrf_assert.h"
 #include "device_manager.h"
 #include "ble_flash.h"
-#include "pstorage.h"
 #include "nrf_gpio.h"
+#include "nrf.h"
+#include "nrf_soc.h"
+#include "app_util.h"
+#include "app_timer.h"
+#include "app_scheduler.h"
+#include "ams_parse.h"
 #include "app_error.h"
 #include "led.h"
 
 #define START_HANDLE_DISCOVER            0x0001
 #define BLE_AMS_MAX_DISCOVERED_CENTRALS  DEVICE_MANAGER_MAX_BONDS
-#define DISCOVERED_SERVICE_DB_SIZE \
-    CEIL_DIV(sizeof(apple_service_t) * BLE_AMS_MAX_DISCOVERED_CENTRALS, sizeof(uint32_t))
 
-#define TX_BUFFER_MASK                   0x07                                              /**< TX Buffer mask, must be a mask of contiguous zeroes, followed by contiguous sequence of ones: 000...111. */
-#define TX_BUFFER_SIZE                   (TX_BUFFER_MASK + 1)                              /**< Size of send buffer, which is 1 higher than the mask. */
-#define WRITE_MESSAGE_LENGTH             20                                                /**< Length of the write message for CCCD/remote command. */
-#define NOTIFICATION_DATA_LENGTH         2                                                 /**< The mandatory length of notification data. After the mandatory data, the optional message is located. */
+#define SERVICE_RECORD_VERSION               1                                             /**< Format version of ble_ams_c_service_record_t, bump when its layout changes. */
+#define SERVICE_RECORD_FLAG_VALID            0x01                                          /**< The record holds the handles of a complete discovery. */
+#define SERVICE_RECORD_FLAG_RC_WRITE_WO_RESP 0x02                                          /**< Remote Command may be written without response. */
 
-typedef enum
-{
-    READ_REQ = 1,                                                                          /**< Type identifying that this tx_message is a read request. */
-    WRITE_REQ                                                                              /**< Type identifying that this tx_message is a write request. */
-} ams_tx_request_t;
-
-typedef enum
-{
-    STATE_UNINITIALIZED,                                                                   /**< Uninitialized state of the internal state machine. */
-    STATE_IDLE,                                                                            /**< Idle state, this is the state when no master has connected to this device. */
-    STATE_DISC_SERV,                                                                       /**< A BLE master is connected and a service discovery is in progress. */
-    STATE_DISC_CHAR,                                                                       /**< A BLE master is connected and characteristic discovery is in progress. */
-    STATE_DISC_DESC,                                                                       /**< A BLE master is connected and descriptor discovery is in progress. */
-    STATE_RUNNING,                                                                         /**< A BLE master is connected and complete service discovery has been performed. */
-    STATE_WAITING_ENC,                                                                     /**< A previously bonded BLE master has re-connected and the service awaits the setup of an encrypted link. */
-    STATE_RUNNING_NOT_DISCOVERED,                                                          /**< A BLE master is connected and a service discovery is in progress. */
-} ams_state_t;
+#define SERVICE_RECORD(P_AMS)                (&(P_AMS)->service_context.record) /**< Service record held in the application context of an instance. */
 
-/* brief Structure used for holding the characteristic found during discovery process.
- */
-typedef struct
-{
-    ble_uuid_t               uuid;                                                         /**< UUID identifying this characteristic. */
-    ble_gatt_char_props_t    properties;                                                   /**< Properties for this characteristic. */
-    uint16_t                 handle_decl;                                                  /**< Characteristic Declaration Handle for this characteristic. */
-    uint16_t                 handle_value;                                                 /**< Value Handle for the value provided in this characteristic. */
-    uint16_t                 handle_cccd;                                                  /**< CCCD Handle value for this characteristic. BLE_AMS_INVALID_HANDLE if not present in the master. */
-} apple_characteristic_t;
+#define TX_BUFFER_SIZE                   BLE_AMS_C_TX_QUEUE_SIZE                           /**< Size of send buffer. */
+#define TX_BUFFER_MASK                   (TX_BUFFER_SIZE - 1)                              /**< TX Buffer mask, must be a mask of contiguous zeroes, followed by contiguous sequence of ones: 000...111. */
 
-/**@brief Structure used for holding the Apple Media Service found during discovery process.
- */
-typedef struct
-{
-    uint8_t                  handle;                                                       /**< Handle of Apple Media Service which identifies to which master this discovered service belongs. */
-    ble_gattc_service_t      service;                                                      /**< The GATT service holding the discovered Apple Media Service. */
-    apple_characteristic_t   remote_command;
-    apple_characteristic_t   entity_update;
-    apple_characteristic_t   entity_attribute;
-} apple_service_t;
+#if ((TX_BUFFER_SIZE & TX_BUFFER_MASK) != 0)
+#error "BLE_AMS_C_TX_QUEUE_SIZE must be a power of two."
+#endif
+#define CMD_RING_MASK                    (BLE_AMS_C_CMD_QUEUE_SIZE - 1)                    /**< Command queue mask. */
 
-/**@brief Structure for writing a message to the master, i.e. Remote Command or CCCD.
- */
-typedef struct
-{
-    uint8_t                  gattc_value[WRITE_MESSAGE_LENGTH];                            /**< The message to write. */
-    ble_gattc_write_params_t gattc_params;                                                 /**< GATTC parameters for this message. */
-} write_params_t;
+#if ((BLE_AMS_C_CMD_QUEUE_SIZE & CMD_RING_MASK) != 0)
+#error "BLE_AMS_C_CMD_QUEUE_SIZE must be a power of two."
+#endif
+#define ENTITY_ATTRIBUTE_CMD_LENGTH      2                                                 /**< Length of the EntityID/AttributeID pair written to the Entity Attribute characteristic. */
+#define ATT_READ_RSP_MAX_LENGTH          (GATT_MTU_SIZE_DEFAULT - 1)                       /**< Maximum value length in a (Blob) Read Response, a shorter response ends a long read. */
+#define PLAYBACK_INFO_SEPARATOR          ','                                               /**< Separator between state, rate and elapsed time in Player/PlaybackInfo. */
+#define PLAYBACK_INFO_FIELD_STATE        0                                                 /**< Index of the playback state in Player/PlaybackInfo. */
+#define PLAYBACK_INFO_FIELD_RATE         1                                                 /**< Index of the playback rate in Player/PlaybackInfo. */
+#define PLAYBACK_INFO_FIELD_ELAPSED      2                                                 /**< Index of the elapsed time in Player/PlaybackInfo. */
+#define PLAYBACK_INFO_FIELD_COUNT        3                                                 /**< Number of fields in Player/PlaybackInfo. */
+#define PLAYBACK_TICK_US_NUM             (1000000 / 64)                                    /**< An RTC tick is PLAYBACK_TICK_US_NUM / PLAYBACK_TICK_US_DEN microseconds. */
+#define PLAYBACK_TICK_US_DEN             (APP_TIMER_CLOCK_FREQ / 64)                       /**< See PLAYBACK_TICK_US_NUM. */
+#define PLAYBACK_REM_DEN                 (PLAYBACK_TICK_US_DEN * 1000)                     /**< Unit of elapsed_rem, per microsecond, including the rate in thousandths. */
+#define FNV1A_OFFSET_BASIS               2166136261UL                                      /**< Initial value of the 32 bit FNV-1a hash of the Track attributes. */
+#define FNV1A_PRIME                      16777619UL                                        /**< Multiplier of the 32 bit FNV-1a hash. */
+#define ENTITY_UPDATE_HEADER_LENGTH      3                                                 /**< EntityID, AttributeID and EntityUpdateFlags precede the value in an Entity Update notification. */
+#define SERVICE_CHANGED_CCCD_INDICATE    0x0002                                            /**< Service Changed CCCD value enabling indications. */
 
-/**@brief Structure for holding data to be transmitted to the connected master.
+/**@brief Structure describing a media state slot.
  */
 typedef struct
 {
-    uint16_t                 conn_handle;                                                  /**< Connection handle to be used when transmitting this message. */
-    ams_tx_request_t         type;                                                         /**< Type of this message, i.e. read or write message. */
-    union
-    {
-        uint16_t             read_handle;                                                  /**< Read request message. */
-        write_params_t       write_req;                                                    /**< Write request message. */
-    } req;
-} tx_message_t;
-
-static tx_message_t          m_tx_buffer[TX_BUFFER_SIZE];                                  /**< Transmit buffer for messages to be transmitted to the master. */
-static uint32_t              m_tx_insert_index = 0;                                        /**< Current index in the transmit buffer where next message should be inserted. */
-static uint32_t              m_tx_index = 0;                                               /**< Current index in the transmit buffer from where the next message to be transmitted resides. */
-static pstorage_handle_t     m_flash_handle;                                               /**< Flash handle where discovered services for bonded masters should be stored. */
+    uint8_t *                p_len;                                                        /**< Length field of the slot. */
+    uint8_t *                p_flags;                                                      /**< Flags field of the slot. */
+    char *                   p_value;                                                      /**< Value field of the slot. */
+    uint8_t                  size;                                                         /**< Maximum value length of the slot, excluding the NUL terminator. */
+} state_slot_t;
 
-static ams_state_t           m_client_state = STATE_UNINITIALIZED;                          /**< Current state of the Apple Media State Machine. */
+STATIC_ASSERT(sizeof(ble_ams_c_service_record_t) <= DEVICE_MANAGER_APP_CONTEXT_SIZE);
 
-static uint32_t              m_service_db[DISCOVERED_SERVICE_DB_SIZE];                     /**< Service database for bonded masters (Word size aligned). */
-static apple_service_t *     mp_service_db;                                                /**< Pointer to start of discovered services database. */
-static apple_service_t       m_service;                                                    /**< Current service data. */
-
-static ble_ams_c_t *         m_ams_c_obj;                                                 /**< Pointer to the instantiated object. */
+static ble_ams_c_t *         m_instances[BLE_AMS_C_MAX_INSTANCES];                         /**< Initialized client instances, in order of initialization. */
+static uint8_t               m_instance_count = 0;                                         /**< Number of entries in m_instances. */
+static uint8_t               m_tx_buffer_total = 0;                                        /**< Stack TX buffers for write commands, as reported by the SoftDevice when no link is up. */
+static uint8_t               m_tx_buffer_count = 0;                                        /**< Stack TX buffers available for write commands, shared by all links like in the SoftDevice. */
 
 const ble_uuid128_t ble_ams_base_uuid128 =
 {
@@ -136,40 +110,393 @@ const ble_uuid128_t ble_ams_ea_base_uuid128 =
     }
 };
 
-/**@brief Function for passing any pending request from the buffer to the stack.
+/**@brief Function for passing pending messages from the buffer to the stack.
+ *
+ * @details Only one read or write request can await its response at a time, but write commands
+ *          only need a free stack TX buffer. Messages are passed in order until one of them has
+ *          to wait, so several write commands can go out in the same connection event. Remote
+ *          commands left in the command queue for want of room are moved on once room is made.
  */
-static void tx_buffer_process(void)
+static void tx_buffer_process(ble_ams_c_t * p_ams)
 {
-    if (m_tx_index != m_tx_insert_index)
+    uint32_t tx_index = p_ams->tx_index;
+    
+    while (p_ams->tx_index != p_ams->tx_insert_index)
     {
-        uint32_t err_code;
+        uint32_t       err_code;
+        ble_ams_c_tx_message_t * p_msg = &p_ams->tx_buffer[p_ams->tx_index & TX_BUFFER_MASK];
+        
+        if (p_msg->type == BLE_AMS_C_TX_WRITE_CMD)
+        {
+            if (m_tx_buffer_count == 0)
+            {
+                break;
+            }
+            err_code = sd_ble_gattc_write(p_msg->conn_handle,
+                                          &p_msg->req.write_req.gattc_params);
+            if (err_code == BLE_ERROR_NO_TX_BUFFERS)
+            {
+                // Taken by another link or by the GATT server, BLE_EVT_TX_COMPLETE returns them.
+                m_tx_buffer_count = 0;
+            }
+        }
+        else
+        {
+            if (p_ams->tx_request_pending)
+            {
+                break;
+            }
+            
+            if (p_msg->type == BLE_AMS_C_TX_READ_REQ)
+            {
+                err_code = sd_ble_gattc_read(p_msg->conn_handle,
+                                             p_msg->req.read_req.handle,
+                                             p_msg->req.read_req.offset);
+            }
+            else
+            {
+                err_code = sd_ble_gattc_write(p_msg->conn_handle,
+                                              &p_msg->req.write_req.gattc_params);
+            }
+        }
+        
+        if (err_code != NRF_SUCCESS)
+        {
+            break;
+        }
         
-        if (m_tx_buffer[m_tx_index].type == READ_REQ)
+        if (p_msg->type == BLE_AMS_C_TX_WRITE_CMD)
         {
-            err_code = sd_ble_gattc_read(m_tx_buffer[m_tx_index].conn_handle,
-                                         m_tx_buffer[m_tx_index].req.read_handle,
-                                         0);
+            m_tx_buffer_count--;
+            p_ams->tx_buffers_used++;
         }
         else
         {
-            err_code = sd_ble_gattc_write(m_tx_buffer[m_tx_index].conn_handle,
-                                          &m_tx_buffer[m_tx_index].req.write_req.gattc_params);
+            p_ams->tx_request_pending = true;
+        }
+        ++p_ams->tx_index;
+    }
+    
+    if ((p_ams->tx_index != tx_index) && (p_ams->cmd_get_index != p_ams->cmd_put_index))
+    {
+        NVIC_SetPendingIRQ(BLE_AMS_C_KICK_IRQn);
+    }
+}
+
+/**@brief Function for resetting the flow control towards the stack on a new connection.
+ *
+ * @details The stack TX buffers are shared by all links. Their count is only taken from the
+ *          SoftDevice when no other link is up, otherwise the other links hold some of them.
+ */
+static void tx_flow_reset(ble_ams_c_t * p_ams)
+{
+    uint32_t i;
+    
+    p_ams->tx_request_pending = false;
+    p_ams->tx_buffers_used    = 0;
+    
+    for (i = 0; i < m_instance_count; i++)
+    {
+        if ((m_instances[i] != p_ams) && (m_instances[i]->conn_handle != BLE_CONN_HANDLE_INVALID))
+        {
+            return;
+        }
+    }
+    
+    if (sd_ble_tx_buffer_count_get(&m_tx_buffer_total) != NRF_SUCCESS)
+    {
+        m_tx_buffer_total = 0;
+    }
+    m_tx_buffer_count = m_tx_buffer_total;
+}
+
+/**@brief Function for taking back stack TX buffers and passing the write commands waiting for
+ *        them, on every link.
+ *
+ * @param[in]   conn_handle  Connection the buffers were used on.
+ * @param[in]   count        Number of buffers returned.
+ */
+static void tx_buffers_return(uint16_t conn_handle, uint8_t count)
+{
+    uint32_t first = 0;
+    uint32_t i;
+    
+    for (i = 0; i < m_instance_count; i++)
+    {
+        if (m_instances[i]->conn_handle == conn_handle)
+        {
+            m_instances[i]->tx_buffers_used -= MIN(count, m_instances[i]->tx_buffers_used);
+            first = i + 1;
+        }
+    }
+    
+    // Buffers the GATT server or another module used are returned too, never count beyond the total.
+    m_tx_buffer_count = MIN(m_tx_buffer_count + count, m_tx_buffer_total);
+    
+    // The link the buffers come back from goes last, so a burst on it cannot starve the others.
+    for (i = 0; i < m_instance_count; i++)
+    {
+        ble_ams_c_t * p_ams = m_instances[(first + i) % m_instance_count];
+        
+        if (p_ams->client_state == BLE_AMS_C_STATE_RUNNING)
+        {
+            tx_buffer_process(p_ams);
+        }
+    }
+}
+
+/**@brief Function for getting the number of free entries in the transmit buffer.
+ */
+static uint32_t tx_buffer_free_count(const ble_ams_c_t * p_ams)
+{
+    return TX_BUFFER_SIZE - (p_ams->tx_insert_index - p_ams->tx_index);
+}
+
+/**@brief Function for checking whether a message in the transmit buffer is a remote command.
+ */
+static bool tx_message_is_rc_command(const ble_ams_c_t * p_ams, const ble_ams_c_tx_message_t * p_msg)
+{
+    return (p_msg->type != BLE_AMS_C_TX_READ_REQ) &&
+           (p_msg->req.write_req.gattc_params.handle == p_ams->service.remote_command_handle);
+}
+
+/**@brief Function for discarding the oldest unsent remote command in the transmit buffer.
+ *
+ * @details The messages queued after it move up by one entry, so the order is kept.
+ *
+ * @return  true if a remote command was discarded, false if none is waiting.
+ */
+static bool tx_buffer_rc_command_drop(ble_ams_c_t * p_ams)
+{
+    uint32_t index;
+    
+    // Everything between p_ams->tx_index and p_ams->tx_insert_index is still unsent.
+    for (index = p_ams->tx_index; index != p_ams->tx_insert_index; index++)
+    {
+        if (tx_message_is_rc_command(p_ams, &p_ams->tx_buffer[index & TX_BUFFER_MASK]))
+        {
+            break;
+        }
+    }
+    if (index == p_ams->tx_insert_index)
+    {
+        return false;
+    }
+    
+    for (; (index + 1) != p_ams->tx_insert_index; index++)
+    {
+        ble_ams_c_tx_message_t * p_msg = &p_ams->tx_buffer[index & TX_BUFFER_MASK];
+        
+        *p_msg = p_ams->tx_buffer[(index + 1) & TX_BUFFER_MASK];
+        if (p_msg->type != BLE_AMS_C_TX_READ_REQ)
+        {
+            p_msg->req.write_req.gattc_params.p_value = p_msg->req.write_req.gattc_value;
         }
-        if (err_code == NRF_SUCCESS)
+    }
+    --p_ams->tx_insert_index;
+    return true;
+}
+
+/**@brief Function for allocating the next entry in the transmit buffer.
+ *
+ * @details If the buffer is full, the TX policy of the client decides whether the oldest unsent
+ *          remote command is discarded to make room for a new remote command, or the new message
+ *          is refused. Protocol messages (CCCD, subscription and Entity Attribute) are neither
+ *          discarded nor allowed to discard others, the client's state tracks their responses.
+ *
+ * @param[in]   rc_command  Whether the new message is a remote command.
+ *
+ * @return  Entry to fill in, or NULL if the message must not be queued.
+ */
+static ble_ams_c_tx_message_t * tx_buffer_alloc(ble_ams_c_t * p_ams, bool rc_command)
+{
+    uint32_t count;
+    
+    if (tx_buffer_free_count(p_ams) == 0)
+    {
+        p_ams->stats.tx_dropped++;
+        
+        if (!rc_command ||
+            (p_ams->tx_policy != BLE_AMS_C_TX_POLICY_DROP_OLDEST) ||
+            !tx_buffer_rc_command_drop(p_ams))
         {
-            ++m_tx_index;
-            m_tx_index &= TX_BUFFER_MASK;
+            return NULL;
         }
     }
+    
+    count = (p_ams->tx_insert_index + 1) - p_ams->tx_index;
+    if (count > p_ams->stats.tx_high_water)
+    {
+        p_ams->stats.tx_high_water = count;
+    }
+    
+    return &p_ams->tx_buffer[p_ams->tx_insert_index++ & TX_BUFFER_MASK];
+}
+
+/**@brief Function for translating a failed allocation into the result of the calling API.
+ */
+static uint32_t tx_buffer_full_result(ble_ams_c_t * p_ams, bool rc_command)
+{
+    return (rc_command && (p_ams->tx_policy == BLE_AMS_C_TX_POLICY_DROP_NEWEST)) ? NRF_SUCCESS : NRF_ERROR_NO_MEM;
+}
+
+/**@brief Function for queuing a write to the master.
+ */
+static uint32_t tx_write_queue(ble_ams_c_t   * p_ams,
+                               uint16_t        handle,
+                               const uint8_t * p_value,
+                               uint16_t        len,
+                               uint8_t         write_op)
+{
+    bool                     rc_command = (handle == p_ams->service.remote_command_handle);
+    ble_ams_c_tx_message_t * p_msg      = tx_buffer_alloc(p_ams, rc_command);
+    
+    if (p_msg == NULL)
+    {
+        return tx_buffer_full_result(p_ams, rc_command);
+    }
+    
+    memcpy(p_msg->req.write_req.gattc_value, p_value, len);
+    
+    p_msg->req.write_req.gattc_params.handle   = handle;
+    p_msg->req.write_req.gattc_params.len      = len;
+    p_msg->req.write_req.gattc_params.p_value  = p_msg->req.write_req.gattc_value;
+    p_msg->req.write_req.gattc_params.offset   = 0;
+    p_msg->req.write_req.gattc_params.write_op = write_op;
+    p_msg->conn_handle                         = p_ams->conn_handle;
+    p_msg->type                                = (write_op == BLE_GATT_OP_WRITE_CMD) ? BLE_AMS_C_TX_WRITE_CMD : BLE_AMS_C_TX_WRITE_REQ;
+    
+    return NRF_SUCCESS;
+}
+
+/**@brief Function for queuing a (blob) read from the master.
+ */
+static uint32_t tx_read_queue(ble_ams_c_t * p_ams, uint16_t handle, uint16_t offset)
+{
+    ble_ams_c_tx_message_t * p_msg = tx_buffer_alloc(p_ams, false);
+    
+    if (p_msg == NULL)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    
+    p_msg->req.read_req.handle = handle;
+    p_msg->req.read_req.offset = offset;
+    p_msg->conn_handle         = p_ams->conn_handle;
+    p_msg->type                = BLE_AMS_C_TX_READ_REQ;
+    
+    return NRF_SUCCESS;
+}
+
+/**@brief Function for dropping everything queued for the current connection.
+ */
+static void tx_session_reset(ble_ams_c_t * p_ams)
+{
+    p_ams->tx_index                   = p_ams->tx_insert_index;
+    p_ams->tx_request_pending         = false;
+    p_ams->entity_update_cccd_enabled = false;
+    p_ams->subscribe_pending          = 0;
+    p_ams->track_subscribed           = 0;
+    p_ams->track_received             = 0;
+    p_ams->track_arrived              = 0;
+    
+    // Commands queued for the old session are discarded, only this side moves cmd_get_index.
+    p_ams->cmd_get_index = p_ams->cmd_put_index;
+    
+    if (p_ams->track_quiet_ticks != 0)
+    {
+        (void)app_timer_stop(p_ams->track_timer);
+    }
+}
+
+/**@brief Function for checking whether the client is exchanging data with the master, or has
+ *        data waiting to be exchanged.
+ */
+static bool client_is_busy(const ble_ams_c_t * p_ams)
+{
+    switch (p_ams->client_state)
+    {
+        case BLE_AMS_C_STATE_DISC_SERV:
+        case BLE_AMS_C_STATE_DISC_CHAR:
+        case BLE_AMS_C_STATE_DISC_DESC:
+        case BLE_AMS_C_STATE_DISC_SC:
+        case BLE_AMS_C_STATE_WAITING_ENC:
+            return true;
+            
+        case BLE_AMS_C_STATE_RUNNING:
+            return (p_ams->tx_index != p_ams->tx_insert_index)         ||
+                   p_ams->tx_request_pending                            ||
+                   (p_ams->subscribe_pending != 0)                      ||
+                   (p_ams->attr_read.current != 0)                      ||
+                   (p_ams->attr_read.pending != 0)                      ||
+                   (p_ams->cmd_get_index != p_ams->cmd_put_index);
+            
+        default:
+            return false;
+    }
+}
+
+/**@brief Function for applying the latency policy to the link.
+ *
+ * @details With BLE_AMS_C_LATENCY_POLICY_WAKE_ON_ACTIVITY the link skips up to
+ *          idle_local_latency connection events while idle. Once busy, e.g. with a remote command
+ *          queued, it listens on the very next connection event instead of the next one aligned
+ *          to the latency. The SoftDevice truncates the latency to a multiple of the slave latency
+ *          in effect, so it is set again on every connection parameter update.
+ */
+static void local_latency_apply(ble_ams_c_t * p_ams)
+{
+    ble_opt_t opt;
+    uint16_t  actual;
+    
+    if ((p_ams->latency_policy != BLE_AMS_C_LATENCY_POLICY_WAKE_ON_ACTIVITY) ||
+        (p_ams->conn_handle == BLE_CONN_HANDLE_INVALID))
+    {
+        return;
+    }
+    
+    memset(&opt, 0, sizeof(opt));
+    
+    opt.gap.local_conn_latency.conn_handle       = p_ams->conn_handle;
+    opt.gap.local_conn_latency.requested_latency = p_ams->busy ? 0 : p_ams->idle_local_latency;
+    opt.gap.local_conn_latency.p_actual_latency  = &actual;
+    
+    if (sd_ble_opt_set(BLE_GAP_OPT_LOCAL_CONN_LATENCY, &opt) == NRF_SUCCESS)
+    {
+        p_ams->stats.local_latency = actual;
+    }
+}
+
+/**@brief Function for sending BLE_AMS_C_EVT_ACTIVITY_CHANGED when the client becomes busy or
+ *        idle.
+ *
+ * @details Called at the end of every event handled at the priority of the BLE stack events.
+ */
+static void activity_update(ble_ams_c_t * p_ams)
+{
+    ble_ams_c_evt_t event;
+    bool            busy = client_is_busy(p_ams);
+    
+    if (busy == p_ams->busy)
+    {
+        return;
+    }
+    p_ams->busy = busy;
+    
+    local_latency_apply(p_ams);
+    
+    event.evt_type  = BLE_AMS_C_EVT_ACTIVITY_CHANGED;
+    event.data.busy = busy;
+    p_ams->evt_handler(&event);
 }
 
 /**@brief Function for updating the current state and sending an event on discovery failure.
 */
-static void handle_discovery_failure(const ble_ams_c_t * p_ams, uint32_t code)
+static void handle_discovery_failure(ble_ams_c_t * p_ams, uint32_t code)
 {
     ble_ams_c_evt_t event;
     
-    m_client_state        = STATE_RUNNING_NOT_DISCOVERED;
+    p_ams->client_state   = BLE_AMS_C_STATE_RUNNING_NOT_DISCOVERED;
     event.evt_type        = BLE_AMS_C_EVT_DISCOVER_FAILED;
     event.data.error_code = code;
     
@@ -178,12 +505,14 @@ static void handle_discovery_failure(const ble_ams_c_t * p_ams, uint32_t code)
 
 /**@brief Function for executing the Service Discovery Procedure.
  */
-static void service_disc_req_send(const ble_ams_c_t * p_ams)
+static void service_disc_req_send(ble_ams_c_t * p_ams)
 {
     uint16_t   handle = START_HANDLE_DISCOVER;
     ble_uuid_t ams_uuid;
     uint32_t   err_code;
     
+    memset(&p_ams->service_disc, 0, sizeof(ble_ams_c_service_t));
+    
     // Discover services on uuid for ANCS.
     BLE_UUID_BLE_ASSIGN(ams_uuid, BLE_UUID_APPLE_MEDIA_SERVICE);
     ams_uuid.type = BLE_UUID_TYPE_VENDOR_BEGIN;
@@ -195,13 +524,13 @@ static void service_disc_req_send(const ble_ams_c_t * p_ams)
     }
     else
     {
-        m_client_state = STATE_DISC_SERV;
+        p_ams->client_state = BLE_AMS_C_STATE_DISC_SERV;
     }
 }
 
 /**@brief Function for executing the Characteristic Discovery Procedure.
  */
-static void characteristic_disc_req_send(const ble_ams_c_t * p_ams,
+static void characteristic_disc_req_send(ble_ams_c_t * p_ams,
                                          const ble_gattc_handle_range_t * p_handle)
 {
     uint32_t err_code;
@@ -211,7 +540,7 @@ static void characteristic_disc_req_send(const ble_ams_c_t * p_ams,
     
     if (err_code == NRF_SUCCESS)
     {
-        m_client_state = STATE_DISC_CHAR;
+        p_ams->client_state = BLE_AMS_C_STATE_DISC_CHAR;
     }
     else
     {
@@ -220,33 +549,23 @@ static void characteristic_disc_req_send(const ble_ams_c_t * p_ams,
 }
 
 /**@brief Function for executing the Characteristic Descriptor Discovery Procedure.
+ *
+ * @details Descriptors are discovered in one sweep from start_handle to the end of the service,
+ *          every response carries as many attributes as fit in the MTU.
  */
-static void descriptor_disc_req_send(const ble_ams_c_t * p_ams)
+static void descriptor_disc_req_send(ble_ams_c_t * p_ams, uint16_t start_handle)
 {
     ble_gattc_handle_range_t descriptor_handle;
-    uint32_t                 err_code = NRF_SUCCESS;
+    uint32_t                 err_code;
     
-    // If we have not discovered descriptors for all characteristics,
-    // we will discover next descriptor.
-    if (m_service.entity_update.handle_cccd == BLE_AMS_INVALID_HANDLE)
-    {
-        descriptor_handle.start_handle = m_service.entity_update.handle_value + 1;
-        descriptor_handle.end_handle = m_service.entity_update.handle_value + 1;
-        
-        err_code = sd_ble_gattc_descriptors_discover(p_ams->conn_handle, &descriptor_handle);
-    }
-    else if (m_service.remote_command.handle_cccd == BLE_AMS_INVALID_HANDLE)
-    {
-        descriptor_handle.start_handle = m_service.remote_command.handle_value + 1;
-        descriptor_handle.end_handle = m_service.remote_command.handle_value + 1;
-        
-        err_code = sd_ble_gattc_descriptors_discover(p_ams->conn_handle, &descriptor_handle);
-    }
+    descriptor_handle.start_handle = start_handle;
+    descriptor_handle.end_handle   = p_ams->service_disc.service.handle_range.end_handle;
     
+    err_code = sd_ble_gattc_descriptors_discover(p_ams->conn_handle, &descriptor_handle);
     
     if (err_code == NRF_SUCCESS)
     {
-        m_client_state = STATE_DISC_DESC;
+        p_ams->client_state = BLE_AMS_C_STATE_DISC_DESC;
     }
     else
     {
@@ -268,112 +587,224 @@ static void descriptor_disc_req_send(const ble_ams_c_t * p_ams)
  *          BLE_AMS_C_EVT_DISCOVER_COMPLETE - When we are connected to a new master and the Service
  *                                            Discovery has been completed.
  */
-static void connection_established(const ble_ams_c_t * p_ams)
+static void connection_established(ble_ams_c_t * p_ams)
 {
     ble_ams_c_evt_t event;
     
-    m_client_state = STATE_RUNNING;
+    p_ams->client_state = BLE_AMS_C_STATE_RUNNING;
     
     event.evt_type = BLE_AMS_C_EVT_DISCOVER_COMPLETE;
     p_ams->evt_handler(&event);
 }
 
-/**@brief Function for waiting until an encrypted link has been established to a bonded master.
+/**@brief Function for fetching the service record from the application context of a bond.
  */
-static void encrypted_link_setup_wait(const ble_ams_c_t * p_ams)
+static void service_record_load(ble_ams_c_t * p_ams, dm_handle_t const * p_handle)
 {
-    m_client_state = STATE_WAITING_ENC;
+    dm_application_context_t context;
+    uint32_t                 err_code = NRF_ERROR_NOT_FOUND;
+    
+    p_ams->dm_handle            = *p_handle;
+    p_ams->service_record_dirty = false;
+    
+    if (p_handle->device_id != DM_INVALID_ID)
+    {
+        context.flags  = 0;
+        context.len    = sizeof(ble_ams_c_service_record_t);
+        context.p_data = (uint8_t *)p_ams->service_context.words;
+        
+        err_code = dm_application_context_get(p_handle, &context);
+    }
+    
+    if ((err_code != NRF_SUCCESS) || (SERVICE_RECORD(p_ams)->version != SERVICE_RECORD_VERSION))
+    {
+        // No context stored yet, or one written in another format.
+        memset(SERVICE_RECORD(p_ams), 0, sizeof(ble_ams_c_service_record_t));
+    }
+    p_ams->service_stored = *SERVICE_RECORD(p_ams);
 }
 
-/**@brief Function for handling the connect event when a master connects.
+/**@brief Function for updating the service record of the current bond.
  *
- * @details This function will check if bonded master connects, and do the following
- *          Bonded master  - enter wait for encryption state.
- *          Unknown master - Initiate service discovery procedure.
+ * @details The record is only marked for writing to flash if its content changes.
  */
-static void event_connect(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
+static void service_record_set(ble_ams_c_t * p_ams, const ble_ams_c_service_record_t * p_service)
 {
-    p_ams->conn_handle = p_ble_evt->evt.gatts_evt.conn_handle;
-    
-    if (p_ams->central_handle != DM_INVALID_ID)
+    if (memcmp(SERVICE_RECORD(p_ams), p_service, sizeof(ble_ams_c_service_record_t)) != 0)
     {
-        m_service = mp_service_db[p_ams->central_handle];
-        encrypted_link_setup_wait(p_ams);
+        *SERVICE_RECORD(p_ams)      = *p_service;
+        p_ams->service_record_dirty = true;
     }
-    else
+}
+
+/**@brief Function for invalidating the service record of the current bond.
+ */
+static void service_record_invalidate(ble_ams_c_t * p_ams)
+{
+    if (SERVICE_RECORD(p_ams)->flags & SERVICE_RECORD_FLAG_VALID)
     {
-        m_service.handle = INVALID_SERVICE_HANDLE;
-        service_disc_req_send(p_ams);
+        SERVICE_RECORD(p_ams)->flags &= ~SERVICE_RECORD_FLAG_VALID;
+        p_ams->service_record_dirty   = true;
     }
 }
 
-/**@brief Function for handling the encrypted link event when a secure
- *        connection has been established with a master.
+/**@brief Function for taking the service handles from the cache of a bonded master.
  *
- * @details This function will check if the service for the master is known.
- *          Service known   - Execute action running / switch to running state.
- *          Service unknown - Initiate Service Discovery Procedure.
+ * @details A valid record lets the client skip primary service, characteristic and descriptor
+ *          discovery altogether. AMS rejects writes on a link that is not encrypted, so the
+ *          client only runs once the Device Manager reports the link secured.
+ *
+ * @return  true if a valid record was found and the client is running or waits for the
+ *          encryption of the link, false otherwise.
  */
-static void event_encrypted_link(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
+static bool service_cache_apply(ble_ams_c_t * p_ams)
 {
-    // If we are setting up a bonded connection and the UUID of the service
-    // is unknown, a new discovery must be performed.
-    if (m_service.service.uuid.uuid != BLE_UUID_APPLE_MEDIA_SERVICE)
+    if ((p_ams->central_handle >= BLE_AMS_MAX_DISCOVERED_CENTRALS) ||
+        (p_ams->dm_handle.device_id != p_ams->central_handle)           ||
+        ((SERVICE_RECORD(p_ams)->flags & SERVICE_RECORD_FLAG_VALID) == 0))
     {
-        m_service.handle = INVALID_SERVICE_HANDLE;
-        service_disc_req_send(p_ams);
+        return false;
     }
-    else
+    
+    p_ams->service        = *SERVICE_RECORD(p_ams);
+    p_ams->service_cached = true;
+    
+    if (p_ams->link_secured)
     {
         connection_established(p_ams);
     }
+    else
+    {
+        p_ams->client_state = BLE_AMS_C_STATE_WAITING_ENC;
+    }
+    return true;
 }
 
-/**@brief Function for handling the response on service discovery.
- *
- * @details This function will validate the response.
- *          Invalid response - Handle discovery failure.
- *          Valid response   - Initiate Characteristic Discovery Procedure.
+/**@brief Function for getting the connection an event from the stack belongs to.
  */
-static void event_discover_rsp(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
+static uint16_t evt_conn_handle_get(const ble_evt_t * p_ble_evt)
 {
-    if (p_ble_evt->evt.gattc_evt.gatt_status != BLE_GATT_STATUS_SUCCESS)
+    uint16_t event = p_ble_evt->header.evt_id;
+    
+    if ((event >= BLE_GAP_EVT_BASE) && (event <= BLE_GAP_EVT_LAST))
     {
-        // We have received an  unexpected result.
-        // As we are in a connected state, but can not continue
-        // our service discovery, we will go to running state.
-        handle_discovery_failure(p_ams, p_ble_evt->evt.gattc_evt.gatt_status);
+        return p_ble_evt->evt.gap_evt.conn_handle;
     }
-    else
+    if ((event >= BLE_GATTC_EVT_BASE) && (event <= BLE_GATTC_EVT_LAST))
     {
-        BLE_UUID_COPY_INST(m_service.service.uuid,
-                           p_ble_evt->evt.gattc_evt.params.prim_srvc_disc_rsp.services[0].uuid);
-        
-        if (p_ble_evt->evt.gattc_evt.params.prim_srvc_disc_rsp.count > 0)
-        {
-            const ble_gattc_service_t * p_service;
-            
-            p_service = &(p_ble_evt->evt.gattc_evt.params.prim_srvc_disc_rsp.services[0]);
-            
-            m_service.service.handle_range.start_handle = p_service->handle_range.start_handle;
-            m_service.service.handle_range.end_handle   = p_service->handle_range.end_handle;
-            
-            characteristic_disc_req_send(p_ams, &(m_service.service.handle_range));
-        }
-        else
-        {
-            // If we receive an answer, but it contains no service, we just go to state: Running.
-            handle_discovery_failure(p_ams, p_ble_evt->evt.gattc_evt.gatt_status);
-        }
+        return p_ble_evt->evt.gattc_evt.conn_handle;
     }
+    return p_ble_evt->evt.common_evt.conn_handle;
 }
 
-/**@brief Function for setting the discovered characteristics in the apple service.
+/**@brief Function for checking whether an instance serves a new connection, claiming the
+ *        connection if no instance serves it yet.
+ *
+ * @details A new connection is served by the first initialized instance without a connection.
  */
-static void characteristics_set(apple_characteristic_t * p_characteristic,
-                                const ble_gattc_char_t * p_char_resp)
+static bool instance_claim(ble_ams_c_t * p_ams, uint16_t conn_handle)
 {
-    BLE_UUID_COPY_INST(p_characteristic->uuid, p_char_resp->uuid);
+    uint32_t i;
+    
+    if (p_ams->conn_handle == conn_handle)
+    {
+        return true;
+    }
+    if (p_ams->conn_handle != BLE_CONN_HANDLE_INVALID)
+    {
+        return false;
+    }
+    
+    for (i = 0; i < m_instance_count; i++)
+    {
+        if (m_instances[i]->conn_handle == conn_handle)
+        {
+            return false;
+        }
+    }
+    
+    for (i = 0; i < m_instance_count; i++)
+    {
+        if (m_instances[i]->conn_handle == BLE_CONN_HANDLE_INVALID)
+        {
+            break;
+        }
+    }
+    
+    if ((i == m_instance_count) || (m_instances[i] != p_ams))
+    {
+        return false;
+    }
+    
+    p_ams->conn_handle = conn_handle;
+    return true;
+}
+
+/**@brief Function for handling the connect event when a master connects.
+ *
+ * @details This function will check if bonded master connects, and do the following
+ *          Bonded master with cached service - enter wait for encryption state.
+ *          Otherwise                         - Initiate service discovery procedure.
+ */
+static void event_connect(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
+{
+    p_ams->conn_handle        = p_ble_evt->evt.gap_evt.conn_handle;
+    p_ams->supported_commands = BLE_AMS_SUPPORTED_COMMANDS_UNKNOWN;
+    
+    p_ams->stats.flash_bytes_written = 0;
+    tx_flow_reset(p_ams);
+    
+    if (!service_cache_apply(p_ams))
+    {
+        service_disc_req_send(p_ams);
+    }
+}
+
+/**@brief Function for handling the response on service discovery.
+ *
+ * @details This function will validate the response.
+ *          Invalid response - Handle discovery failure.
+ *          Valid response   - Initiate Characteristic Discovery Procedure.
+ */
+static void event_discover_rsp(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
+{
+    if (p_ble_evt->evt.gattc_evt.gatt_status != BLE_GATT_STATUS_SUCCESS)
+    {
+        // We have received an  unexpected result.
+        // As we are in a connected state, but can not continue
+        // our service discovery, we will go to running state.
+        handle_discovery_failure(p_ams, p_ble_evt->evt.gattc_evt.gatt_status);
+    }
+    else
+    {
+        BLE_UUID_COPY_INST(p_ams->service_disc.service.uuid,
+                           p_ble_evt->evt.gattc_evt.params.prim_srvc_disc_rsp.services[0].uuid);
+        
+        if (p_ble_evt->evt.gattc_evt.params.prim_srvc_disc_rsp.count > 0)
+        {
+            const ble_gattc_service_t * p_service;
+            
+            p_service = &(p_ble_evt->evt.gattc_evt.params.prim_srvc_disc_rsp.services[0]);
+            
+            p_ams->service_disc.service.handle_range.start_handle = p_service->handle_range.start_handle;
+            p_ams->service_disc.service.handle_range.end_handle   = p_service->handle_range.end_handle;
+            
+            characteristic_disc_req_send(p_ams, &(p_ams->service_disc.service.handle_range));
+        }
+        else
+        {
+            // If we receive an answer, but it contains no service, we just go to state: Running.
+            handle_discovery_failure(p_ams, p_ble_evt->evt.gattc_evt.gatt_status);
+        }
+    }
+}
+
+/**@brief Function for setting the discovered characteristics in the apple service.
+ */
+static void characteristics_set(ble_ams_c_char_t * p_characteristic,
+                                const ble_gattc_char_t * p_char_resp)
+{
+    BLE_UUID_COPY_INST(p_characteristic->uuid, p_char_resp->uuid);
     
     p_characteristic->properties   = p_char_resp->char_props;
     p_characteristic->handle_decl  = p_char_resp->handle_decl;
@@ -381,6 +812,143 @@ static void characteristics_set(apple_characteristic_t * p_characteristic,
     p_characteristic->handle_cccd  = BLE_AMS_INVALID_HANDLE;
 }
 
+/**@brief Function for ending discovery and enabling Service Changed indications.
+ *
+ * @details The master keeps the CCCD of a bonded client, so it is only written after a
+ *          discovery. A master without Service Changed leaves the client running all the same.
+ */
+static void service_disc_complete(ble_ams_c_t * p_ams)
+{
+    uint8_t value[2];
+    
+    p_ams->service.flags |= SERVICE_RECORD_FLAG_VALID;
+    
+    if (p_ams->service.service_changed_cccd != 0)
+    {
+        value[0] = LSB(SERVICE_CHANGED_CCCD_INDICATE);
+        value[1] = MSB(SERVICE_CHANGED_CCCD_INDICATE);
+        
+        (void)tx_write_queue(p_ams,
+                             p_ams->service.service_changed_cccd,
+                             value,
+                             sizeof(value),
+                             BLE_GATT_OP_WRITE_REQ);
+    }
+    
+    connection_established(p_ams);
+    tx_buffer_process(p_ams);
+}
+
+/**@brief Function for starting the discovery of the GATT service, whose Service Changed
+ *        characteristic tells of changes to the handles of AMS.
+ */
+static void gatt_service_disc_req_send(ble_ams_c_t * p_ams)
+{
+    ble_uuid_t gatt_uuid;
+    uint32_t   err_code;
+    
+    BLE_UUID_BLE_ASSIGN(gatt_uuid, BLE_UUID_GATT);
+    
+    err_code = sd_ble_gattc_primary_services_discover(p_ams->conn_handle, START_HANDLE_DISCOVER, &gatt_uuid);
+    if (err_code == NRF_SUCCESS)
+    {
+        p_ams->client_state = BLE_AMS_C_STATE_DISC_SC;
+    }
+    else
+    {
+        service_disc_complete(p_ams);
+    }
+}
+
+/**@brief Function for handling the responses of the Service Changed discovery.
+ *
+ * @details The GATT service is found first, then Service Changed within it, then the CCCD
+ *          following its value. AMS has been discovered already, so a failure only leaves the
+ *          client without Service Changed indications.
+ */
+static void event_service_changed_rsp(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
+{
+    const ble_gattc_evt_t *  p_gattc_evt = &p_ble_evt->evt.gattc_evt;
+    ble_gattc_service_t *    p_gatt      = &p_ams->service_disc.gatt_service;
+    ble_gattc_handle_range_t range;
+    uint32_t                 err_code    = NRF_ERROR_NOT_FOUND;
+    uint32_t                 i;
+    
+    if (p_gattc_evt->gatt_status != BLE_GATT_STATUS_SUCCESS)
+    {
+        service_disc_complete(p_ams);
+        return;
+    }
+    
+    switch (p_ble_evt->header.evt_id)
+    {
+        case BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP:
+            if (p_gattc_evt->params.prim_srvc_disc_rsp.count > 0)
+            {
+                *p_gatt  = p_gattc_evt->params.prim_srvc_disc_rsp.services[0];
+                err_code = sd_ble_gattc_characteristics_discover(p_ams->conn_handle, &p_gatt->handle_range);
+            }
+            break;
+            
+        case BLE_GATTC_EVT_CHAR_DISC_RSP:
+            range.start_handle = 0;
+            range.end_handle   = p_gatt->handle_range.end_handle;
+            
+            for (i = 0; i < p_gattc_evt->params.char_disc_rsp.count; i++)
+            {
+                const ble_gattc_char_t * p_char = &p_gattc_evt->params.char_disc_rsp.chars[i];
+                
+                range.start_handle = p_char->handle_value + 1;
+                if ((p_char->uuid.type == BLE_UUID_TYPE_BLE) &&
+                    (p_char->uuid.uuid == BLE_UUID_GATT_CHARACTERISTIC_SERVICE_CHANGED))
+                {
+                    p_ams->service.service_changed_handle = p_char->handle_value;
+                    break;
+                }
+            }
+            
+            if ((range.start_handle == 0) || (range.start_handle > range.end_handle))
+            {
+                // No characteristics left, or no room for the CCCD.
+            }
+            else if (p_ams->service.service_changed_handle != 0)
+            {
+                err_code = sd_ble_gattc_descriptors_discover(p_ams->conn_handle, &range);
+            }
+            else
+            {
+                err_code = sd_ble_gattc_characteristics_discover(p_ams->conn_handle, &range);
+            }
+            break;
+            
+        case BLE_GATTC_EVT_DESC_DISC_RSP:
+            // The descriptors of Service Changed end at the next characteristic declaration.
+            for (i = 0; i < p_gattc_evt->params.desc_disc_rsp.count; i++)
+            {
+                const ble_gattc_desc_t * p_desc = &p_gattc_evt->params.desc_disc_rsp.descs[i];
+                
+                if (p_desc->uuid.uuid == BLE_UUID_CHARACTERISTIC)
+                {
+                    break;
+                }
+                if (p_desc->uuid.uuid == BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG)
+                {
+                    p_ams->service.service_changed_cccd = p_desc->handle;
+                    break;
+                }
+            }
+            break;
+            
+        default:
+            break;
+    }
+    
+    if (err_code != NRF_SUCCESS)
+    {
+        service_disc_complete(p_ams);
+    }
+}
+
 /**@brief Function for handling a characteristic discovery response event.
  *
  * @details This function will validate and store the characteristics received.
@@ -393,17 +961,27 @@ static void event_characteristic_rsp(ble_ams_c_t * p_ams, const ble_evt_t * p_bl
     if (p_ble_evt->evt.gattc_evt.gatt_status == BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND ||
         p_ble_evt->evt.gattc_evt.gatt_status == BLE_GATT_STATUS_ATTERR_INVALID_HANDLE)
     {
-        if ((m_service.remote_command.handle_value == 0)    ||
-            (m_service.entity_update.handle_value == 0)    ||
-            (m_service.entity_attribute.handle_value == 0) )
+        if ((p_ams->service_disc.remote_command.handle_value == 0)    ||
+            (p_ams->service_disc.entity_update.handle_value == 0)    ||
+            (p_ams->service_disc.entity_attribute.handle_value == 0) )
         {
             // At least one required characteristic is missing on the server side.
             handle_discovery_failure(p_ams, NRF_ERROR_NOT_FOUND);
         }
         else
         {
-            connection_established(p_ams);
-            //descriptor_disc_req_send(p_ams);
+            // Characteristic values precede their descriptors, sweep from the lowest one.
+            uint16_t start_handle = p_ams->service_disc.remote_command.handle_value;
+            
+            if (p_ams->service_disc.entity_update.handle_value < start_handle)
+            {
+                start_handle = p_ams->service_disc.entity_update.handle_value;
+            }
+            if (p_ams->service_disc.entity_attribute.handle_value < start_handle)
+            {
+                start_handle = p_ams->service_disc.entity_attribute.handle_value;
+            }
+            descriptor_disc_req_send(p_ams, start_handle + 1);
         }
     }
     else if (p_ble_evt->evt.gattc_evt.gatt_status)
@@ -425,15 +1003,15 @@ static void event_characteristic_rsp(ble_ams_c_t * p_ams, const ble_evt_t * p_bl
             switch (p_char_resp->uuid.uuid)
             {
                 case BLE_UUID_AMS_REMOTE_COMMAND_CHAR:
-                    characteristics_set(&m_service.remote_command, p_char_resp);
+                    characteristics_set(&p_ams->service_disc.remote_command, p_char_resp);
                     break;
                     
                 case BLE_UUID_AMS_ENTITY_UPDATE_CHAR:
-                    characteristics_set(&m_service.entity_update, p_char_resp);
+                    characteristics_set(&p_ams->service_disc.entity_update, p_char_resp);
                     break;
                     
                 case BLE_UUID_AMS_ENTITY_ATTRIBUTE_CHAR:
-                    characteristics_set(&m_service.entity_attribute, p_char_resp);
+                    characteristics_set(&p_ams->service_disc.entity_attribute, p_char_resp);
                     break;
                     
                 default:
@@ -448,50 +1026,86 @@ static void event_characteristic_rsp(ble_ams_c_t * p_ams, const ble_evt_t * p_bl
             ble_gattc_handle_range_t char_handle;
             
             char_handle.start_handle = p_char_resp->handle_value + 1;
-            char_handle.end_handle   = m_service.service.handle_range.end_handle;
+            char_handle.end_handle   = p_ams->service_disc.service.handle_range.end_handle;
             
             characteristic_disc_req_send(p_ams, &char_handle);
         }
         else
         {
-            characteristic_disc_req_send(p_ams, &(m_service.service.handle_range));
+            characteristic_disc_req_send(p_ams, &(p_ams->service_disc.service.handle_range));
         }
     }
 }
 
 /**@brief Function for setting the discovered descriptor in the apple service.
+ *
+ * @details A descriptor belongs to the characteristic with the greatest value handle below it.
  */
-static void descriptor_set(apple_service_t * p_service, const ble_gattc_desc_t * p_desc_resp)
+static void descriptor_set(ble_ams_c_service_t * p_service, const ble_gattc_desc_t * p_desc_resp)
 {
-    if (p_service->remote_command.handle_value == (p_desc_resp->handle - 1))
+    ble_ams_c_char_t * p_chars[] = {&p_service->remote_command,
+                                    &p_service->entity_update,
+                                    &p_service->entity_attribute};
+    ble_ams_c_char_t * p_owner   = NULL;
+    uint32_t           i;
+    
+    if (p_desc_resp->uuid.uuid != BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG)
     {
-        if (p_desc_resp->uuid.uuid == BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG)
-        {
-            p_service->remote_command.handle_cccd = p_desc_resp->handle;
-        }
+        return;
     }
     
-    else if (p_service->entity_update.handle_value == (p_desc_resp->handle - 1))
+    for (i = 0; i < sizeof(p_chars) / sizeof(p_chars[0]); i++)
     {
-        if (p_desc_resp->uuid.uuid == BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG)
+        if ((p_chars[i]->handle_value < p_desc_resp->handle) &&
+            ((p_owner == NULL) || (p_chars[i]->handle_value > p_owner->handle_value)))
         {
-            p_service->entity_update.handle_cccd = p_desc_resp->handle;
+            p_owner = p_chars[i];
         }
     }
-    else if (p_service->entity_attribute.handle_value == (p_desc_resp->handle - 1))
+    
+    if ((p_owner != NULL) && (p_owner->handle_cccd == BLE_AMS_INVALID_HANDLE))
+    {
+        p_owner->handle_cccd = p_desc_resp->handle;
+    }
+}
+
+/**@brief Function for ending the descriptor discovery sweep.
+ */
+static void descriptor_disc_complete(ble_ams_c_t * p_ams)
+{
+    if (p_ams->service_disc.remote_command.handle_cccd == BLE_AMS_INVALID_HANDLE ||
+        p_ams->service_disc.entity_update.handle_cccd == BLE_AMS_INVALID_HANDLE)
+    {
+        // Notifications are required from both characteristics.
+        handle_discovery_failure(p_ams, NRF_ERROR_NOT_FOUND);
+    }
+    else
     {
-        if (p_desc_resp->uuid.uuid == BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG)
+        p_ams->service.version                 = SERVICE_RECORD_VERSION;
+        p_ams->service.flags                   = 0;
+        p_ams->service.remote_command_handle   = p_ams->service_disc.remote_command.handle_value;
+        p_ams->service.remote_command_cccd     = p_ams->service_disc.remote_command.handle_cccd;
+        p_ams->service.entity_update_handle    = p_ams->service_disc.entity_update.handle_value;
+        p_ams->service.entity_update_cccd      = p_ams->service_disc.entity_update.handle_cccd;
+        p_ams->service.entity_attribute_handle = p_ams->service_disc.entity_attribute.handle_value;
+        p_ams->service.service_changed_handle  = 0;
+        p_ams->service.service_changed_cccd    = 0;
+        
+        if (p_ams->service_disc.remote_command.properties.write_wo_resp)
         {
-            p_service->entity_attribute.handle_cccd = p_desc_resp->handle;
+            p_ams->service.flags |= SERVICE_RECORD_FLAG_RC_WRITE_WO_RESP;
         }
+        
+        gatt_service_disc_req_send(p_ams);
     }
 }
 
 /**@brief Function for handling of descriptor discovery responses.
  *
- * @details This function will validate and store the descriptor received.
- *          If not all descriptors are discovered it will continue the descriptor discovery
- *          procedure, otherwise it will continue to running state.
+ * @details This function will validate and store the descriptors received.
+ *          If the sweep has not reached the end of the service it will continue after the last
+ *          descriptor received, otherwise it will continue with the Service Changed
+ *          discovery.
  *          If we receive a GATT Client error, we will go to handling of discovery failure.
  */
 static void event_descriptor_rsp(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
@@ -499,7 +1113,8 @@ static void event_descriptor_rsp(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_ev
     if (p_ble_evt->evt.gattc_evt.gatt_status == BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND ||
         p_ble_evt->evt.gattc_evt.gatt_status == BLE_GATT_STATUS_ATTERR_INVALID_HANDLE)
     {
-        handle_discovery_failure(p_ams, NRF_ERROR_NOT_FOUND);
+        // No attributes left in the range.
+        descriptor_disc_complete(p_ams);
     }
     else if (p_ble_evt->evt.gattc_evt.gatt_status)
     {
@@ -510,138 +1125,1117 @@ static void event_descriptor_rsp(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_ev
     }
     else
     {
-        if (p_ble_evt->evt.gattc_evt.params.desc_disc_rsp.count > 0)
+        const ble_gattc_evt_desc_disc_rsp_t * p_rsp = &p_ble_evt->evt.gattc_evt.params.desc_disc_rsp;
+        uint16_t                              last_handle;
+        uint32_t                              i;
+        
+        for (i = 0; i < p_rsp->count; i++)
         {
-            descriptor_set(&m_service, &(p_ble_evt->evt.gattc_evt.params.desc_disc_rsp.descs[0]));
+            descriptor_set(&p_ams->service_disc, &(p_rsp->descs[i]));
         }
         
-        if (m_service.remote_command.handle_cccd == BLE_AMS_INVALID_HANDLE ||
-            m_service.entity_update.handle_cccd == BLE_AMS_INVALID_HANDLE)
+        last_handle = (p_rsp->count > 0) ? p_rsp->descs[p_rsp->count - 1].handle
+                                         : p_ams->service_disc.service.handle_range.end_handle;
+        
+        if (last_handle < p_ams->service_disc.service.handle_range.end_handle)
         {
-            descriptor_disc_req_send(p_ams);
+            descriptor_disc_req_send(p_ams, last_handle + 1);
         }
         else
         {
-            connection_established(p_ams);
+            descriptor_disc_complete(p_ams);
         }
     }
 }
 
-/**@brief Function for handling write response events.
- */
-static void event_write_rsp(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
-{
-    tx_buffer_process();
-}
-
 /**@brief Function for disconnecting and cleaning the current service.
  */
 static void event_disconnect(ble_ams_c_t * p_ams)
 {
-    m_client_state = STATE_IDLE;
+    p_ams->client_state = BLE_AMS_C_STATE_IDLE;
     
-    if (m_service.handle == INVALID_SERVICE_HANDLE_DISC &&
-        p_ams->central_handle != DM_INVALID_ID)
+    if ((p_ams->service.flags & SERVICE_RECORD_FLAG_VALID) &&
+        (p_ams->central_handle != DM_INVALID_ID)      &&
+        (p_ams->central_handle == p_ams->dm_handle.device_id))
     {
-        m_service.handle = p_ams->central_handle;
+        service_record_set(p_ams, &p_ams->service);
     }
     
-    if (m_service.handle < BLE_AMS_MAX_DISCOVERED_CENTRALS)
-    {
-        mp_service_db[m_service.handle] = m_service;
-    }
+    memset(&p_ams->service, 0, sizeof(ble_ams_c_service_record_t));
+    p_ams->service_cached = false;
     
-    memset(&m_service, 0, sizeof(apple_service_t));
+    // The stack frees the buffers of a closed link without BLE_EVT_TX_COMPLETE.
+    m_tx_buffer_count      = MIN(m_tx_buffer_count + p_ams->tx_buffers_used, m_tx_buffer_total);
+    p_ams->tx_buffers_used = 0;
     
-    m_service.handle       = INVALID_SERVICE_HANDLE;
     p_ams->service_handle = INVALID_SERVICE_HANDLE;
     p_ams->conn_handle    = BLE_CONN_HANDLE_INVALID;
+    p_ams->link_secured   = false;
     p_ams->central_handle  = DM_INVALID_ID;
+    
+    memset(&p_ams->media_state, 0, sizeof(ble_ams_media_state_t));
+    memset(&p_ams->playback, 0, sizeof(ble_ams_playback_t));
+    memset(&p_ams->attr_read, 0, sizeof(ble_ams_c_attr_read_t));
+    p_ams->track_hash        = 0;
+    p_ams->fingerprint_valid = 0;
+    
+    tx_session_reset(p_ams);
+}
+
+/**@brief Function for dropping a cached service record that no longer matches the master and
+ *        discovering the service again.
+ *
+ * @details Called on a Service Changed indication or an ATT error against a cached handle.
+ */
+static void service_rediscover(ble_ams_c_t * p_ams)
+{
+    service_record_invalidate(p_ams);
+    
+    memset(&p_ams->service, 0, sizeof(ble_ams_c_service_record_t));
+    memset(&p_ams->attr_read, 0, sizeof(ble_ams_c_attr_read_t));
+    p_ams->service_cached = false;
+    
+    tx_session_reset(p_ams);
+    service_disc_req_send(p_ams);
+}
+
+/**@brief Function for checking a response for an ATT error caused by a stale cached handle.
+ *
+ * @return true if the service is being rediscovered and the response must not be processed.
+ */
+static bool cached_handle_error_check(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
+{
+    uint16_t gatt_status = p_ble_evt->evt.gattc_evt.gatt_status;
+    
+    if (p_ams->service_cached &&
+        ((gatt_status == BLE_GATT_STATUS_ATTERR_INVALID_HANDLE) ||
+         (gatt_status == BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND)))
+    {
+        service_rediscover(p_ams);
+        return true;
+    }
+    return false;
 }
 
 /**@brief Function for handling of Device Manager events.
  */
-void ble_ams_c_on_device_manager_evt(ble_ams_c_t      * p_ams,
+static void device_manager_evt_handle(ble_ams_c_t      * p_ams,
                                       dm_handle_t const * p_handle,
                                       dm_event_t const  * p_dm_evt)
 {
+    if (p_dm_evt->event_id == DM_EVT_CONNECTION)
+    {
+        // The Device Manager reports the connection before the stack event reaches the client.
+        if (!instance_claim(p_ams, p_dm_evt->event_param.p_gap_param->conn_handle))
+        {
+            return;
+        }
+    }
+    else if ((p_ams->conn_handle == BLE_CONN_HANDLE_INVALID) ||
+             (p_handle->connection_id != p_ams->dm_handle.connection_id))
+    {
+        // Event for a link served by another instance.
+        return;
+    }
+    
     switch (p_dm_evt->event_id)
     {
         case DM_EVT_CONNECTION:
-            // Fall through.
+            p_ams->central_handle = p_handle->device_id;
+            p_ams->link_secured   = false;
+            service_record_load(p_ams, p_handle);
+            break;
+            
         case DM_EVT_SECURITY_SETUP_COMPLETE:
+            // A new bond, there is no record to load.
+            p_ams->central_handle = p_handle->device_id;
+            p_ams->dm_handle      = *p_handle;
+            service_record_invalidate(p_ams);
+            if (p_ams->client_state == BLE_AMS_C_STATE_WAITING_ENC)
+            {
+                // The master has paired again, the cached service belongs to the old bond.
+                service_rediscover(p_ams);
+            }
+            break;
+            
+        case DM_EVT_LINK_SECURED:
+            // Masters using private addresses are only identified once the link is encrypted,
+            // finish a discovery in progress from the cache.
             p_ams->central_handle = p_handle->device_id;
+            p_ams->link_secured   = true;
+            if (p_ams->dm_handle.device_id != p_handle->device_id)
+            {
+                service_record_load(p_ams, p_handle);
+            }
+            if ((p_ams->client_state == BLE_AMS_C_STATE_DISC_SERV) ||
+                (p_ams->client_state == BLE_AMS_C_STATE_DISC_CHAR) ||
+                (p_ams->client_state == BLE_AMS_C_STATE_DISC_DESC))
+            {
+                (void)service_cache_apply(p_ams);
+            }
+            else if (p_ams->client_state == BLE_AMS_C_STATE_WAITING_ENC)
+            {
+                connection_established(p_ams);
+            }
             break;
+            
         default:
             // Do nothing.
             break;
     }
 }
 
-/**@brief Function for receiving and validating notifications received from the master.
- */
-static void event_notify(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
+void ble_ams_c_on_device_manager_evt(ble_ams_c_t      * p_ams,
+                                      dm_handle_t const * p_handle,
+                                      dm_event_t const  * p_dm_evt)
 {
-    //TBD
+    device_manager_evt_handle(p_ams, p_handle, p_dm_evt);
+    activity_update(p_ams);
 }
 
-/**@brief Function for handling of BLE stack events.
+#define STATE_SLOT_SET(P_SLOT, FIELD)                    \
+    do                                                   \
+    {                                                    \
+        (P_SLOT)->p_len   = &(FIELD).len;                \
+        (P_SLOT)->p_flags = &(FIELD).flags;              \
+        (P_SLOT)->p_value = (FIELD).value;               \
+        (P_SLOT)->size    = sizeof((FIELD).value) - 1;   \
+    } while (0)
+
+/**@brief Function for looking up the media state slot of an attribute.
+ *
+ * @return true if the attribute has a slot, false otherwise.
  */
-void ble_ams_c_on_ble_evt(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
+static bool state_slot_get(ble_ams_media_state_t * p_state,
+                           uint8_t                 entity_id,
+                           uint8_t                 attribute_id,
+                           state_slot_t          * p_slot)
 {
-    uint16_t event = p_ble_evt->header.evt_id;
-    
-    switch (m_client_state)
+    switch (BLE_AMS_STATE_DIRTY_BIT(entity_id, attribute_id))
     {
-        case STATE_UNINITIALIZED:
-            // Initialization is handle in special case, thus if we enter here, it means that an
-            // event is received even though we are not initialized --> ignore.
+        case BLE_AMS_STATE_DIRTY_PLAYER_NAME:
+            STATE_SLOT_SET(p_slot, p_state->player_name);
             break;
             
-        case STATE_IDLE:
-            if (event == BLE_GAP_EVT_CONNECTED)
-            {
-                event_connect(p_ams, p_ble_evt);
-            }
+        case BLE_AMS_STATE_DIRTY_PLAYER_PLAYBACK_INFO:
+            STATE_SLOT_SET(p_slot, p_state->player_playback_info);
             break;
             
-        case STATE_WAITING_ENC:
-            if ((event == BLE_GAP_EVT_AUTH_STATUS)|| (event == BLE_GAP_EVT_SEC_INFO_REQUEST))
-            {
-                event_encrypted_link(p_ams, p_ble_evt);
-            }
-            else if (event == BLE_GAP_EVT_DISCONNECTED)
-            {
-                event_disconnect(p_ams);
-            }
+        case BLE_AMS_STATE_DIRTY_PLAYER_VOLUME:
+            STATE_SLOT_SET(p_slot, p_state->player_volume);
             break;
             
-        case STATE_DISC_SERV:
-            if (event == BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP)
-            {
-                event_discover_rsp(p_ams, p_ble_evt);
-            }
-            else if (event == BLE_GAP_EVT_DISCONNECTED)
-            {
-                event_disconnect(p_ams);
-            }
+        case BLE_AMS_STATE_DIRTY_QUEUE_INDEX:
+            STATE_SLOT_SET(p_slot, p_state->queue_index);
             break;
             
-        case STATE_DISC_CHAR:
-            if (event == BLE_GATTC_EVT_CHAR_DISC_RSP)
-            {
-                event_characteristic_rsp(p_ams, p_ble_evt);
-            }
-            else if (event == BLE_GAP_EVT_DISCONNECTED)
-            {
-                event_disconnect(p_ams);
-            }
+        case BLE_AMS_STATE_DIRTY_QUEUE_COUNT:
+            STATE_SLOT_SET(p_slot, p_state->queue_count);
             break;
             
-        case STATE_DISC_DESC:
-            if (event == BLE_GATTC_EVT_DESC_DISC_RSP)
-            {
-                event_descriptor_rsp(p_ams, p_ble_evt);
+        case BLE_AMS_STATE_DIRTY_QUEUE_SHUFFLE_MODE:
+            STATE_SLOT_SET(p_slot, p_state->queue_shuffle_mode);
+            break;
+            
+        case BLE_AMS_STATE_DIRTY_QUEUE_REPEAT_MODE:
+            STATE_SLOT_SET(p_slot, p_state->queue_repeat_mode);
+            break;
+            
+        case BLE_AMS_STATE_DIRTY_TRACK_ARTIST:
+            STATE_SLOT_SET(p_slot, p_state->track_artist);
+            break;
+            
+        case BLE_AMS_STATE_DIRTY_TRACK_ALBUM:
+            STATE_SLOT_SET(p_slot, p_state->track_album);
+            break;
+            
+        case BLE_AMS_STATE_DIRTY_TRACK_TITLE:
+            STATE_SLOT_SET(p_slot, p_state->track_title);
+            break;
+            
+        case BLE_AMS_STATE_DIRTY_TRACK_DURATION:
+            STATE_SLOT_SET(p_slot, p_state->track_duration);
+            break;
+            
+        default:
+            return false;
+    }
+    return true;
+}
+
+/**@brief Function for storing an Entity Update in the media state and marking it dirty.
+ */
+static void state_update(ble_ams_media_state_t               * p_state,
+                         const ble_ams_c_evt_entity_update_t * p_update)
+{
+    state_slot_t slot;
+    uint16_t     len = p_update->value_len;
+    uint8_t      flags = p_update->entity_update_flags;
+    
+    if ((p_update->attribute_id >= BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY) ||
+        !state_slot_get(p_state, p_update->entity_id, p_update->attribute_id, &slot))
+    {
+        return;
+    }
+    
+    if (len > slot.size)
+    {
+        len    = slot.size;
+        flags |= BLE_AMS_ENTITY_UPDATE_FLAG_TRUNCATED;
+    }
+    
+    memcpy(slot.p_value, p_update->p_value, len);
+    slot.p_value[len] = '\0';
+    *slot.p_len       = len;
+    *slot.p_flags     = flags;
+    
+    p_state->dirty |= BLE_AMS_STATE_DIRTY_BIT(p_update->entity_id, p_update->attribute_id);
+}
+
+/**@brief Function for advancing the playback position to the current RTC counter value.
+ */
+static void playback_rebase(ble_ams_c_t * p_ams)
+{
+    ble_ams_playback_t * p_playback = &p_ams->playback;
+    uint32_t             now;
+    uint32_t             ticks;
+    int64_t              delta;
+    
+    (void)app_timer_cnt_get(&now);
+    (void)app_timer_cnt_diff_compute(now, p_playback->anchor_ticks, &ticks);
+    
+    // Carry what does not make a whole microsecond, or frequent calls would lose time.
+    delta = ((int64_t)ticks * (p_ams->timer_prescaler + 1) * PLAYBACK_TICK_US_NUM * p_playback->rate_milli) +
+            p_playback->elapsed_rem;
+    
+    p_playback->elapsed_us  += delta / PLAYBACK_REM_DEN;
+    p_playback->elapsed_rem  = (int32_t)(delta % PLAYBACK_REM_DEN);
+    p_playback->anchor_ticks = now;
+    
+    if (p_playback->elapsed_us < 0)
+    {
+        // Rewound to the start of the track.
+        p_playback->elapsed_us  = 0;
+        p_playback->elapsed_rem = 0;
+    }
+}
+
+/**@brief Function for taking a new Player/PlaybackInfo, "state,rate,elapsed", as the base of the
+ *        playback position.
+ */
+static void playback_info_update(ble_ams_c_t * p_ams, const ble_ams_c_evt_entity_update_t * p_update)
+{
+    ble_ams_playback_t * p_playback = &p_ams->playback;
+    int32_t              values[PLAYBACK_INFO_FIELD_COUNT];
+    int32_t              elapsed;
+    
+    if (ams_parse_milli_list(p_update->p_value,
+                             p_update->value_len,
+                             PLAYBACK_INFO_SEPARATOR,
+                             values,
+                             PLAYBACK_INFO_FIELD_COUNT) != NRF_SUCCESS)
+    {
+        // No media app, or a malformed value.
+        p_playback->valid = false;
+        return;
+    }
+    
+    elapsed = values[PLAYBACK_INFO_FIELD_ELAPSED];
+    
+    if (p_playback->valid)
+    {
+        playback_rebase(p_ams);
+        p_ams->stats.playback_drift_ms = elapsed - (int32_t)(p_playback->elapsed_us / 1000);
+    }
+    else
+    {
+        (void)app_timer_cnt_get(&p_playback->anchor_ticks);
+    }
+    
+    p_playback->state      = (uint8_t)(values[PLAYBACK_INFO_FIELD_STATE] / 1000);
+    p_playback->rate_milli = values[PLAYBACK_INFO_FIELD_RATE];
+    p_playback->elapsed_us  = (int64_t)elapsed * 1000;
+    p_playback->elapsed_rem = 0;
+    p_playback->valid       = true;
+}
+
+/**@brief Function for keeping the numeric playback attributes (PlaybackInfo, Volume, Duration)
+ *        up to date from an Entity Update or an Entity Attribute read.
+ */
+static void playback_attribute_update(ble_ams_c_t * p_ams, const ble_ams_c_evt_entity_update_t * p_update)
+{
+    ble_ams_playback_t * p_playback = &p_ams->playback;
+    int32_t              duration;
+    
+    if (p_update->entity_update_flags & BLE_AMS_ENTITY_UPDATE_FLAG_TRUNCATED)
+    {
+        return;
+    }
+    
+    if (p_update->entity_id == BLE_AMS_ENTITY_ID_PLAYER)
+    {
+        if (p_update->attribute_id == BLE_AMS_PLAYER_ATTRIBUTE_ID_PLAYBACK_INFO)
+        {
+            playback_info_update(p_ams, p_update);
+        }
+        else if (p_update->attribute_id == BLE_AMS_PLAYER_ATTRIBUTE_ID_VOLUME)
+        {
+            if (ams_parse_permille(p_update->p_value,
+                                   p_update->value_len,
+                                   &p_playback->volume_permille) != NRF_SUCCESS)
+            {
+                p_playback->volume_permille = 0;
+            }
+        }
+    }
+    else if ((p_update->entity_id == BLE_AMS_ENTITY_ID_TRACK) &&
+             (p_update->attribute_id == BLE_AMS_TRACK_ATTRIBUTE_ID_DURATION))
+    {
+        if ((ams_parse_milli(p_update->p_value,
+                             p_update->value_len,
+                             AMS_PARSE_SEPARATOR_NONE,
+                             &duration,
+                             NULL) != NRF_SUCCESS) ||
+            (duration < 0))
+        {
+            duration = 0;
+        }
+        p_playback->duration_ms = (uint32_t)duration;
+    }
+}
+
+/**@brief Function for adding data to an FNV-1a hash.
+ */
+static uint32_t fnv1a_add(uint32_t hash, const uint8_t * p_data, uint16_t len)
+{
+    uint16_t i;
+    
+    for (i = 0; i < len; i++)
+    {
+        hash = (hash ^ p_data[i]) * FNV1A_PRIME;
+    }
+    
+    return hash;
+}
+
+/**@brief Function for adding a media state slot, length and value, to an FNV-1a hash.
+ */
+static uint32_t fnv1a_slot_add(uint32_t hash, uint8_t len, const char * p_value)
+{
+    // The length is hashed too, so that text moving between attributes changes the hash.
+    hash = fnv1a_add(hash, &len, 1);
+    return fnv1a_add(hash, (const uint8_t *)p_value, len);
+}
+
+/**@brief Function for sending BLE_AMS_C_EVT_TRACK_CHANGED, unless the Track attributes are the
+ *        same as at the last one.
+ */
+static void track_changed_send(ble_ams_c_t * p_ams)
+{
+    const ble_ams_media_state_t * p_state = &p_ams->media_state;
+    ble_ams_c_evt_t               event;
+    uint32_t                      hash    = FNV1A_OFFSET_BASIS;
+    
+    hash = fnv1a_slot_add(hash, p_state->track_artist.len, p_state->track_artist.value);
+    hash = fnv1a_slot_add(hash, p_state->track_album.len, p_state->track_album.value);
+    hash = fnv1a_slot_add(hash, p_state->track_title.len, p_state->track_title.value);
+    hash = fnv1a_slot_add(hash, p_state->track_duration.len, p_state->track_duration.value);
+    
+    p_ams->track_received = 0;
+    
+    if (hash == p_ams->track_hash)
+    {
+        // iOS sent the same track again.
+        p_ams->stats.track_changes_suppressed++;
+        return;
+    }
+    p_ams->track_hash = hash;
+    
+    event.evt_type        = BLE_AMS_C_EVT_TRACK_CHANGED;
+    event.data.track_hash = hash;
+    p_ams->evt_handler(&event);
+}
+
+/**@brief Function for handling the end of the quiet window of a track change.
+ *
+ * @details Runs at the same interrupt priority as the BLE event dispatch, so it cannot preempt
+ *          the handling of a Track update.
+ */
+static void track_timeout_handler(void * p_context)
+{
+    ble_ams_c_t * p_ams = (ble_ams_c_t *)p_context;
+    
+    if (p_ams->track_received != 0)
+    {
+        track_changed_send(p_ams);
+    }
+}
+
+/**@brief Function for noting the complete value of a Track attribute.
+ *
+ * @details iOS sends every Track attribute of a new song as its own Entity Update, often over
+ *          several connection events. BLE_AMS_C_EVT_TRACK_CHANGED is sent once all subscribed
+ *          attributes have arrived, or when no further one arrived within the quiet window.
+ */
+static void track_attribute_received(ble_ams_c_t * p_ams, uint8_t entity_id, uint8_t attribute_id)
+{
+    if ((entity_id != BLE_AMS_ENTITY_ID_TRACK) ||
+        (attribute_id >= BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY))
+    {
+        return;
+    }
+    
+    p_ams->track_received |= (1 << attribute_id);
+    
+    if (p_ams->track_quiet_ticks != 0)
+    {
+        (void)app_timer_stop(p_ams->track_timer);
+    }
+    
+    if ((p_ams->track_received & p_ams->track_subscribed) == p_ams->track_subscribed)
+    {
+        track_changed_send(p_ams);
+    }
+    else if (p_ams->track_quiet_ticks != 0)
+    {
+        // Restart the quiet window.
+        (void)app_timer_start(p_ams->track_timer, p_ams->track_quiet_ticks, p_ams);
+    }
+}
+
+/**@brief Function for starting the long read of the next pending truncated attribute.
+ *
+ * @details The EntityID/AttributeID write and the first read are queued back to back, so the
+ *          read goes out as soon as the write has been acknowledged.
+ */
+static void attr_read_next(ble_ams_c_t * p_ams)
+{
+    uint8_t  cmd[ENTITY_ATTRIBUTE_CMD_LENGTH];
+    uint8_t  bit_index;
+    
+    // Wait for room for both the write and the read, it is retried on the next response.
+    if ((p_ams->attr_read.current != 0) || (p_ams->attr_read.pending == 0) || (tx_buffer_free_count(p_ams) < 2))
+    {
+        return;
+    }
+    
+    for (bit_index = 0; (p_ams->attr_read.pending & (1 << bit_index)) == 0; bit_index++)
+    {
+        // Find the lowest pending attribute.
+    }
+    
+    p_ams->attr_read.current     = (1 << bit_index);
+    p_ams->attr_read.pending    &= ~p_ams->attr_read.current;
+    p_ams->attr_read.offset      = 0;
+    p_ams->attr_read.round_trips = 2;
+    
+    cmd[0] = bit_index / BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY;
+    cmd[1] = bit_index % BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY;
+    
+    (void)tx_write_queue(p_ams,
+                         p_ams->service.entity_attribute_handle,
+                         cmd,
+                         sizeof(cmd),
+                         BLE_GATT_OP_WRITE_REQ);
+    (void)tx_read_queue(p_ams, p_ams->service.entity_attribute_handle, 0);
+    tx_buffer_process(p_ams);
+}
+
+/**@brief Function for completing the current long read and passing the value to the application.
+ */
+static void attr_read_complete(ble_ams_c_t * p_ams, bool truncated)
+{
+    ble_ams_c_evt_t               event;
+    ble_ams_c_evt_entity_update_t update;
+    uint8_t                       bit_index;
+    
+    for (bit_index = 0; (p_ams->attr_read.current & (1 << bit_index)) == 0; bit_index++)
+    {
+        // Find the attribute being read.
+    }
+    
+    event.evt_type                             = BLE_AMS_C_EVT_ENTITY_ATTRIBUTE_READ;
+    event.data.entity_attribute.entity_id      = bit_index / BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY;
+    event.data.entity_attribute.attribute_id   = bit_index % BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY;
+    event.data.entity_attribute.truncated      = truncated;
+    event.data.entity_attribute.round_trips    = p_ams->attr_read.round_trips;
+    event.data.entity_attribute.value_len      = p_ams->attr_read.offset;
+    event.data.entity_attribute.p_value        = p_ams->p_message_buffer;
+    
+    p_ams->attr_read.current = 0;
+    
+    // Replace the truncated value in the media state with the full one.
+    update.entity_id           = event.data.entity_attribute.entity_id;
+    update.attribute_id        = event.data.entity_attribute.attribute_id;
+    update.entity_update_flags = truncated ? BLE_AMS_ENTITY_UPDATE_FLAG_TRUNCATED : 0;
+    update.value_len           = p_ams->attr_read.offset;
+    update.p_value             = p_ams->p_message_buffer;
+    
+    state_update(&p_ams->media_state, &update);
+    playback_attribute_update(p_ams, &update);
+    
+    p_ams->evt_handler(&event);
+    
+    track_attribute_received(p_ams, update.entity_id, update.attribute_id);
+    
+    attr_read_next(p_ams);
+}
+
+/**@brief Function for requesting the full value of a truncated attribute, the read is started
+ *        by @ref attr_read_next.
+ */
+static void attr_read_request(ble_ams_c_t * p_ams, uint8_t entity_id, uint8_t attribute_id)
+{
+    uint16_t bit;
+    
+    if ((p_ams->p_message_buffer == NULL) ||
+        (p_ams->message_buffer_size == 0) ||
+        (attribute_id >= BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY) ||
+        (entity_id > BLE_AMS_ENTITY_ID_TRACK))
+    {
+        return;
+    }
+    
+    bit = BLE_AMS_STATE_DIRTY_BIT(entity_id, attribute_id);
+    
+    if (p_ams->attr_read.current != bit)
+    {
+        p_ams->attr_read.pending |= bit;
+    }
+}
+
+/**@brief Function for handling read responses from the Entity Attribute characteristic.
+ *
+ * @details A full response means more data may follow, in that case a Read Blob Request for the
+ *          next offset is queued. A short response, or an error on a continuation, ends the read.
+ */
+static void event_read_rsp(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
+{
+    uint16_t len   = p_ble_evt->evt.gattc_evt.params.read_rsp.len;
+    uint16_t space = p_ams->message_buffer_size - p_ams->attr_read.offset;
+    
+    p_ams->tx_request_pending = false;
+    
+    if (cached_handle_error_check(p_ams, p_ble_evt))
+    {
+        return;
+    }
+    
+    if ((p_ams->attr_read.current == 0) ||
+        (p_ble_evt->evt.gattc_evt.params.read_rsp.handle != p_ams->service.entity_attribute_handle))
+    {
+        tx_buffer_process(p_ams);
+        return;
+    }
+    
+    if (p_ble_evt->evt.gattc_evt.gatt_status != BLE_GATT_STATUS_SUCCESS)
+    {
+        // An error on a continuation means the previous response held the last bytes.
+        if (p_ams->attr_read.offset == 0)
+        {
+            p_ams->attr_read.current = 0;
+            attr_read_next(p_ams);
+        }
+        else
+        {
+            attr_read_complete(p_ams, false);
+        }
+        tx_buffer_process(p_ams);
+        return;
+    }
+    
+    if (len > space)
+    {
+        memcpy(&p_ams->p_message_buffer[p_ams->attr_read.offset],
+               p_ble_evt->evt.gattc_evt.params.read_rsp.data,
+               space);
+        p_ams->attr_read.offset += space;
+        attr_read_complete(p_ams, true);
+    }
+    else
+    {
+        memcpy(&p_ams->p_message_buffer[p_ams->attr_read.offset],
+               p_ble_evt->evt.gattc_evt.params.read_rsp.data,
+               len);
+        p_ams->attr_read.offset += len;
+        
+        if ((len < ATT_READ_RSP_MAX_LENGTH) || (p_ams->attr_read.offset == p_ams->message_buffer_size))
+        {
+            attr_read_complete(p_ams, (len == ATT_READ_RSP_MAX_LENGTH));
+        }
+        else if (tx_read_queue(p_ams,
+                               p_ams->service.entity_attribute_handle,
+                               p_ams->attr_read.offset) == NRF_SUCCESS)
+        {
+            p_ams->attr_read.round_trips++;
+        }
+        else
+        {
+            attr_read_complete(p_ams, true);
+        }
+    }
+    tx_buffer_process(p_ams);
+}
+
+/**@brief Function for handling write response events.
+ */
+static void event_write_rsp(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
+{
+    p_ams->tx_request_pending = false;
+    
+    if (cached_handle_error_check(p_ams, p_ble_evt))
+    {
+        return;
+    }
+    
+    if ((p_ams->subscribe_pending > 0) &&
+        (p_ble_evt->evt.gattc_evt.params.write_rsp.handle == p_ams->service.entity_update_handle))
+    {
+        if ((p_ams->subscribe_status == NRF_SUCCESS) &&
+            (p_ble_evt->evt.gattc_evt.gatt_status != BLE_GATT_STATUS_SUCCESS))
+        {
+            p_ams->subscribe_status = p_ble_evt->evt.gattc_evt.gatt_status;
+        }
+        
+        if (--p_ams->subscribe_pending == 0)
+        {
+            ble_ams_c_evt_t event;
+            
+            event.evt_type        = BLE_AMS_C_EVT_ENTITY_UPDATE_SUBSCRIBED;
+            event.data.error_code = p_ams->subscribe_status;
+            p_ams->evt_handler(&event);
+        }
+    }
+    
+    tx_buffer_process(p_ams);
+    attr_read_next(p_ams);
+}
+
+/**@brief Function for decoding the list of supported commands notified on Remote Command.
+ *
+ * @details Each byte of the notification is a RemoteCommandID supported by the current media app.
+ *
+ * @return true if the set has changed and p_event is to be passed to the application.
+ */
+static bool remote_command_decode(ble_ams_c_t     * p_ams,
+                                  const uint8_t   * p_data,
+                                  uint16_t          len,
+                                  ble_ams_c_evt_t * p_event)
+{
+    uint16_t supported = 0;
+    uint16_t i;
+    
+    for (i = 0; i < len; i++)
+    {
+        if (p_data[i] < 16)
+        {
+            supported |= (1 << p_data[i]);
+        }
+    }
+    
+    if (supported == p_ams->supported_commands)
+    {
+        return false;
+    }
+    p_ams->supported_commands = supported;
+    
+    p_event->evt_type                = BLE_AMS_C_EVT_SUPPORTED_COMMANDS_UPDATE;
+    p_event->data.supported_commands = supported;
+    return true;
+}
+
+/**@brief Function for checking whether an Entity Update repeats the last value notified for
+ *        its attribute, and remembering the value otherwise.
+ *
+ * @details Only the length and a hash of the value are kept. A truncated value is never taken as
+ *          a repeat, as the rest of it may differ.
+ */
+static bool entity_update_is_repeat(ble_ams_c_t * p_ams, const ble_ams_c_evt_entity_update_t * p_update)
+{
+    ble_ams_c_fingerprint_t * p_fingerprint;
+    uint16_t                  index;
+    uint32_t                  hash;
+    
+    if (p_update->attribute_id >= BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY)
+    {
+        return false;
+    }
+    
+    index         = (p_update->entity_id * BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY) + p_update->attribute_id;
+    p_fingerprint = &p_ams->fingerprint[index];
+    
+    if (p_update->entity_update_flags & BLE_AMS_ENTITY_UPDATE_FLAG_TRUNCATED)
+    {
+        p_ams->fingerprint_valid &= ~(1 << index);
+        return false;
+    }
+    
+    hash = fnv1a_add(FNV1A_OFFSET_BASIS, p_update->p_value, p_update->value_len);
+    
+    if ((p_ams->fingerprint_valid & (1 << index)) &&
+        (p_fingerprint->len == p_update->value_len) &&
+        (p_fingerprint->hash == hash))
+    {
+        return true;
+    }
+    
+    p_fingerprint->len        = p_update->value_len;
+    p_fingerprint->hash       = hash;
+    p_ams->fingerprint_valid |= (1 << index);
+    
+    return false;
+}
+
+/**@brief Function for decoding an Entity Update notification into the media state.
+ *
+ * @details The notification is decoded in place, the event for the application points into the
+ *          notification so no part of it is copied. @ref entity_update_note is to be called
+ *          once the application has seen the event, or in the same critical region.
+ *
+ * @return true if p_event is to be passed to the application.
+ */
+static bool entity_update_decode(ble_ams_c_t     * p_ams,
+                                 const uint8_t   * p_data,
+                                 uint16_t          len,
+                                 ble_ams_c_evt_t * p_event)
+{
+    if (len < ENTITY_UPDATE_HEADER_LENGTH)
+    {
+        return false;
+    }
+    
+    switch (p_data[0])
+    {
+        case BLE_AMS_ENTITY_ID_PLAYER:
+            p_event->evt_type = BLE_AMS_C_EVT_PLAYER_UPDATE;
+            break;
+            
+        case BLE_AMS_ENTITY_ID_QUEUE:
+            p_event->evt_type = BLE_AMS_C_EVT_QUEUE_UPDATE;
+            break;
+            
+        case BLE_AMS_ENTITY_ID_TRACK:
+            p_event->evt_type = BLE_AMS_C_EVT_TRACK_UPDATE;
+            break;
+            
+        default:
+            // Unknown entity, ignore.
+            return false;
+    }
+    
+    p_event->data.entity_update.entity_id           = p_data[0];
+    p_event->data.entity_update.attribute_id        = p_data[1];
+    p_event->data.entity_update.entity_update_flags = p_data[2];
+    p_event->data.entity_update.value_len           = len - ENTITY_UPDATE_HEADER_LENGTH;
+    p_event->data.entity_update.p_value             = &p_data[ENTITY_UPDATE_HEADER_LENGTH];
+    
+    if (entity_update_is_repeat(p_ams, &p_event->data.entity_update))
+    {
+        // iOS re-sends unchanged values, e.g. on every app switch.
+        p_ams->stats.entity_updates_suppressed++;
+        return false;
+    }
+    
+    state_update(&p_ams->media_state, &p_event->data.entity_update);
+    playback_attribute_update(p_ams, &p_event->data.entity_update);
+    
+    return true;
+}
+
+/**@brief Function for noting the work an Entity Update leads to: reading the rest of a
+ *        truncated value, or counting a Track attribute towards the track change.
+ *
+ * @details Only updates the client state, so it may run inside a critical region. The work is
+ *          done by @ref entity_update_work.
+ */
+static void entity_update_note(ble_ams_c_t * p_ams, const uint8_t * p_data, uint16_t len)
+{
+    if (len < ENTITY_UPDATE_HEADER_LENGTH)
+    {
+        return;
+    }
+    
+    if (p_data[2] & BLE_AMS_ENTITY_UPDATE_FLAG_TRUNCATED)
+    {
+        attr_read_request(p_ams, p_data[0], p_data[1]);
+    }
+    
+    if ((!(p_data[2] & BLE_AMS_ENTITY_UPDATE_FLAG_TRUNCATED) || (p_ams->p_message_buffer == NULL)) &&
+        (p_data[0] == BLE_AMS_ENTITY_ID_TRACK) &&
+        (p_data[1] < BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY))
+    {
+        // A truncated value is complete once read through Entity Attribute. A repeated Track
+        // attribute still counts towards the track change in progress.
+        p_ams->track_arrived |= (1 << p_data[1]);
+    }
+}
+
+/**@brief Function for doing the work noted by @ref entity_update_note: sending the track
+ *        change and starting the next long read.
+ *
+ * @details Runs at the priority of the BLE stack events, it calls the application and the stack.
+ */
+static void entity_update_work(ble_ams_c_t * p_ams)
+{
+    uint8_t arrived = p_ams->track_arrived;
+    uint8_t attribute_id;
+    
+    p_ams->track_arrived = 0;
+    
+    for (attribute_id = 0; arrived != 0; attribute_id++, arrived >>= 1)
+    {
+        if (arrived & 1)
+        {
+            track_attribute_received(p_ams, BLE_AMS_ENTITY_ID_TRACK, attribute_id);
+        }
+    }
+    
+    attr_read_next(p_ams);
+}
+
+/**@brief Function for checking that a deferred notification belongs to the current connection
+ *        and service.
+ */
+static bool hvx_deferred_is_current(const ble_ams_c_t * p_ams, const ble_ams_c_hvx_evt_t * p_hvx)
+{
+    return (p_hvx->conn_handle == p_ams->conn_handle) &&
+           (p_ams->client_state == BLE_AMS_C_STATE_RUNNING);
+}
+
+/**@brief Function for processing a notification from the main loop, called by app_scheduler.
+ *
+ * @details The client state is also updated from the BLE stack event context, so it is only
+ *          accessed inside a critical region, which decodes the notification and notes the work
+ *          it leads to. The application handles the event outside of it, and the noted work
+ *          (track change, long reads) runs from BLE_AMS_C_KICK_IRQn.
+ */
+static void hvx_deferred_handler(void * p_event_data, uint16_t event_size)
+{
+    ble_ams_c_hvx_evt_t * p_hvx   = (ble_ams_c_hvx_evt_t *)p_event_data;
+    ble_ams_c_t *         p_ams   = p_hvx->p_ams;
+    ble_ams_c_evt_t       event;
+    bool                  deliver = false;
+    uint8_t               nested;
+    
+    UNUSED_PARAMETER(event_size);
+    
+    (void)sd_nvic_critical_region_enter(&nested);
+    p_ams->hvx_done_count++;
+    if (hvx_deferred_is_current(p_ams, p_hvx))
+    {
+        if (p_hvx->handle == p_ams->service.entity_update_handle)
+        {
+            deliver = entity_update_decode(p_ams, p_hvx->data, p_hvx->len, &event);
+            entity_update_note(p_ams, p_hvx->data, p_hvx->len);
+        }
+        else if (p_hvx->handle == p_ams->service.remote_command_handle)
+        {
+            deliver = remote_command_decode(p_ams, p_hvx->data, p_hvx->len, &event);
+        }
+    }
+    (void)sd_nvic_critical_region_exit(nested);
+    
+    if (deliver)
+    {
+        p_ams->evt_handler(&event);
+    }
+    
+    // Send the track change and start a long read at the priority of the BLE stack events, once
+    // the application has seen the update.
+    NVIC_SetPendingIRQ(BLE_AMS_C_KICK_IRQn);
+}
+
+/**@brief Function for copying a notification into the app_scheduler queue.
+ *
+ * @details Only the header and the received bytes are copied. The notification is dropped if
+ *          the queue is full.
+ */
+static void hvx_defer(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
+{
+    ble_ams_c_hvx_evt_t hvx;
+    uint16_t            len = p_ble_evt->evt.gattc_evt.params.hvx.len;
+    uint32_t            depth;
+    
+    if (len > BLE_AMS_C_HVX_DATA_MAX)
+    {
+        p_ams->stats.hvx_dropped++;
+        return;
+    }
+    
+    hvx.p_ams       = p_ams;
+    hvx.conn_handle = p_ams->conn_handle;
+    hvx.handle      = p_ble_evt->evt.gattc_evt.params.hvx.handle;
+    hvx.len         = len;
+    memcpy(hvx.data, p_ble_evt->evt.gattc_evt.params.hvx.data, len);
+    
+    if (app_sched_event_put(&hvx,
+                            offsetof(ble_ams_c_hvx_evt_t, data) + len,
+                            hvx_deferred_handler) != NRF_SUCCESS)
+    {
+        p_ams->stats.hvx_dropped++;
+        return;
+    }
+    
+    p_ams->hvx_put_count++;
+    depth = p_ams->hvx_put_count - p_ams->hvx_done_count;
+    if (depth > p_ams->stats.hvx_queue_high_water)
+    {
+        p_ams->stats.hvx_queue_high_water = depth;
+    }
+}
+
+/**@brief Function for receiving and validating notifications received from the master.
+ */
+static void event_notify(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
+{
+    uint16_t        handle = p_ble_evt->evt.gattc_evt.params.hvx.handle;
+    const uint8_t * p_data = p_ble_evt->evt.gattc_evt.params.hvx.data;
+    uint16_t        len    = p_ble_evt->evt.gattc_evt.params.hvx.len;
+    ble_ams_c_evt_t event;
+    
+    if (p_ble_evt->evt.gattc_evt.params.hvx.type == BLE_GATT_HVX_INDICATION)
+    {
+        if (handle == p_ams->service.service_changed_handle)
+        {
+            // The handles of AMS may have moved, the cached ones are no longer to be trusted.
+            p_ams->stats.service_changed++;
+            service_rediscover(p_ams);
+        }
+    }
+    else if (p_ams->hvx_deferred &&
+             ((handle == p_ams->service.entity_update_handle) ||
+              (handle == p_ams->service.remote_command_handle)))
+    {
+        hvx_defer(p_ams, p_ble_evt);
+    }
+    else if (handle == p_ams->service.entity_update_handle)
+    {
+        if (entity_update_decode(p_ams, p_data, len, &event))
+        {
+            p_ams->evt_handler(&event);
+        }
+        entity_update_note(p_ams, p_data, len);
+        entity_update_work(p_ams);
+    }
+    else if (handle == p_ams->service.remote_command_handle)
+    {
+        if (remote_command_decode(p_ams, p_data, len, &event))
+        {
+            p_ams->evt_handler(&event);
+        }
+    }
+}
+
+/**@brief Function for handling of BLE stack events.
+ */
+static void ble_evt_handle(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
+{
+    uint16_t event = p_ble_evt->header.evt_id;
+    
+    if (event == BLE_EVT_TX_COMPLETE)
+    {
+        // Every instance sees the event, the first one takes the buffers back for all links.
+        if (p_ams == m_instances[0])
+        {
+            tx_buffers_return(p_ble_evt->evt.common_evt.conn_handle,
+                              p_ble_evt->evt.common_evt.params.tx_complete.count);
+        }
+        return;
+    }
+    
+    if (event == BLE_GAP_EVT_CONNECTED)
+    {
+        if (!instance_claim(p_ams, p_ble_evt->evt.gap_evt.conn_handle))
+        {
+            // Served by another instance, or all instances are busy.
+            return;
+        }
+    }
+    else if (evt_conn_handle_get(p_ble_evt) != p_ams->conn_handle)
+    {
+        // Event for a link served by another instance.
+        return;
+    }
+    
+    if (event == BLE_GAP_EVT_CONN_PARAM_UPDATE)
+    {
+        local_latency_apply(p_ams);
+        return;
+    }
+    
+    if ((event == BLE_GATTC_EVT_HVX) &&
+        (p_ble_evt->evt.gattc_evt.params.hvx.type == BLE_GATT_HVX_INDICATION))
+    {
+        // Confirm every indication, in any state, or the master sends no further ones.
+        (void)sd_ble_gattc_hv_confirm(p_ams->conn_handle, p_ble_evt->evt.gattc_evt.params.hvx.handle);
+    }
+    
+    switch (p_ams->client_state)
+    {
+        case BLE_AMS_C_STATE_UNINITIALIZED:
+            // Initialization is handle in special case, thus if we enter here, it means that an
+            // event is received even though we are not initialized --> ignore.
+            break;
+            
+        case BLE_AMS_C_STATE_IDLE:
+            if (event == BLE_GAP_EVT_CONNECTED)
+            {
+                event_connect(p_ams, p_ble_evt);
+            }
+            break;
+            
+        case BLE_AMS_C_STATE_DISC_SERV:
+            if (event == BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP)
+            {
+                event_discover_rsp(p_ams, p_ble_evt);
+            }
+            else if (event == BLE_GAP_EVT_DISCONNECTED)
+            {
+                event_disconnect(p_ams);
+            }
+            break;
+            
+        case BLE_AMS_C_STATE_DISC_CHAR:
+            if (event == BLE_GATTC_EVT_CHAR_DISC_RSP)
+            {
+                event_characteristic_rsp(p_ams, p_ble_evt);
+            }
+            else if (event == BLE_GAP_EVT_DISCONNECTED)
+            {
+                event_disconnect(p_ams);
+            }
+            break;
+            
+        case BLE_AMS_C_STATE_DISC_DESC:
+            if (event == BLE_GATTC_EVT_DESC_DISC_RSP)
+            {
+                event_descriptor_rsp(p_ams, p_ble_evt);
+            }
+            else if (event == BLE_GAP_EVT_DISCONNECTED)
+            {
+                event_disconnect(p_ams);
+            }
+            break;
+            
+        case BLE_AMS_C_STATE_DISC_SC:
+            if ((event == BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP) ||
+                (event == BLE_GATTC_EVT_CHAR_DISC_RSP)      ||
+                (event == BLE_GATTC_EVT_DESC_DISC_RSP))
+            {
+                event_service_changed_rsp(p_ams, p_ble_evt);
+            }
+            else if (event == BLE_GAP_EVT_DISCONNECTED)
+            {
+                event_disconnect(p_ams);
+            }
+            break;
+            
+        case BLE_AMS_C_STATE_WAITING_ENC:
+            if ((event == BLE_GATTC_EVT_HVX) &&
+                (p_ble_evt->evt.gattc_evt.params.hvx.type == BLE_GATT_HVX_INDICATION))
+            {
+                // Service Changed may come before the link is encrypted, the cache is stale then.
+                event_notify(p_ams, p_ble_evt);
             }
             else if (event == BLE_GAP_EVT_DISCONNECTED)
             {
@@ -649,7 +2243,7 @@ void ble_ams_c_on_ble_evt(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
             }
             break;
             
-        case STATE_RUNNING:
+        case BLE_AMS_C_STATE_RUNNING:
             if (event == BLE_GATTC_EVT_HVX)
             {
                 event_notify(p_ams, p_ble_evt);
@@ -658,6 +2252,17 @@ void ble_ams_c_on_ble_evt(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
             {
                 event_write_rsp(p_ams, p_ble_evt);
             }
+            else if (event == BLE_GATTC_EVT_READ_RSP)
+            {
+                event_read_rsp(p_ams, p_ble_evt);
+            }
+            else if ((event == BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP) ||
+                     (event == BLE_GATTC_EVT_CHAR_DISC_RSP)      ||
+                     (event == BLE_GATTC_EVT_DESC_DISC_RSP))
+            {
+                // A discovery overtaken by the service cache has ended, the stack is free again.
+                tx_buffer_process(p_ams);
+            }
             else if (event == BLE_GAP_EVT_DISCONNECTED)
             {
                 event_disconnect(p_ams);
@@ -668,7 +2273,7 @@ void ble_ams_c_on_ble_evt(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
             }
             break;
             
-        case STATE_RUNNING_NOT_DISCOVERED:
+        case BLE_AMS_C_STATE_RUNNING_NOT_DISCOVERED:
         default:
             if (event == BLE_GAP_EVT_DISCONNECTED)
             {
@@ -678,28 +2283,35 @@ void ble_ams_c_on_ble_evt(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
     }
 }
 
-static void ams_pstorage_callback(pstorage_handle_t * handle,
-                                   uint8_t             op_code,
-                                   uint32_t            reason,
-                                   uint8_t           * p_data,
-                                   uint32_t            param_len)
+void ble_ams_c_on_ble_evt(ble_ams_c_t * p_ams, const ble_evt_t * p_ble_evt)
 {
-    if (reason != NRF_SUCCESS)
-    {
-        m_ams_c_obj->error_handler(reason);
-    }
+    ble_evt_handle(p_ams, p_ble_evt);
+    activity_update(p_ams);
 }
 
 uint32_t ble_ams_c_init(ble_ams_c_t * p_ams, const ble_ams_c_init_t * p_ams_init)
 {
-    uint32_t                err_code;
-    pstorage_module_param_t param;
+    uint32_t err_code;
+    uint32_t i;
     
     if (p_ams_init->evt_handler == NULL)
     {
         return NRF_ERROR_INVALID_PARAM;
     }
     
+    for (i = 0; (i < m_instance_count) && (m_instances[i] != p_ams); i++)
+    {
+        // Look for a re-initialized instance.
+    }
+    if (i == m_instance_count)
+    {
+        if (m_instance_count == BLE_AMS_C_MAX_INSTANCES)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+        m_instances[m_instance_count++] = p_ams;
+    }
+    
     p_ams->evt_handler         = p_ams_init->evt_handler;
     p_ams->error_handler       = p_ams_init->error_handler;
     p_ams->service_handle      = INVALID_SERVICE_HANDLE;
@@ -708,136 +2320,465 @@ uint32_t ble_ams_c_init(ble_ams_c_t * p_ams, const ble_ams_c_init_t * p_ams_init
     p_ams->message_buffer_size = p_ams_init->message_buffer_size;
     p_ams->p_message_buffer    = p_ams_init->p_message_buffer;
     p_ams->conn_handle         = BLE_CONN_HANDLE_INVALID;
+    p_ams->tx_policy           = p_ams_init->tx_policy;
+    p_ams->supported_commands  = BLE_AMS_SUPPORTED_COMMANDS_UNKNOWN;
+    p_ams->timer_prescaler     = p_ams_init->timer_prescaler;
+    p_ams->track_quiet_ticks   = p_ams_init->track_quiet_ticks;
+    p_ams->hvx_deferred        = p_ams_init->hvx_deferred;
+    p_ams->hvx_put_count       = 0;
+    p_ams->hvx_done_count      = 0;
+    p_ams->cmd_put_index       = 0;
+    p_ams->cmd_get_index       = 0;
+    p_ams->busy                = false;
+    p_ams->latency_policy      = p_ams_init->latency_policy;
+    p_ams->idle_local_latency  = p_ams_init->idle_local_latency;
     
-    memset(&m_service, 0, sizeof(apple_service_t));
-    memset(m_tx_buffer, 0, TX_BUFFER_SIZE);
+    memset(&p_ams->stats, 0, sizeof(ble_ams_c_stats_t));
+    memset(&p_ams->media_state, 0, sizeof(ble_ams_media_state_t));
+    memset(&p_ams->playback, 0, sizeof(ble_ams_playback_t));
+    memset(&p_ams->service, 0, sizeof(ble_ams_c_service_record_t));
+    memset(p_ams->tx_buffer, 0, sizeof(p_ams->tx_buffer));
+    p_ams->tx_insert_index = 0;
+    p_ams->tx_index        = 0;
     
-    m_service.handle = INVALID_SERVICE_HANDLE;
-    m_client_state   = STATE_IDLE;
+    p_ams->service_cached = false;
+    p_ams->client_state   = BLE_AMS_C_STATE_IDLE;
     
-    param.block_count = 1;
-    param.block_size  = DISCOVERED_SERVICE_DB_SIZE * sizeof(uint32_t); // uint32_t array.
-    param.cb          = ams_pstorage_callback;
+    p_ams->dm_handle.connection_id = DM_INVALID_ID;
+    p_ams->dm_handle.device_id     = DM_INVALID_ID;
+    memset(SERVICE_RECORD(p_ams), 0, sizeof(ble_ams_c_service_record_t));
+    memset(&p_ams->service_stored, 0, sizeof(ble_ams_c_service_record_t));
+    p_ams->service_record_dirty = false;
     
-    // Register with storage module.
-    err_code = pstorage_register(&param, &m_flash_handle);
+    p_ams->track_subscribed  = 0;
+    p_ams->track_received    = 0;
+    p_ams->track_hash        = 0;
+    p_ams->fingerprint_valid = 0;
     
-    mp_service_db    = (apple_service_t *) (m_service_db);
+    err_code = sd_nvic_SetPriority(BLE_AMS_C_KICK_IRQn, APP_IRQ_PRIORITY_LOW);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
     
-    return err_code;
+    err_code = sd_nvic_EnableIRQ(BLE_AMS_C_KICK_IRQn);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+    
+    if (p_ams->track_quiet_ticks != 0)
+    {
+        return app_timer_create(&p_ams->track_timer,
+                                APP_TIMER_MODE_SINGLE_SHOT,
+                                track_timeout_handler);
+    }
+    
+    return NRF_SUCCESS;
 }
 
 /**@brief Function for creating a TX message for writing a CCCD.
  */
-static uint32_t cccd_configure(uint16_t conn_handle, uint16_t handle_cccd, bool enable)
+static uint32_t cccd_configure(ble_ams_c_t * p_ams, uint16_t handle_cccd, bool enable)
 {
-    tx_message_t * p_msg;
-    uint16_t       cccd_val = enable ? 0x0001 : 0;
+    uint32_t err_code;
+    uint16_t cccd_val = enable ? 0x0001 : 0;
+    uint8_t  value[2];
     
-    if (m_client_state != STATE_RUNNING)
+    if (p_ams->client_state != BLE_AMS_C_STATE_RUNNING)
     {
         return NRF_ERROR_INVALID_STATE;
     }
     
-    p_msg              = &m_tx_buffer[m_tx_insert_index++];
-    m_tx_insert_index &= TX_BUFFER_MASK;
+    value[0] = LSB(cccd_val);
+    value[1] = MSB(cccd_val);
     
-    p_msg->req.write_req.gattc_params.handle   = handle_cccd;
-    p_msg->req.write_req.gattc_params.len      = 2;
-    p_msg->req.write_req.gattc_params.p_value  = p_msg->req.write_req.gattc_value;
-    p_msg->req.write_req.gattc_params.offset   = 0;
-    p_msg->req.write_req.gattc_params.write_op = BLE_GATT_OP_WRITE_REQ;
-    p_msg->req.write_req.gattc_value[0]        = LSB(cccd_val);
-    p_msg->req.write_req.gattc_value[1]        = MSB(cccd_val);
-    p_msg->conn_handle                         = conn_handle;
-    p_msg->type                                = WRITE_REQ;
+    err_code = tx_write_queue(p_ams, handle_cccd, value, sizeof(value), BLE_GATT_OP_WRITE_REQ);
+    tx_buffer_process(p_ams);
+    return err_code;
+}
+
+uint32_t ble_ams_c_entity_update_subscribe(ble_ams_c_t   * p_ams,
+                                           uint8_t         entity_id,
+                                           const uint8_t * p_attrs,
+                                           uint8_t         count)
+{
+    uint32_t err_code;
+    uint8_t  value[1 + BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY];
+    uint8_t  i;
     
-    tx_buffer_process();
-    return NRF_SUCCESS;
+    if ((entity_id > BLE_AMS_ENTITY_ID_TRACK) ||
+        (count == 0) ||
+        (count > BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY) ||
+        (p_attrs == NULL))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    
+    if (p_ams->client_state != BLE_AMS_C_STATE_RUNNING)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    
+    // The CCCD write and the subscription writes are queued back to back.
+    if (!p_ams->entity_update_cccd_enabled)
+    {
+        if (tx_buffer_free_count(p_ams) < 2)
+        {
+            return NRF_ERROR_NO_MEM;
+        }
+        
+        err_code = cccd_configure(p_ams, p_ams->service.entity_update_cccd, true);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+        p_ams->entity_update_cccd_enabled = true;
+    }
+    
+    value[0] = entity_id;
+    for (i = 0; i < count; i++)
+    {
+        value[i + 1] = p_attrs[i];
+    }
+    
+    if (tx_buffer_free_count(p_ams) == 0)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+    
+    if (p_ams->subscribe_pending == 0)
+    {
+        p_ams->subscribe_status = NRF_SUCCESS;
+    }
+    p_ams->subscribe_pending++;
+    
+    err_code = tx_write_queue(p_ams,
+                              p_ams->service.entity_update_handle,
+                              value,
+                              count + 1,
+                              BLE_GATT_OP_WRITE_REQ);
+    
+    if ((err_code == NRF_SUCCESS) && (entity_id == BLE_AMS_ENTITY_ID_TRACK))
+    {
+        // Track changes are reported once every subscribed attribute has arrived.
+        for (i = 0; i < count; i++)
+        {
+            if (p_attrs[i] < BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY)
+            {
+                p_ams->track_subscribed |= (1 << p_attrs[i]);
+            }
+        }
+    }
+    
+    tx_buffer_process(p_ams);
+    return err_code;
 }
 
-uint32_t ble_ams_c_enable_notif_remote_control(const ble_ams_c_t * p_ams)
+uint32_t ble_ams_c_enable_notif_remote_control(ble_ams_c_t * p_ams)
 {
-    return cccd_configure(p_ams->conn_handle,
-                          m_service.remote_command.handle_cccd,
+    return cccd_configure(p_ams,
+                          p_ams->service.remote_command_cccd,
                           true);
 }
 
-uint32_t ble_ams_send_rc_command(ble_ams_c_t * p_ams, const ble_ams_remote_command_values_t p_cmd)
+/**@brief Function for checking whether a remote command may be merged with identical ones.
+ */
+static bool rc_command_is_repeatable(uint8_t cmd)
+{
+    return (cmd == BLE_AMS_REMOTE_COMMAND_VOLUME_UP)    ||
+           (cmd == BLE_AMS_REMOTE_COMMAND_VOLUME_DOWN)  ||
+           (cmd == BLE_AMS_REMOTE_COMMAND_SKIP_FORWARD) ||
+           (cmd == BLE_AMS_REMOTE_COMMAND_SKIP_BACKWARD);
+}
+
+/**@brief Function for checking whether two consecutive remote commands cancel out.
+ */
+static bool rc_command_is_inverse(uint8_t first, uint8_t second)
+{
+    switch (first)
+    {
+        case BLE_AMS_REMOTE_COMMAND_TOGGLE_PLAY_PAUSE:
+            return (second == BLE_AMS_REMOTE_COMMAND_TOGGLE_PLAY_PAUSE);
+            
+        case BLE_AMS_REMOTE_COMMAND_VOLUME_UP:
+            return (second == BLE_AMS_REMOTE_COMMAND_VOLUME_DOWN);
+            
+        case BLE_AMS_REMOTE_COMMAND_VOLUME_DOWN:
+            return (second == BLE_AMS_REMOTE_COMMAND_VOLUME_UP);
+            
+        case BLE_AMS_REMOTE_COMMAND_SKIP_FORWARD:
+            return (second == BLE_AMS_REMOTE_COMMAND_SKIP_BACKWARD);
+            
+        case BLE_AMS_REMOTE_COMMAND_SKIP_BACKWARD:
+            return (second == BLE_AMS_REMOTE_COMMAND_SKIP_FORWARD);
+            
+        default:
+            return false;
+    }
+}
+
+/**@brief Function for getting the unsent remote command at position n from the tail of the
+ *        transmit buffer.
+ *
+ * @return Message, or NULL if that message has already been sent or is not a remote command.
+ */
+static ble_ams_c_tx_message_t * rc_command_unsent_get(ble_ams_c_t * p_ams, uint32_t n)
 {
-    tx_message_t * p_msg;
-    uint32_t i = 0;
+    ble_ams_c_tx_message_t * p_msg;
     
-    if (m_client_state != STATE_RUNNING)
+    if ((p_ams->tx_insert_index - p_ams->tx_index) <= n)
     {
-        return NRF_ERROR_INVALID_STATE;
+        return NULL;
     }
     
-    p_msg              = &m_tx_buffer[m_tx_insert_index++];
-    m_tx_insert_index &= TX_BUFFER_MASK;
+    p_msg = &p_ams->tx_buffer[(p_ams->tx_insert_index - 1 - n) & TX_BUFFER_MASK];
     
-    p_msg->req.write_req.gattc_params.handle   = m_service.remote_command.handle_value;
-    p_msg->req.write_req.gattc_params.p_value  = p_msg->req.write_req.gattc_value;
-    p_msg->req.write_req.gattc_params.offset   = 0;
-    p_msg->req.write_req.gattc_params.write_op = BLE_GATT_OP_WRITE_REQ;
+    return tx_message_is_rc_command(p_ams, p_msg) ? p_msg : NULL;
+}
+
+/**@brief Function for coalescing a remote command with the unsent commands before it.
+ *
+ * @details Commands only wait in the transmit buffer while the link cannot keep up, so merging
+ *          there bounds the command rate to what the link drains per connection event.
+ *          - Repeatable commands (volume, skip) are merged once BLE_AMS_C_RC_COALESCE_MAX
+ *            identical ones are waiting.
+ *          - Play and Pause replace a waiting Play or Pause, the last one decides the outcome.
+ *          - Inverse pairs (toggle twice, volume up/down, skip forward/backward) cancel out.
+ *
+ * @return true if the command has been absorbed and must not be queued.
+ */
+static bool rc_command_coalesce(ble_ams_c_t * p_ams, uint8_t cmd)
+{
+    ble_ams_c_tx_message_t * p_tail = rc_command_unsent_get(p_ams, 0);
+    uint8_t        tail_cmd;
+    uint32_t       n;
     
-    p_msg->req.write_req.gattc_value[i++]      = p_cmd;
+    if (p_tail == NULL)
+    {
+        return false;
+    }
     
-    p_msg->req.write_req.gattc_params.len      = i;
-    p_msg->conn_handle                         = p_ams->conn_handle;
-    p_msg->type                                = WRITE_REQ;
+    tail_cmd = p_tail->req.write_req.gattc_value[0];
     
-    tx_buffer_process();
-    return NRF_SUCCESS;
+    if (rc_command_is_repeatable(cmd))
+    {
+        for (n = 0; n < BLE_AMS_C_RC_COALESCE_MAX; n++)
+        {
+            ble_ams_c_tx_message_t * p_msg = rc_command_unsent_get(p_ams, n);
+            
+            if ((p_msg == NULL) || (p_msg->req.write_req.gattc_value[0] != cmd))
+            {
+                break;
+            }
+        }
+        
+        if (n == BLE_AMS_C_RC_COALESCE_MAX)
+        {
+            p_ams->stats.rc_merged++;
+            return true;
+        }
+    }
+    
+    if (((tail_cmd == BLE_AMS_REMOTE_COMMAND_PLAY) || (tail_cmd == BLE_AMS_REMOTE_COMMAND_PAUSE)) &&
+        ((cmd == BLE_AMS_REMOTE_COMMAND_PLAY) || (cmd == BLE_AMS_REMOTE_COMMAND_PAUSE)))
+    {
+        p_tail->req.write_req.gattc_value[0] = cmd;
+        p_ams->stats.rc_merged++;
+        return true;
+    }
+    
+    if (rc_command_is_inverse(tail_cmd, cmd))
+    {
+        --p_ams->tx_insert_index;
+        p_ams->stats.rc_cancelled += 2;
+        return true;
+    }
+    
+    return false;
 }
 
-uint32_t ble_ams_c_service_load(const ble_ams_c_t * p_ams)
+/**@brief Function for queuing a remote command taken from the command queue.
+ */
+static void rc_command_queue(ble_ams_c_t * p_ams, uint8_t cmd)
 {
-    uint32_t err_code;
-    uint32_t i;
+    uint8_t write_op;
     
-    err_code = pstorage_load((uint8_t *)m_service_db,
-                             &m_flash_handle,
-                             (DISCOVERED_SERVICE_DB_SIZE * sizeof(uint32_t)),
-                             0);
+    if (rc_command_coalesce(p_ams, cmd))
+    {
+        return;
+    }
     
-    if (err_code != NRF_SUCCESS)
+    // Skip the write response round-trip when the master allows it.
+    write_op = (p_ams->service.flags & SERVICE_RECORD_FLAG_RC_WRITE_WO_RESP) ? BLE_GATT_OP_WRITE_CMD
+                                                                 : BLE_GATT_OP_WRITE_REQ;
+    
+    // A full TX queue is handled, and counted, according to the TX policy.
+    (void)tx_write_queue(p_ams,
+                         p_ams->service.remote_command_handle,
+                         &cmd,
+                         sizeof(cmd),
+                         write_op);
+}
+
+/**@brief Function for moving the remote commands queued by the application into the TX queue.
+ *
+ * @details Only runs at the priority of the BLE stack events, which is the only context changing
+ *          the TX queue. The application is the only writer of cmd_put_index and this function
+ *          the only writer of cmd_get_index. Under BLE_AMS_C_TX_POLICY_REJECT commands stay in
+ *          the command queue while the TX queue is full, so the application sees a full queue
+ *          instead of losing commands it was told were queued.
+ */
+static void rc_command_ring_drain(ble_ams_c_t * p_ams)
+{
+    uint32_t get = p_ams->cmd_get_index;
+    uint8_t  cmd;
+    
+    while (get != p_ams->cmd_put_index)
     {
-        // Problem with loading values from flash, initialize the RAM DB with default.
-        for (i = 0; i < BLE_AMS_MAX_DISCOVERED_CENTRALS; ++i)
+        if ((p_ams->tx_policy == BLE_AMS_C_TX_POLICY_REJECT) &&
+            (p_ams->client_state == BLE_AMS_C_STATE_RUNNING) &&
+            (tx_buffer_free_count(p_ams) == 0))
         {
-            mp_service_db[i].handle = INVALID_SERVICE_HANDLE;
+            // Moved on by tx_buffer_process once a message has gone out.
+            break;
         }
         
-        if (err_code == NRF_ERROR_NOT_FOUND)
+        // Read the command only after the index that published it.
+        __DMB();
+        cmd = p_ams->cmd_ring[get & CMD_RING_MASK];
+        
+        // Hand the slot back only once the command has been read.
+        __DMB();
+        p_ams->cmd_get_index = ++get;
+        
+        if (p_ams->client_state == BLE_AMS_C_STATE_RUNNING)
         {
-            // The flash does not contain any memorized centrals, set the return code to success.
-            err_code = NRF_SUCCESS;
+            rc_command_queue(p_ams, cmd);
         }
     }
-    return err_code;
+    
+    if (p_ams->client_state == BLE_AMS_C_STATE_RUNNING)
+    {
+        // Wake the link up before the commands are handed to the stack.
+        activity_update(p_ams);
+        tx_buffer_process(p_ams);
+    }
 }
 
+/**@brief Function for handling BLE_AMS_C_KICK_IRQn, pended when a remote command is queued or
+ *        a deferred notification has been processed.
+ */
+void BLE_AMS_C_KICK_IRQHandler(void)
+{
+    uint32_t i;
+    
+    for (i = 0; i < m_instance_count; i++)
+    {
+        if (m_instances[i]->client_state == BLE_AMS_C_STATE_RUNNING)
+        {
+            entity_update_work(m_instances[i]);
+        }
+        rc_command_ring_drain(m_instances[i]);
+        activity_update(m_instances[i]);
+    }
+}
 
-uint32_t ble_ams_c_service_store(void)
+uint32_t ble_ams_send_rc_command(ble_ams_c_t * p_ams, const ble_ams_remote_command_values_t p_cmd)
 {
-    uint32_t err_code;
+    uint32_t put = p_ams->cmd_put_index;
+    
+    if (p_ams->client_state != BLE_AMS_C_STATE_RUNNING)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
     
-    err_code = pstorage_store(&m_flash_handle,
-                              (uint8_t *) m_service_db,
-                              DISCOVERED_SERVICE_DB_SIZE * sizeof(uint32_t),
-                              0);
+    // Do not spend a round-trip on a command the current media app will ignore.
+    if ((p_cmd >= 16) || ((p_ams->supported_commands & (1 << p_cmd)) == 0))
+    {
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
     
-    return err_code;
+    if ((put - p_ams->cmd_get_index) >= BLE_AMS_C_CMD_QUEUE_SIZE)
+    {
+        p_ams->stats.rc_queue_full++;
+        return NRF_ERROR_NO_MEM;
+    }
+    
+    p_ams->cmd_ring[put & CMD_RING_MASK] = p_cmd;
+    
+    // Publish the command only once it has been written.
+    __DMB();
+    p_ams->cmd_put_index = put + 1;
+    
+    NVIC_SetPendingIRQ(BLE_AMS_C_KICK_IRQn);
+    return NRF_SUCCESS;
+}
+
+uint16_t ble_ams_c_state_consume_dirty(ble_ams_c_t * p_ams)
+{
+    uint16_t dirty;
+    uint8_t  nested;
+    
+    // The state is updated from the BLE stack event context, clear the mask atomically.
+    (void)sd_nvic_critical_region_enter(&nested);
+    dirty                    = p_ams->media_state.dirty;
+    p_ams->media_state.dirty = 0;
+    (void)sd_nvic_critical_region_exit(nested);
+    
+    return dirty;
 }
 
+uint32_t ble_ams_c_elapsed_ms_get(ble_ams_c_t * p_ams, uint32_t * p_elapsed_ms)
+{
+    uint32_t err_code = NRF_SUCCESS;
+    uint8_t  nested;
+    
+    // The position is updated from the BLE stack event context.
+    (void)sd_nvic_critical_region_enter(&nested);
+    if (p_ams->playback.valid)
+    {
+        playback_rebase(p_ams);
+        *p_elapsed_ms = (uint32_t)(p_ams->playback.elapsed_us / 1000);
+    }
+    else
+    {
+        err_code = NRF_ERROR_INVALID_STATE;
+    }
+    (void)sd_nvic_critical_region_exit(nested);
+    
+    return err_code;
+}
 
-uint32_t ble_ams_c_service_delete(void)
+uint32_t ble_ams_c_service_store(ble_ams_c_t * p_ams)
 {
-    if (m_client_state == STATE_UNINITIALIZED)
+    dm_application_context_t context;
+    uint32_t                 err_code;
+    
+    if (!p_ams->service_record_dirty || (p_ams->dm_handle.device_id == DM_INVALID_ID))
+    {
+        return NRF_SUCCESS;
+    }
+    
+    // A record invalidated and then rediscovered unchanged needs no flash write.
+    if (memcmp(SERVICE_RECORD(p_ams), &p_ams->service_stored, sizeof(ble_ams_c_service_record_t)) == 0)
     {
+        p_ams->service_record_dirty = false;
         return NRF_SUCCESS;
     }
     
-    return pstorage_clear(&m_flash_handle, (DISCOVERED_SERVICE_DB_SIZE * sizeof(uint32_t)));
+    context.flags  = 0;
+    context.len    = sizeof(ble_ams_c_service_record_t);
+    context.p_data = (uint8_t *)p_ams->service_context.words;
+    
+    // The Device Manager writes the context asynchronously from the buffer given.
+    err_code = dm_application_context_set(&p_ams->dm_handle, &context);
+    if (err_code == NRF_SUCCESS)
+    {
+        p_ams->service_stored             = *SERVICE_RECORD(p_ams);
+        p_ams->service_record_dirty       = false;
+        p_ams->stats.flash_bytes_written += sizeof(ble_ams_c_service_record_t);
+    }
+    
+    return err_code;
 }
\ No newline at end of file
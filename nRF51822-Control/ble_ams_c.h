@@ -4,6 +4,7 @@
 #include "ble_types.h"
 #include "ble_srv_common.h"
 #include "device_manager.h"
+#include "app_timer.h"
 
 #define AMS_NB_OF_CHARACTERISTICS           3
 #define AMS_NB_OF_SERVICES                  1
@@ -11,8 +12,51 @@
 #define INVALID_SERVICE_HANDLE_BASE                 0xF0                                 /**< Base for indicating invalid service handle. */
 #define INVALID_SERVICE_HANDLE                      (INVALID_SERVICE_HANDLE_BASE + 0x0F) /**< Indication that the current service handle is invalid. */
 #define INVALID_SERVICE_HANDLE_DISC                 (INVALID_SERVICE_HANDLE_BASE + 0x0E) /**< Indication that the current service handle is invalid but the service has been discovered. */
+#ifndef BLE_AMS_C_TX_QUEUE_SIZE
+#define BLE_AMS_C_TX_QUEUE_SIZE                    8                                    /**< Number of messages the TX queue can hold, must be a power of two. */
+#endif
+#ifndef BLE_AMS_C_RC_COALESCE_MAX
+#define BLE_AMS_C_RC_COALESCE_MAX                  1                                    /**< Maximum number of identical repeatable remote commands waiting in the TX queue, further presses are merged. */
+#endif
+#ifndef BLE_AMS_C_CMD_QUEUE_SIZE
+#define BLE_AMS_C_CMD_QUEUE_SIZE                   8                                    /**< Number of remote commands the application can queue ahead of the BLE stack event context, must be a power of two. */
+#endif
+#ifndef BLE_AMS_C_KICK_IRQn
+#define BLE_AMS_C_KICK_IRQn                        SWI3_IRQn                            /**< Software interrupt moving queued remote commands into the TX queue and running the work of deferred notifications. */
+#define BLE_AMS_C_KICK_IRQHandler                  SWI3_IRQHandler                      /**< Handler of BLE_AMS_C_KICK_IRQn, defined by the client. */
+#endif
+#ifndef BLE_AMS_C_MAX_INSTANCES
+#define BLE_AMS_C_MAX_INSTANCES                    DEVICE_MANAGER_MAX_CONNECTIONS       /**< Number of client instances, one per connected master. */
+#endif
+#define BLE_AMS_C_WRITE_MESSAGE_LENGTH             20                                   /**< Length of the write message for CCCD/remote command. */
+#define BLE_AMS_C_HVX_DATA_MAX                     (GATT_MTU_SIZE_DEFAULT - 3)          /**< Largest notification value, longer ones cannot be deferred. */
+#define BLE_AMS_C_SCHED_EVENT_SIZE                 sizeof(ble_ams_c_hvx_evt_t)          /**< Smallest app_scheduler event size supporting deferred notifications. */
+#define BLE_AMS_C_SERVICE_CONTEXT_WORDS            ((DEVICE_MANAGER_APP_CONTEXT_SIZE + 3) / 4) /**< Size of the Device Manager application context in words. */
+#define BLE_AMS_SUPPORTED_COMMANDS_UNKNOWN         0xFFFF                               /**< Supported command bitmap used until the master has notified the list, allows every command. */
 #define BLE_AMS_INVALID_HANDLE                     0xFF                                 /**< Indication that the current service handle is invalid. */
 #define AMS_ATTRIBUTE_DATA_MAX                     32                                   /*<< Maximium notification attribute data length. */
+#define BLE_AMS_ENTITY_UPDATE_FLAG_TRUNCATED       0x01                                 /**< Entity Update flag set when the value did not fit into the notification. */
+
+#define BLE_AMS_STATE_TEXT_MAX                     AMS_ATTRIBUTE_DATA_MAX               /**< Size of the media state slots holding text (names, artist, album, title). */
+#define BLE_AMS_STATE_VALUE_MAX                    16                                   /**< Size of the media state slots holding numeric strings (volume, index, duration, ...). */
+#define BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY        4                                    /**< Number of dirty bits reserved for each entity. */
+#define BLE_AMS_STATE_ATTRIBUTE_COUNT              (3 * BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY) /**< Number of attribute slots of the Player, Queue and Track entities. */
+
+/**@brief Dirty bit of an attribute in @ref ble_ams_media_state_t. */
+#define BLE_AMS_STATE_DIRTY_BIT(ENTITY_ID, ATTRIBUTE_ID) \
+    (1 << (((ENTITY_ID) * BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY) + (ATTRIBUTE_ID)))
+
+#define BLE_AMS_STATE_DIRTY_PLAYER_NAME            BLE_AMS_STATE_DIRTY_BIT(0, 0)
+#define BLE_AMS_STATE_DIRTY_PLAYER_PLAYBACK_INFO   BLE_AMS_STATE_DIRTY_BIT(0, 1)
+#define BLE_AMS_STATE_DIRTY_PLAYER_VOLUME          BLE_AMS_STATE_DIRTY_BIT(0, 2)
+#define BLE_AMS_STATE_DIRTY_QUEUE_INDEX            BLE_AMS_STATE_DIRTY_BIT(1, 0)
+#define BLE_AMS_STATE_DIRTY_QUEUE_COUNT            BLE_AMS_STATE_DIRTY_BIT(1, 1)
+#define BLE_AMS_STATE_DIRTY_QUEUE_SHUFFLE_MODE     BLE_AMS_STATE_DIRTY_BIT(1, 2)
+#define BLE_AMS_STATE_DIRTY_QUEUE_REPEAT_MODE      BLE_AMS_STATE_DIRTY_BIT(1, 3)
+#define BLE_AMS_STATE_DIRTY_TRACK_ARTIST           BLE_AMS_STATE_DIRTY_BIT(2, 0)
+#define BLE_AMS_STATE_DIRTY_TRACK_ALBUM            BLE_AMS_STATE_DIRTY_BIT(2, 1)
+#define BLE_AMS_STATE_DIRTY_TRACK_TITLE            BLE_AMS_STATE_DIRTY_BIT(2, 2)
+#define BLE_AMS_STATE_DIRTY_TRACK_DURATION         BLE_AMS_STATE_DIRTY_BIT(2, 3)
 
 
 #define BLE_UUID_APPLE_MEDIA_SERVICE        0x502B
@@ -25,8 +69,16 @@ typedef struct ble_ams_c_s ble_ams_c_s;
 /**@brief Event types that are passed from client to application on an event. */
 typedef enum
 {
-    BLE_AMS_C_EVT_DISCOVER_COMPLETE,          /**< A successful connection has been established and the characteristics of the server has been fetched. */
+    BLE_AMS_C_EVT_DISCOVER_COMPLETE,          /**< The handles of the service are known. From the cache of a bonded master only once the link is encrypted, after a discovery maybe before: AMS rejects writes until then, request security and write on DM_EVT_LINK_SECURED. */
     BLE_AMS_C_EVT_DISCOVER_FAILED,            /**< It was not possible to discover service or characteristics of the connected peer. */
+    BLE_AMS_C_EVT_PLAYER_UPDATE,              /**< An Entity Update notification for the Player entity has been received. */
+    BLE_AMS_C_EVT_QUEUE_UPDATE,               /**< An Entity Update notification for the Queue entity has been received. */
+    BLE_AMS_C_EVT_TRACK_UPDATE,               /**< An Entity Update notification for the Track entity has been received. */
+    BLE_AMS_C_EVT_ENTITY_ATTRIBUTE_READ,      /**< The full value of a truncated attribute has been read from the Entity Attribute characteristic. */
+    BLE_AMS_C_EVT_SUPPORTED_COMMANDS_UPDATE,  /**< The set of remote commands supported by the current media app has changed. */
+    BLE_AMS_C_EVT_ENTITY_UPDATE_SUBSCRIBED,   /**< All queued Entity Update subscriptions have been acknowledged, error_code holds the first GATT status failure if any. */
+    BLE_AMS_C_EVT_TRACK_CHANGED,              /**< The Track attributes of a new song have arrived, the values are in the media state. Sent once per song. */
+    BLE_AMS_C_EVT_ACTIVITY_CHANGED,           /**< The client has started or stopped exchanging data with the master (discovery, subscriptions, long reads, commands), see busy. */
 } ble_ams_c_evt_type_t;
 
 /**@brief Remote Commands for AMS. */
@@ -45,6 +97,55 @@ typedef enum
     BLE_AMS_REMOTE_COMMAND_SKIP_BACKWARD
 } ble_ams_remote_command_values_t;
 
+/**@brief Behaviour of the TX queue when a message is queued while it is full. */
+typedef enum
+{
+    BLE_AMS_C_TX_POLICY_REJECT,               /**< Refuse the new message, the API call returns NRF_ERROR_NO_MEM. */
+    BLE_AMS_C_TX_POLICY_DROP_OLDEST,          /**< Discard the oldest unsent remote command to make room for a new one. Other messages are refused as with REJECT. */
+    BLE_AMS_C_TX_POLICY_DROP_NEWEST,          /**< Discard a new remote command, the API call returns NRF_SUCCESS. Other messages are refused as with REJECT. */
+} ble_ams_c_tx_policy_t;
+
+/**@brief Use of the local connection latency of the link. */
+typedef enum
+{
+    BLE_AMS_C_LATENCY_POLICY_NONE,             /**< Leave the local connection latency alone. */
+    BLE_AMS_C_LATENCY_POLICY_WAKE_ON_ACTIVITY, /**< Skip up to idle_local_latency connection events while idle, listen on every one while busy, so a queued command goes out on the next connection event. */
+} ble_ams_c_latency_policy_t;
+
+/**@brief Entity IDs for AMS. */
+typedef enum
+{
+    BLE_AMS_ENTITY_ID_PLAYER,
+    BLE_AMS_ENTITY_ID_QUEUE,
+    BLE_AMS_ENTITY_ID_TRACK
+} ble_ams_entity_id_values_t;
+
+/**@brief Attribute IDs of the Player entity. */
+typedef enum
+{
+    BLE_AMS_PLAYER_ATTRIBUTE_ID_NAME,
+    BLE_AMS_PLAYER_ATTRIBUTE_ID_PLAYBACK_INFO,
+    BLE_AMS_PLAYER_ATTRIBUTE_ID_VOLUME
+} ble_ams_player_attribute_id_values_t;
+
+/**@brief Attribute IDs of the Queue entity. */
+typedef enum
+{
+    BLE_AMS_QUEUE_ATTRIBUTE_ID_INDEX,
+    BLE_AMS_QUEUE_ATTRIBUTE_ID_COUNT,
+    BLE_AMS_QUEUE_ATTRIBUTE_ID_SHUFFLE_MODE,
+    BLE_AMS_QUEUE_ATTRIBUTE_ID_REPEAT_MODE
+} ble_ams_queue_attribute_id_values_t;
+
+/**@brief Attribute IDs of the Track entity. */
+typedef enum
+{
+    BLE_AMS_TRACK_ATTRIBUTE_ID_ARTIST,
+    BLE_AMS_TRACK_ATTRIBUTE_ID_ALBUM,
+    BLE_AMS_TRACK_ATTRIBUTE_ID_TITLE,
+    BLE_AMS_TRACK_ATTRIBUTE_ID_DURATION
+} ble_ams_track_attribute_id_values_t;
+
 typedef struct {
     uint8_t                            event_id;
     uint8_t                            event_flags;
@@ -61,6 +162,33 @@ typedef struct {
     uint8_t                            data[AMS_ATTRIBUTE_DATA_MAX];
 } ble_ams_c_evt_notif_attribute_t;
 
+/**@brief Decoded Entity Update notification.
+ *
+ * @note  p_value points into the BLE stack event buffer and is not NUL terminated. It is only
+ *        valid for the duration of the event handler call.
+ */
+typedef struct {
+    uint8_t                            entity_id;                                        /**< Entity, see @ref ble_ams_entity_id_values_t. */
+    uint8_t                            attribute_id;                                     /**< Attribute within the entity. */
+    uint8_t                            entity_update_flags;                              /**< Entity Update flags, e.g. BLE_AMS_ENTITY_UPDATE_FLAG_TRUNCATED. */
+    uint16_t                           value_len;                                        /**< Length of the UTF-8 value. */
+    const uint8_t *                    p_value;                                          /**< UTF-8 value of the attribute. */
+} ble_ams_c_evt_entity_update_t;
+
+/**@brief Complete attribute value read through the Entity Attribute characteristic.
+ *
+ * @note  p_value points into the message buffer supplied in @ref ble_ams_c_init_t and is not NUL
+ *        terminated. It is only valid for the duration of the event handler call.
+ */
+typedef struct {
+    uint8_t                            entity_id;                                        /**< Entity, see @ref ble_ams_entity_id_values_t. */
+    uint8_t                            attribute_id;                                     /**< Attribute within the entity. */
+    uint8_t                            truncated;                                        /**< Set if the value did not fit into the message buffer. */
+    uint8_t                            round_trips;                                      /**< Number of ATT requests used to fetch the value. */
+    uint16_t                           value_len;                                        /**< Length of the UTF-8 value. */
+    const uint8_t *                    p_value;                                          /**< UTF-8 value of the attribute. */
+} ble_ams_c_evt_entity_attribute_t;
+
 /**@brief Apple Media Event structure
  *
  * @details The structure contains the event that should be handled, as well as
@@ -74,11 +202,212 @@ typedef struct
     {
         ble_ams_c_evt_ios_notification_t   notification;
         ble_ams_c_evt_notif_attribute_t    attribute;
+        ble_ams_c_evt_entity_update_t      entity_update;                                 /**< Entity Update, used by the BLE_AMS_C_EVT_PLAYER/QUEUE/TRACK_UPDATE events. */
+        ble_ams_c_evt_entity_attribute_t   entity_attribute;                              /**< Entity Attribute value, used by the BLE_AMS_C_EVT_ENTITY_ATTRIBUTE_READ event. */
+        uint16_t                           supported_commands;                            /**< Bit n set if RemoteCommandID n is supported, used by the BLE_AMS_C_EVT_SUPPORTED_COMMANDS_UPDATE event. */
+        uint32_t                           track_hash;                                    /**< Hash of the Track attribute values, used by the BLE_AMS_C_EVT_TRACK_CHANGED event. */
+        bool                               busy;                                          /**< Whether the client is exchanging data with the master, used by the BLE_AMS_C_EVT_ACTIVITY_CHANGED event. */
         uint32_t                        error_code;                                       /**< Additional status/error code if the event was caused by a stack error or gatt status, e.g. during service discovery. */
     } data;
 } ble_ams_c_evt_t;
 
 
+/**@brief Media state slot holding a text attribute. The value is always NUL terminated. */
+typedef struct
+{
+    uint8_t                             len;                                              /**< Length of the value, excluding the NUL terminator. */
+    uint8_t                             flags;                                            /**< Entity Update flags of the last update, BLE_AMS_ENTITY_UPDATE_FLAG_TRUNCATED is also set if the slot was too small. */
+    char                                value[BLE_AMS_STATE_TEXT_MAX + 1];                /**< UTF-8 value. */
+} ble_ams_state_text_t;
+
+/**@brief Media state slot holding a numeric attribute. The value is always NUL terminated. */
+typedef struct
+{
+    uint8_t                             len;                                              /**< Length of the value, excluding the NUL terminator. */
+    uint8_t                             flags;                                            /**< Entity Update flags of the last update, BLE_AMS_ENTITY_UPDATE_FLAG_TRUNCATED is also set if the slot was too small. */
+    char                                value[BLE_AMS_STATE_VALUE_MAX + 1];               /**< UTF-8 value. */
+} ble_ams_state_value_t;
+
+/**@brief Latest known media state of the connected master.
+ *
+ * @details Updated from the Entity Update notifications. Every update sets the matching
+ *          BLE_AMS_STATE_DIRTY_* bit in dirty, which is read and cleared by
+ *          @ref ble_ams_c_state_consume_dirty.
+ */
+typedef struct
+{
+    ble_ams_state_text_t                player_name;
+    ble_ams_state_value_t               player_playback_info;
+    ble_ams_state_value_t               player_volume;
+    ble_ams_state_value_t               queue_index;
+    ble_ams_state_value_t               queue_count;
+    ble_ams_state_value_t               queue_shuffle_mode;
+    ble_ams_state_value_t               queue_repeat_mode;
+    ble_ams_state_text_t                track_artist;
+    ble_ams_state_text_t                track_album;
+    ble_ams_state_text_t                track_title;
+    ble_ams_state_value_t               track_duration;
+    uint16_t                            dirty;                                            /**< BLE_AMS_STATE_DIRTY_* bits of the attributes updated since last consumed. */
+} ble_ams_media_state_t;
+
+/**@brief Playback states reported in Player/PlaybackInfo. */
+typedef enum
+{
+    BLE_AMS_PLAYBACK_STATE_PAUSED,
+    BLE_AMS_PLAYBACK_STATE_PLAYING,
+    BLE_AMS_PLAYBACK_STATE_REWINDING,
+    BLE_AMS_PLAYBACK_STATE_FAST_FORWARDING
+} ble_ams_playback_state_t;
+
+/**@brief Playback position extrapolated from the last Player/PlaybackInfo, with the parsed
+ *        Player/Volume and Track/Duration. */
+typedef struct
+{
+    bool                                valid;                                            /**< Whether a PlaybackInfo has been received and parsed on this connection. */
+    uint8_t                             state;                                            /**< Playback state, see @ref ble_ams_playback_state_t. */
+    int32_t                             rate_milli;                                       /**< Playback rate in thousandths, e.g. 1000 for normal playback. */
+    int64_t                             elapsed_us;                                       /**< Elapsed time of the track at anchor_ticks, in microseconds. */
+    int32_t                             elapsed_rem;                                      /**< Fraction of a microsecond carried over to the next rebase. */
+    uint32_t                            anchor_ticks;                                     /**< app_timer RTC counter value at which elapsed_us was taken. */
+    uint32_t                            duration_ms;                                      /**< Duration of the current track in milliseconds from Track/Duration, 0 if unknown. */
+    uint16_t                            volume_permille;                                  /**< Volume in thousandths of full scale from Player/Volume, 0 if unknown. */
+} ble_ams_playback_t;
+
+/**@brief Counters kept by the client. */
+typedef struct
+{
+    uint32_t                            tx_high_water;                                    /**< Highest number of messages waiting in the TX queue. */
+    uint32_t                            tx_dropped;                                       /**< Number of messages refused or discarded because the TX queue was full. */
+    uint32_t                            rc_merged;                                        /**< Number of remote commands merged into a command already waiting in the TX queue. */
+    uint32_t                            rc_cancelled;                                     /**< Number of remote commands removed because they cancelled out in pairs. */
+    uint32_t                            flash_bytes_written;                              /**< Number of service cache bytes written to flash for the current or last connection. */
+    int32_t                             playback_drift_ms;                                /**< Reported minus extrapolated elapsed time at the last PlaybackInfo, in milliseconds. */
+    uint32_t                            track_changes_suppressed;                         /**< Number of track changes not reported because the Track attributes were unchanged. */
+    uint32_t                            entity_updates_suppressed;                        /**< Number of Entity Updates not passed to evt_handler because the value was unchanged. */
+    uint32_t                            hvx_dropped;                                      /**< Number of notifications lost because the app_scheduler queue was full. */
+    uint32_t                            hvx_queue_high_water;                             /**< Highest number of deferred notifications waiting in the app_scheduler queue. */
+    uint32_t                            rc_queue_full;                                    /**< Number of remote commands refused because the command queue was full. */
+    uint32_t                            service_changed;                                  /**< Number of Service Changed indications that led to a new discovery. */
+    uint16_t                            local_latency;                                    /**< Local connection latency in effect, as reported by the SoftDevice. */
+} ble_ams_c_stats_t;
+
+/**@brief Types below hold the internal state of a client instance and are only meant to be
+ *        used by ble_ams_c.c.
+ */
+
+/**@brief States of the client state machine. */
+typedef enum
+{
+    BLE_AMS_C_STATE_UNINITIALIZED,                                                        /**< Uninitialized state of the internal state machine. */
+    BLE_AMS_C_STATE_IDLE,                                                                 /**< Idle state, this is the state when no master has connected to this device. */
+    BLE_AMS_C_STATE_DISC_SERV,                                                            /**< A BLE master is connected and a service discovery is in progress. */
+    BLE_AMS_C_STATE_DISC_CHAR,                                                            /**< A BLE master is connected and characteristic discovery is in progress. */
+    BLE_AMS_C_STATE_DISC_DESC,                                                            /**< A BLE master is connected and descriptor discovery is in progress. */
+    BLE_AMS_C_STATE_DISC_SC,                                                              /**< A BLE master is connected and Service Changed of the GATT service is being discovered. */
+    BLE_AMS_C_STATE_WAITING_ENC,                                                          /**< A bonded master has re-connected, the service taken from its cache awaits the encryption of the link. */
+    BLE_AMS_C_STATE_RUNNING,                                                              /**< A BLE master is connected and complete service discovery has been performed. */
+    BLE_AMS_C_STATE_RUNNING_NOT_DISCOVERED,                                               /**< A BLE master is connected and a service discovery is in progress. */
+} ble_ams_c_state_t;
+
+/**@brief Types of messages in the TX queue. */
+typedef enum
+{
+    BLE_AMS_C_TX_READ_REQ = 1,                                                            /**< Type identifying that this tx_message is a read request. */
+    BLE_AMS_C_TX_WRITE_REQ,                                                               /**< Type identifying that this tx_message is a write request. */
+    BLE_AMS_C_TX_WRITE_CMD                                                                /**< Type identifying that this tx_message is a write command, i.e. write without response. */
+} ble_ams_c_tx_request_t;
+
+/**@brief Structure used for holding the characteristic found during discovery process. */
+typedef struct
+{
+    ble_uuid_t                          uuid;                                             /**< UUID identifying this characteristic. */
+    ble_gatt_char_props_t               properties;                                       /**< Properties for this characteristic. */
+    uint16_t                            handle_decl;                                      /**< Characteristic Declaration Handle for this characteristic. */
+    uint16_t                            handle_value;                                     /**< Value Handle for the value provided in this characteristic. */
+    uint16_t                            handle_cccd;                                      /**< CCCD Handle value for this characteristic. BLE_AMS_INVALID_HANDLE if not present in the master. */
+} ble_ams_c_char_t;
+
+/**@brief Structure used for holding the Apple Media Service found during discovery process.
+ *
+ * @details Only used while discovering, the result is kept as a ble_ams_c_service_record_t.
+ */
+typedef struct
+{
+    ble_gattc_service_t                 service;                                          /**< The GATT service holding the discovered Apple Media Service. */
+    ble_ams_c_char_t                    remote_command;
+    ble_ams_c_char_t                    entity_update;
+    ble_ams_c_char_t                    entity_attribute;
+    ble_gattc_service_t                 gatt_service;                                     /**< The GATT service holding Service Changed. */
+} ble_ams_c_service_t;
+
+/**@brief Structure holding the handles the client uses once discovery has completed. Stored in
+ *        the Device Manager application context of the bond, the layout has no padding.
+ */
+typedef struct
+{
+    uint8_t                             version;                                          /**< Format version of the record. */
+    uint8_t                             flags;                                            /**< Validity and Remote Command write properties. */
+    uint16_t                            remote_command_handle;                            /**< Value handle of Remote Command. */
+    uint16_t                            remote_command_cccd;                              /**< CCCD handle of Remote Command. */
+    uint16_t                            entity_update_handle;                             /**< Value handle of Entity Update. */
+    uint16_t                            entity_update_cccd;                               /**< CCCD handle of Entity Update. */
+    uint16_t                            entity_attribute_handle;                          /**< Value handle of Entity Attribute. */
+    uint16_t                            service_changed_handle;                           /**< Value handle of Service Changed, 0 if the master has none. */
+    uint16_t                            service_changed_cccd;                             /**< CCCD handle of Service Changed, 0 if the master has none. */
+} ble_ams_c_service_record_t;
+
+/**@brief Structure for writing a message to the master, i.e. Remote Command or CCCD. */
+typedef struct
+{
+    uint8_t                             gattc_value[BLE_AMS_C_WRITE_MESSAGE_LENGTH];      /**< The message to write. */
+    ble_gattc_write_params_t            gattc_params;                                     /**< GATTC parameters for this message. */
+} ble_ams_c_write_params_t;
+
+/**@brief Structure for reading a value from the master, i.e. Entity Attribute. */
+typedef struct
+{
+    uint16_t                            handle;                                           /**< Handle of the attribute to read. */
+    uint16_t                            offset;                                           /**< Offset to read from, a non zero offset results in a Read Blob Request. */
+} ble_ams_c_read_params_t;
+
+/**@brief Structure for holding data to be transmitted to the connected master. */
+typedef struct
+{
+    uint16_t                            conn_handle;                                      /**< Connection handle to be used when transmitting this message. */
+    ble_ams_c_tx_request_t              type;                                             /**< Type of this message, i.e. read or write message. */
+    union
+    {
+        ble_ams_c_read_params_t         read_req;                                         /**< Read request message. */
+        ble_ams_c_write_params_t        write_req;                                        /**< Write request message. */
+    } req;
+} ble_ams_c_tx_message_t;
+
+/**@brief Structure for tracking the long reads of truncated attributes. */
+typedef struct
+{
+    uint16_t                            pending;                                          /**< BLE_AMS_STATE_DIRTY_BIT mask of attributes waiting to be read. */
+    uint16_t                            current;                                          /**< BLE_AMS_STATE_DIRTY_BIT of the attribute being read, 0 if none. */
+    uint16_t                            offset;                                           /**< Number of bytes received into the message buffer. */
+    uint8_t                             round_trips;                                      /**< Number of ATT requests issued for the current attribute. */
+} ble_ams_c_attr_read_t;
+
+/**@brief Fingerprint of the last value notified for an attribute. */
+typedef struct
+{
+    uint16_t                            len;                                              /**< Length of the value. */
+    uint32_t                            hash;                                             /**< FNV-1a hash of the value. */
+} ble_ams_c_fingerprint_t;
+
+/**@brief Notification copied for processing from the main loop through app_scheduler. */
+typedef struct
+{
+    struct ble_ams_c_s *                p_ams;                                            /**< Client instance the notification was received by. */
+    uint16_t                            conn_handle;                                      /**< Connection the notification was received on. */
+    uint16_t                            handle;                                           /**< Handle of the notifying characteristic. */
+    uint16_t                            len;                                              /**< Length of data. */
+    uint8_t                             data[BLE_AMS_C_HVX_DATA_MAX];                     /**< Notification value, only len bytes are queued. */
+} ble_ams_c_hvx_evt_t;
+
 /**@brief Apple Media event handler type. */
 typedef void (*ble_ams_c_evt_handler_t) (ble_ams_c_evt_t * p_evt);
 
@@ -92,6 +421,53 @@ typedef struct ble_ams_c_s
     uint8_t                             service_handle;
     uint32_t                            message_buffer_size;
     uint8_t *                           p_message_buffer;
+    ble_ams_c_tx_policy_t               tx_policy;                                        /**< Behaviour of the TX queue when full. */
+    uint16_t                            supported_commands;                               /**< Bit n set if RemoteCommandID n is supported by the current media app. */
+    ble_ams_c_stats_t                   stats;                                            /**< Counters, may be read by the application at any time. */
+    ble_ams_media_state_t               media_state;                                      /**< Latest media state received from the master. */
+    ble_ams_playback_t                  playback;                                         /**< Playback position, read it through @ref ble_ams_c_elapsed_ms_get. */
+    uint32_t                            timer_prescaler;                                  /**< Prescaler of the app_timer RTC. */
+    uint32_t                            track_quiet_ticks;                                /**< Quiet window before reporting a partially updated track, 0 to wait for all attributes. */
+    bool                                hvx_deferred;                                     /**< Whether notifications are processed from the main loop through app_scheduler. */
+    ble_ams_c_latency_policy_t          latency_policy;                                   /**< Use of the local connection latency. */
+    uint16_t                            idle_local_latency;                               /**< Local connection latency while idle, with BLE_AMS_C_LATENCY_POLICY_WAKE_ON_ACTIVITY. */
+
+    /* Internal state, only to be accessed by ble_ams_c.c. */
+    ble_ams_c_state_t                   client_state;                                     /**< Current state of the Apple Media State Machine. */
+    ble_ams_c_service_record_t          service;                                          /**< Current service data. */
+    bool                                service_cached;                                   /**< Whether service was taken from the bond's stored record. */
+    bool                                link_secured;                                     /**< Whether the Device Manager has reported the link encrypted. */
+    ble_ams_c_service_t                 service_disc;                                     /**< Scratch for the service discovery in progress. */
+    dm_handle_t                         dm_handle;                                        /**< Device Manager handle of the bond whose application context holds the service record. */
+    union
+    {
+        uint32_t                        words[BLE_AMS_C_SERVICE_CONTEXT_WORDS];           /**< Word size aligned storage handed to the Device Manager. */
+        ble_ams_c_service_record_t      record;                                           /**< Service record at the start of the context. */
+    }                                   service_context;                                  /**< Device Manager application context of the current bond. */
+    ble_ams_c_service_record_t          service_stored;                                   /**< Service record as last read from or written to the application context. */
+    bool                                service_record_dirty;                             /**< Whether the service record has been changed since it was loaded or stored. */
+    ble_ams_c_tx_message_t              tx_buffer[BLE_AMS_C_TX_QUEUE_SIZE];               /**< Transmit buffer for messages to be transmitted to the master. */
+    uint32_t                            tx_insert_index;                                  /**< Free running index in the transmit buffer where next message should be inserted. */
+    uint32_t                            tx_index;                                         /**< Free running index in the transmit buffer from where the next message to be transmitted resides. */
+    bool                                tx_request_pending;                               /**< Whether a read or write request is awaiting its response from the master. */
+    uint8_t                             tx_buffers_used;                                  /**< Stack TX buffers holding write commands of this link, given back to all links by BLE_EVT_TX_COMPLETE. */
+    ble_ams_c_attr_read_t               attr_read;                                        /**< Entity Attribute long read state. */
+    bool                                entity_update_cccd_enabled;                       /**< Whether notifications on Entity Update have been enabled on this connection. */
+    uint8_t                             subscribe_pending;                                /**< Number of Entity Update subscription writes awaiting their response. */
+    uint32_t                            subscribe_status;                                 /**< First error reported for the pending subscription writes. */
+    app_timer_id_t                      track_timer;                                      /**< Timer ending the quiet window of a track change. */
+    uint8_t                             track_subscribed;                                 /**< Bit n set if Track attribute n is subscribed to on this connection. */
+    uint8_t                             track_received;                                   /**< Bit n set if Track attribute n has arrived since the last track change. */
+    uint8_t                             track_arrived;                                    /**< Bit n set if Track attribute n has been decoded but not yet counted towards the track change. */
+    uint32_t                            track_hash;                                       /**< Hash of the Track attributes at the last BLE_AMS_C_EVT_TRACK_CHANGED. */
+    ble_ams_c_fingerprint_t             fingerprint[BLE_AMS_STATE_ATTRIBUTE_COUNT];       /**< Last notified value of each attribute, indexed like the dirty bits. */
+    uint16_t                            fingerprint_valid;                                /**< Dirty bits of the attributes holding a fingerprint. */
+    uint32_t                            hvx_put_count;                                    /**< Number of notifications put into the app_scheduler queue, written from the BLE stack event context. */
+    uint32_t                            hvx_done_count;                                   /**< Number of deferred notifications taken from the queue, written from the main loop. */
+    uint8_t                             cmd_ring[BLE_AMS_C_CMD_QUEUE_SIZE];               /**< Remote commands queued by the application, waiting to be moved into the TX queue. */
+    volatile uint32_t                   cmd_put_index;                                    /**< Free running index of the next command, written only by the application. */
+    volatile uint32_t                   cmd_get_index;                                    /**< Free running index of the next command to move, written only from BLE_AMS_C_KICK_IRQn. */
+    bool                                busy;                                             /**< Activity last reported through BLE_AMS_C_EVT_ACTIVITY_CHANGED. */
 } ble_ams_c_t;
 
 /**@brief Apple Media init structure. This contains all options and data needed for
@@ -100,8 +476,14 @@ typedef struct
 {
     ble_ams_c_evt_handler_t             evt_handler;
     ble_srv_error_handler_t             error_handler;
-    uint32_t                            message_buffer_size;
-    uint8_t *                           p_message_buffer;
+    uint32_t                            message_buffer_size;                              /**< Size of p_message_buffer. */
+    uint8_t *                           p_message_buffer;                                 /**< Buffer receiving the full value of truncated attributes. NULL disables the Entity Attribute reads. */
+    ble_ams_c_tx_policy_t               tx_policy;                                        /**< Behaviour of the TX queue when full. */
+    uint32_t                            timer_prescaler;                                  /**< Prescaler given to APP_TIMER_INIT, used to extrapolate the playback position. */
+    uint32_t                            track_quiet_ticks;                                /**< app_timer ticks without Track updates after which a partially updated track is reported. 0 reports a track only once every subscribed attribute has arrived. */
+    bool                                hvx_deferred;                                     /**< Process Entity Update and Remote Command notifications from the main loop through app_scheduler instead of the BLE stack event context. APP_SCHED_INIT must allow events of BLE_AMS_C_SCHED_EVENT_SIZE. */
+    ble_ams_c_latency_policy_t          latency_policy;                                   /**< Use of the local connection latency. */
+    uint16_t                            idle_local_latency;                               /**< Number of connection events the link may skip while the client is idle, with BLE_AMS_C_LATENCY_POLICY_WAKE_ON_ACTIVITY. */
 } ble_ams_c_init_t;
 
 /**@brief Apple Media Service UUIDs */
@@ -141,22 +523,92 @@ void ble_ams_c_on_device_manager_evt(ble_ams_c_t      * p_ams,
  */
 uint32_t ble_ams_c_init(ble_ams_c_t * p_ams, const ble_ams_c_init_t * p_ams_init);
 
-uint32_t ble_ams_c_enable_notif_remote_control(const ble_ams_c_t * p_ams);
+/**@brief Function for subscribing to Entity Update notifications for attributes of an entity.
+ *
+ * @details Notifications on the Entity Update characteristic are enabled with the first call on
+ *          a connection. The subscription write is queued right behind the CCCD write, so
+ *          several entities can be subscribed back to back. BLE_AMS_C_EVT_ENTITY_UPDATE_SUBSCRIBED
+ *          is sent once every queued subscription has been acknowledged.
+ *
+ * @param[in]   p_ams        Apple Media structure identifying the client instance.
+ * @param[in]   entity_id    Entity to subscribe to, see @ref ble_ams_entity_id_values_t.
+ * @param[in]   p_attrs      Attribute IDs of the entity to be notified about.
+ * @param[in]   count        Number of attribute IDs, at most BLE_AMS_STATE_ATTRIBUTES_PER_ENTITY.
+ *
+ * @return      NRF_SUCCESS if the writes were queued, NRF_ERROR_INVALID_PARAM on bad arguments,
+ *              NRF_ERROR_INVALID_STATE if the service has not been discovered, NRF_ERROR_NO_MEM
+ *              if the TX queue is full.
+ */
+uint32_t ble_ams_c_entity_update_subscribe(ble_ams_c_t   * p_ams,
+                                           uint8_t         entity_id,
+                                           const uint8_t * p_attrs,
+                                           uint8_t         count);
+
+/**@brief Function for enabling notifications on the Remote Command characteristic.
+ *
+ * @param[in]   p_ams        Apple Media structure identifying the client instance.
+ *
+ * @return      NRF_SUCCESS if the CCCD write was queued, NRF_ERROR_INVALID_STATE if the service
+ *              has not been discovered, NRF_ERROR_NO_MEM if the TX queue is full.
+ */
+uint32_t ble_ams_c_enable_notif_remote_control(ble_ams_c_t * p_ams);
 
 /**@brief Function for send remote command to AMS Client.
+ *
+ * @details The command is put into a lock-free queue and BLE_AMS_C_KICK_IRQn is pended, which
+ *          moves it into the TX queue at the priority of the BLE stack events. The function can
+ *          therefore be called from any interrupt priority without masking interrupts, as long
+ *          as all calls for an instance come from one context at a time. Under
+ *          BLE_AMS_C_TX_POLICY_REJECT a queued command is never dropped, it waits for room in
+ *          the TX queue.
  *
  * @param[in]   p_ams        Apple Media structure. This structure will have to be supplied by
  *                           the application. It identifies the particular client instance to use.
  * @param[in]   p_cmd        Command to send through the client.
  *
- * @return      NRF_SUCCESS on successful initialization of client, otherwise an error code.
+ * @return      NRF_SUCCESS if the command was queued, NRF_ERROR_INVALID_STATE if the service has
+ *              not been discovered, NRF_ERROR_NOT_SUPPORTED if the current media app does not
+ *              support the command, NRF_ERROR_NO_MEM if the command queue is full.
  */
 uint32_t ble_ams_send_rc_command(ble_ams_c_t * p_ams, const ble_ams_remote_command_values_t p_cmd);
 
-uint32_t ble_ams_c_service_load(const ble_ams_c_t * p_ams);
+/**@brief Function for fetching and clearing the set of media state attributes changed since the
+ *        previous call.
+ *
+ * @details The application should only read the slots of p_ams->media_state whose
+ *          BLE_AMS_STATE_DIRTY_* bit is set in the returned mask.
+ *
+ * @param[in]   p_ams        Apple Media structure identifying the client instance.
+ *
+ * @return      Mask of BLE_AMS_STATE_DIRTY_* bits.
+ */
+uint16_t ble_ams_c_state_consume_dirty(ble_ams_c_t * p_ams);
 
-uint32_t ble_ams_c_service_store(void);
+/**@brief Function for getting the elapsed time of the current track.
+ *
+ * @details The time is extrapolated from the last Player/PlaybackInfo using the app_timer RTC and
+ *          the playback rate, and corrected on every new PlaybackInfo. Each call also rebases
+ *          the extrapolation, so while playing it must be called at least once per RTC
+ *          overflow period (512 seconds times the prescaler plus one).
+ *
+ * @param[in]   p_ams        Apple Media structure identifying the client instance.
+ * @param[out]  p_elapsed_ms Elapsed time in milliseconds.
+ *
+ * @return      NRF_SUCCESS, or NRF_ERROR_INVALID_STATE if no PlaybackInfo has been received.
+ */
+uint32_t ble_ams_c_elapsed_ms_get(ble_ams_c_t * p_ams, uint32_t * p_elapsed_ms);
 
-uint32_t ble_ams_c_service_delete(void);
+/**@brief Function for writing the service record of the last bonded master to its Device
+ *        Manager application context.
+ *
+ * @details Nothing is written when the record equals the one last loaded or stored, only
+ *          records written count towards flash_bytes_written. Records are loaded by the client
+ *          itself on DM_EVT_CONNECTION, and deleted along with their bond.
+ *
+ * @param[in]   p_ams        Apple Media structure identifying the client instance.
+ *
+ * @return      NRF_SUCCESS, or an error code from the Device Manager.
+ */
+uint32_t ble_ams_c_service_store(ble_ams_c_t * p_ams);
 
 #endif // BLE_AMS_H__
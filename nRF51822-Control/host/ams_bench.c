@@ -0,0 +1,520 @@
+/**@file
+ *
+ * @brief Time-to-ready benchmark of the AMS client.
+ *
+ * @details Runs the client against the simulated SoftDevice and AMS server the way the example
+ *          application drives it: discovery, pairing or encryption, subscription to the Player,
+ *          Queue and Track entities. Three scenarios are run in order, the later ones reuse the
+ *          bond and the service record stored by the first:
+ *
+ *          - first-connect:   new master, full discovery and pairing.
+ *          - bonded:          bonded master identified on connection.
+ *          - bonded-private:  bonded master with a resolvable private address, identified only
+ *                             once the link is encrypted.
+ *
+ *          Times are in virtual milliseconds from BLE_GAP_EVT_CONNECTED. The client is ready
+ *          once the subscriptions are acknowledged and every entity has been notified. Each
+ *          scenario runs for a minute, so the connection events it counts include the switch to
+ *          the idle connection parameters once the client has settled. Only the events the slave
+ *          listens on are counted, those skipped with slave or local latency cost no radio time.
+ *
+ *          With -r the remote command latency is measured instead, once with Remote Command
+ *          written with requests and once with write commands, after a first connection has
+ *          settled on the idle parameters. A single press and a burst of BLE_AMS_C_CMD_QUEUE_SIZE
+ *          presses are timed from ble_ams_send_rc_command until the last command reaches the
+ *          phone.
+ *
+ *          With -l the latency policies of the client are compared instead, each after a first
+ *          connection has settled on the idle parameters. LATENCY_PRESS_COUNT presses are spread
+ *          over the idle connection interval and timed from ble_ams_send_rc_command until the
+ *          write response reaches the client. The average current is estimated from the
+ *          connection events the slave listens on, idle and with one press every
+ *          LATENCY_PRESS_PERIOD_US.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "nordic_common.h"
+#include "app_error.h"
+#include "ble_ams_c.h"
+#include "sim_softdevice.h"
+#include "sim_ams_server.h"
+#include "sim_app.h"
+#include "ams_app.h"
+
+#define DEFAULT_CONN_INTERVAL_MS            30                                                /**< Connection interval iOS grants a new connection. */
+#define DEFAULT_PACKETS_PER_EVENT           1                                                 /**< Packets the master sends per connection event. */
+#define RUN_TIME_US                         60000000                                          /**< Time a scenario runs for before disconnecting, one minute. */
+#define ENTITY_COUNT                        3                                                 /**< Player, Queue and Track. */
+#define NOT_REACHED                         UINT64_MAX                                        /**< Milestone not reached within RUN_TIME_US. */
+#define RC_SETTLE_US                        10000000                                          /**< Time for the first connection to settle before remote commands are sent. */
+#define RC_STEP_US                          1000                                              /**< Granularity of the remote command latency. */
+#define RC_TIMEOUT_US                       10000000                                          /**< Longest wait for remote commands to reach the phone. */
+#define RC_BURST_LENGTH                     BLE_AMS_C_CMD_QUEUE_SIZE                          /**< Presses of a burst, as many as the client queues. */
+#define LATENCY_IDLE_US                     60000000                                          /**< Time the idle current is averaged over, one minute. */
+#define LATENCY_PRESS_COUNT                 16                                                /**< Presses timed per latency policy. */
+#define LATENCY_PRESS_PERIOD_US             10000000                                          /**< Time between presses, long enough to return to the idle parameters. */
+#define LATENCY_PRESS_PHASE_US              (AMS_APP_IDLE_MAX_CONN_INTERVAL * UNIT_1_25_MS / LATENCY_PRESS_COUNT) /**< Added to the time between presses, so they sample the idle connection interval evenly. */
+#define SLEEP_CURRENT_NA                    2600                                              /**< nRF51822 System ON current with the RTC running. */
+#define CONN_EVENT_CHARGE_NC                7000                                              /**< Assumed charge of a connection event with empty packets on the S110, scale to the board's measurement. */
+
+/**@brief Latency policy compared by -l. */
+typedef struct
+{
+    const char *                        p_name;
+    ble_ams_c_latency_policy_t          policy;
+    uint16_t                            idle_local_latency;                               /**< Requested local latency, truncated by the SoftDevice. */
+} latency_setting_t;
+
+/**@brief Benchmark scenarios. */
+typedef enum
+{
+    SCENARIO_FIRST_CONNECT,
+    SCENARIO_BONDED,
+    SCENARIO_BONDED_PRIVATE,
+    SCENARIO_COUNT
+} scenario_t;
+
+/**@brief Milestones of a connection, in virtual time. */
+typedef struct
+{
+    uint64_t                            connected_us;
+    uint64_t                            discovered_us;                                    /**< BLE_AMS_C_EVT_DISCOVER_COMPLETE. */
+    uint64_t                            subscribed_us;                                    /**< BLE_AMS_C_EVT_ENTITY_UPDATE_SUBSCRIBED. */
+    uint64_t                            first_update_us[ENTITY_COUNT];                    /**< First update of each entity. */
+    uint64_t                            ready_us;                                         /**< Subscribed and every entity updated. */
+    uint32_t                            ready_requests;                                   /**< GATT round-trips until ready. */
+} milestones_t;
+
+static const char * const m_scenario_names[SCENARIO_COUNT] =
+{
+    "first-connect",
+    "bonded",
+    "bonded-private",
+};
+
+static const latency_setting_t m_latency_settings[] =
+{
+    { "none",    BLE_AMS_C_LATENCY_POLICY_NONE,             0                              },
+    { "wake-0",  BLE_AMS_C_LATENCY_POLICY_WAKE_ON_ACTIVITY, 0                              },
+    { "wake-1x", BLE_AMS_C_LATENCY_POLICY_WAKE_ON_ACTIVITY, AMS_APP_IDLE_SLAVE_LATENCY     },
+    { "wake-2x", BLE_AMS_C_LATENCY_POLICY_WAKE_ON_ACTIVITY, AMS_APP_IDLE_LOCAL_LATENCY     },
+    { "wake-3x", BLE_AMS_C_LATENCY_POLICY_WAKE_ON_ACTIVITY, 3 * AMS_APP_IDLE_SLAVE_LATENCY },
+};
+
+static milestones_t                     m_milestones;
+
+/**@brief Function for recording the time a milestone was first reached.
+ */
+static void milestone_set(uint64_t * p_milestone)
+{
+    uint8_t i;
+
+    if (*p_milestone != NOT_REACHED)
+    {
+        return;
+    }
+    *p_milestone = sim_time_us();
+
+    if (m_milestones.subscribed_us == NOT_REACHED)
+    {
+        return;
+    }
+    for (i = 0; i < ENTITY_COUNT; i++)
+    {
+        if (m_milestones.first_update_us[i] == NOT_REACHED)
+        {
+            return;
+        }
+    }
+    if (m_milestones.ready_us == NOT_REACHED)
+    {
+        m_milestones.ready_us       = sim_time_us();
+        m_milestones.ready_requests = sim_stats_get()->requests;
+    }
+}
+
+static void on_ams_c_evt(ble_ams_c_evt_t * p_evt)
+{
+    switch (p_evt->evt_type)
+    {
+        case BLE_AMS_C_EVT_DISCOVER_COMPLETE:
+            milestone_set(&m_milestones.discovered_us);
+            break;
+
+        case BLE_AMS_C_EVT_DISCOVER_FAILED:
+            APP_ERROR_HANDLER(p_evt->data.error_code);
+            break;
+
+        case BLE_AMS_C_EVT_ENTITY_UPDATE_SUBSCRIBED:
+            APP_ERROR_CHECK(p_evt->data.error_code);
+            milestone_set(&m_milestones.subscribed_us);
+            break;
+
+        case BLE_AMS_C_EVT_PLAYER_UPDATE:
+        case BLE_AMS_C_EVT_QUEUE_UPDATE:
+        case BLE_AMS_C_EVT_TRACK_UPDATE:
+            milestone_set(&m_milestones.first_update_us[p_evt->data.entity_update.entity_id]);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**@brief Function for formatting a milestone in milliseconds from the connection.
+ */
+static const char * milestone_format(uint64_t milestone_us, char * p_buf, size_t size)
+{
+    if (milestone_us == NOT_REACHED)
+    {
+        snprintf(p_buf, size, "-");
+    }
+    else
+    {
+        uint64_t delta_us = milestone_us - m_milestones.connected_us;
+        snprintf(p_buf, size, "%u.%u", (unsigned)(delta_us / 1000), (unsigned)((delta_us % 1000) / 100));
+    }
+    return p_buf;
+}
+
+/**@brief Function for running a scenario and printing its results.
+ */
+static void scenario_run(scenario_t scenario, const sim_link_params_t * p_params, bool csv)
+{
+    char     discovered[16];
+    char     subscribed[16];
+    char     ready[16];
+    uint32_t requests;
+    uint32_t conn_events;
+    uint8_t  i;
+
+    if (scenario == SCENARIO_FIRST_CONNECT)
+    {
+        sim_bonds_clear();
+    }
+
+    sim_app_init(p_params, sim_ams_server_get(), on_ams_c_evt);
+    sim_ams_server_init();
+
+    memset(&m_milestones, 0, sizeof(m_milestones));
+    m_milestones.discovered_us  = NOT_REACHED;
+    m_milestones.subscribed_us  = NOT_REACHED;
+    m_milestones.ready_us       = NOT_REACHED;
+    for (i = 0; i < ENTITY_COUNT; i++)
+    {
+        m_milestones.first_update_us[i] = NOT_REACHED;
+    }
+
+    m_milestones.connected_us = sim_time_us();
+    sim_connect(SIM_CONN_HANDLE, scenario != SCENARIO_BONDED_PRIVATE);
+    sim_run(RUN_TIME_US);
+    requests    = sim_stats_get()->requests;
+    conn_events = sim_stats_get()->conn_events - sim_stats_get()->conn_events_skipped;
+
+    sim_disconnect(SIM_CONN_HANDLE);
+
+    printf(csv ? "%s,%s,%s,%s,%u,%u,%u,%u\n" : "%-16s %10s %10s %10s %10u %10u %10u %10u\n",
+           m_scenario_names[scenario],
+           milestone_format(m_milestones.discovered_us, discovered, sizeof(discovered)),
+           milestone_format(m_milestones.subscribed_us, subscribed, sizeof(subscribed)),
+           milestone_format(m_milestones.ready_us, ready, sizeof(ready)),
+           (unsigned)m_milestones.ready_requests,
+           (unsigned)requests,
+           (unsigned)(((uint64_t)conn_events * 60000000) / RUN_TIME_US),
+           (unsigned)sim_stats_get()->flash_bytes_written);
+}
+
+/**@brief Function for sending remote commands and timing their arrival at the phone.
+ *
+ * @return Time in microseconds until the last command has reached the phone.
+ */
+static uint64_t rc_commands_time(uint32_t count)
+{
+    uint32_t target = sim_ams_server_stats_get()->remote_commands + count;
+    uint64_t start  = sim_time_us();
+    uint32_t i;
+
+    for (i = 0; i < count; i++)
+    {
+        APP_ERROR_CHECK(ble_ams_send_rc_command(ams_app_client_get(), BLE_AMS_REMOTE_COMMAND_NEXT_TRACK));
+    }
+    while (sim_ams_server_stats_get()->remote_commands < target)
+    {
+        if (sim_time_us() - start >= RC_TIMEOUT_US)
+        {
+            fprintf(stderr, "remote commands did not reach the phone\n");
+            exit(EXIT_FAILURE);
+        }
+        sim_run(RC_STEP_US);
+    }
+    return sim_time_us() - start;
+}
+
+/**@brief Function for measuring the remote command latency with one write type and printing it.
+ */
+static void rc_latency_run(bool write_cmd, const sim_link_params_t * p_params, bool csv)
+{
+    uint64_t press_us;
+    uint64_t burst_us;
+
+    sim_bonds_clear();
+    sim_app_init(p_params, sim_ams_server_get(), on_ams_c_evt);
+    sim_ams_server_init();
+    sim_ams_server_rc_write_cmd_set(write_cmd);
+
+    memset(&m_milestones, 0, sizeof(m_milestones));
+    m_milestones.discovered_us = NOT_REACHED;
+
+    sim_connect(SIM_CONN_HANDLE, true);
+    sim_run(RC_SETTLE_US);
+    if (m_milestones.discovered_us == NOT_REACHED)
+    {
+        fprintf(stderr, "AMS was not discovered\n");
+        exit(EXIT_FAILURE);
+    }
+
+    sim_stats_clear();
+    press_us = rc_commands_time(1);
+    sim_run(RC_SETTLE_US);
+    burst_us = rc_commands_time(RC_BURST_LENGTH);
+    sim_run(RC_SETTLE_US);
+
+    printf(csv ? "%s,%u.%u,%u.%u,%u,%u\n" : "%-16s %10u.%u %10u.%u %10u %10u\n",
+           write_cmd ? "write-cmd" : "write-req",
+           (unsigned)(press_us / 1000), (unsigned)((press_us % 1000) / 100),
+           (unsigned)(burst_us / 1000), (unsigned)((burst_us % 1000) / 100),
+           (unsigned)sim_stats_get()->requests,
+           (unsigned)sim_stats_get()->write_commands);
+
+    sim_disconnect(SIM_CONN_HANDLE);
+}
+
+/**@brief Function for estimating the average current since the counters were cleared.
+ *
+ * @return Average current in nA.
+ */
+static uint32_t current_estimate(uint64_t duration_us)
+{
+    const sim_stats_t * p_stats = sim_stats_get();
+    uint64_t            events  = p_stats->conn_events - p_stats->conn_events_skipped;
+
+    return SLEEP_CURRENT_NA + (uint32_t)((events * CONN_EVENT_CHARGE_NC * 1000000) / duration_us);
+}
+
+/**@brief Function for timing a press until the write response reaches the client.
+ *
+ * @return Time in microseconds from ble_ams_send_rc_command to the write response.
+ */
+static uint64_t press_response_time(void)
+{
+    uint32_t target = sim_stats_get()->write_responses + 1;
+    uint64_t start  = sim_time_us();
+
+    APP_ERROR_CHECK(ble_ams_send_rc_command(ams_app_client_get(), BLE_AMS_REMOTE_COMMAND_NEXT_TRACK));
+    while (sim_stats_get()->write_responses < target)
+    {
+        if (sim_time_us() - start >= RC_TIMEOUT_US)
+        {
+            fprintf(stderr, "the write response did not reach the client\n");
+            exit(EXIT_FAILURE);
+        }
+        sim_run(RC_STEP_US);
+    }
+    return sim_time_us() - start;
+}
+
+/**@brief Function for measuring the press latency and the current with a latency policy and
+ *        printing them.
+ */
+static void latency_run(const latency_setting_t * p_setting, const sim_link_params_t * p_params, bool csv)
+{
+    ble_ams_c_t * p_ams;
+    uint16_t      latency;
+    uint64_t      start_us;
+    uint64_t      press_us;
+    uint64_t      total_us = 0;
+    uint64_t      max_us   = 0;
+    uint32_t      idle_events;
+    uint32_t      idle_na;
+    uint32_t      press_na;
+    uint32_t      i;
+
+    sim_app_init(p_params, sim_ams_server_get(), NULL);
+    sim_ams_server_init();
+    sim_bonds_clear();
+
+    p_ams                     = ams_app_client_get();
+    p_ams->latency_policy     = p_setting->policy;
+    p_ams->idle_local_latency = p_setting->idle_local_latency;
+
+    sim_connect(SIM_CONN_HANDLE, true);
+    sim_run(RC_SETTLE_US);
+    if (p_ams->client_state != BLE_AMS_C_STATE_RUNNING)
+    {
+        fprintf(stderr, "the client is not running\n");
+        exit(EXIT_FAILURE);
+    }
+
+    sim_stats_clear();
+    sim_run(LATENCY_IDLE_US);
+    idle_events = sim_stats_get()->conn_events - sim_stats_get()->conn_events_skipped;
+    idle_na     = current_estimate(LATENCY_IDLE_US);
+
+    sim_stats_clear();
+    start_us = sim_time_us();
+    for (i = 0; i < LATENCY_PRESS_COUNT; i++)
+    {
+        press_us  = press_response_time();
+        total_us += press_us;
+        max_us    = MAX(max_us, press_us);
+        sim_run(start_us + (i + 1) * (LATENCY_PRESS_PERIOD_US + LATENCY_PRESS_PHASE_US) - sim_time_us());
+    }
+    press_na = current_estimate(sim_time_us() - start_us);
+
+    // Without the policy the slave latency the master granted applies.
+    latency = (p_setting->policy == BLE_AMS_C_LATENCY_POLICY_NONE) ? AMS_APP_IDLE_SLAVE_LATENCY
+                                                                    : sim_stats_get()->local_latency;
+
+    printf(csv ? "%s,%u,%u.%u,%u.%u,%u,%u.%u,%u.%u\n" : "%-16s %8u %8u.%u %8u.%u %10u %8u.%u %8u.%u\n",
+           p_setting->p_name,
+           (unsigned)latency,
+           (unsigned)(total_us / LATENCY_PRESS_COUNT / 1000), (unsigned)((total_us / LATENCY_PRESS_COUNT % 1000) / 100),
+           (unsigned)(max_us / 1000), (unsigned)((max_us % 1000) / 100),
+           (unsigned)(((uint64_t)idle_events * 60000000) / LATENCY_IDLE_US),
+           (unsigned)(idle_na / 1000), (unsigned)((idle_na % 1000) / 100),
+           (unsigned)(press_na / 1000), (unsigned)((press_na % 1000) / 100));
+
+    sim_disconnect(SIM_CONN_HANDLE);
+}
+
+static void usage(const char * p_name)
+{
+    fprintf(stderr,
+            "usage: %s [-i interval_ms] [-p packets_per_event] [-r | -l] [-c]\n"
+            "  -i  connection interval in milliseconds (default %u)\n"
+            "  -p  packets the master sends per connection event (default %u)\n"
+            "  -r  measure the remote command latency with write requests and write commands\n"
+            "  -l  compare the press latency and the current of the latency policies\n"
+            "  -c  print CSV\n",
+            p_name, DEFAULT_CONN_INTERVAL_MS, DEFAULT_PACKETS_PER_EVENT);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char * argv[])
+{
+    sim_link_params_t params;
+    bool              csv     = false;
+    bool              rc      = false;
+    bool              latency = false;
+    int               opt;
+    scenario_t        scenario;
+    uint32_t          i;
+
+    sim_app_params_default(&params);
+    params.conn_interval_us  = DEFAULT_CONN_INTERVAL_MS * 1000;
+    params.packets_per_event = DEFAULT_PACKETS_PER_EVENT;
+
+    while ((opt = getopt(argc, argv, "i:p:rlc")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i':
+                params.conn_interval_us = (uint32_t)(strtod(optarg, NULL) * 1000);
+                break;
+
+            case 'p':
+                params.packets_per_event = (uint8_t)atoi(optarg);
+                break;
+
+            case 'r':
+                rc = true;
+                break;
+
+            case 'l':
+                latency = true;
+                break;
+
+            case 'c':
+                csv = true;
+                break;
+
+            default:
+                usage(argv[0]);
+        }
+    }
+    if ((params.conn_interval_us < 7500) || (params.packets_per_event == 0) || (rc && latency))
+    {
+        usage(argv[0]);
+    }
+
+    if (rc)
+    {
+        if (csv)
+        {
+            printf("write,press_ms,burst_ms,round_trips,write_commands\n");
+        }
+        else
+        {
+            printf("AMS remote command latency, %u.%02u ms connection interval, %u packet(s) per event, "
+                   "burst of %u\n\n",
+                   (unsigned)(params.conn_interval_us / 1000),
+                   (unsigned)((params.conn_interval_us % 1000) / 10),
+                   (unsigned)params.packets_per_event,
+                   (unsigned)RC_BURST_LENGTH);
+            printf("%-16s %12s %12s %10s %10s\n", "write", "press", "burst", "rt-total", "commands");
+        }
+        rc_latency_run(false, &params, csv);
+        rc_latency_run(true, &params, csv);
+        return 0;
+    }
+
+    if (latency)
+    {
+        if (csv)
+        {
+            printf("policy,latency,press_ms,press_max_ms,idle_events_per_min,idle_ua,pressing_ua\n");
+        }
+        else
+        {
+            printf("AMS latency policies, %u.%02u ms connection interval, %u packet(s) per event, "
+                   "%u presses %u s apart\n\n",
+                   (unsigned)(params.conn_interval_us / 1000),
+                   (unsigned)((params.conn_interval_us % 1000) / 10),
+                   (unsigned)params.packets_per_event,
+                   (unsigned)LATENCY_PRESS_COUNT,
+                   (unsigned)(LATENCY_PRESS_PERIOD_US / 1000000));
+            printf("%-16s %8s %10s %10s %10s %10s %10s\n",
+                   "policy", "latency", "press", "press-max", "events/min", "idle-uA", "press-uA");
+        }
+        for (i = 0; i < sizeof(m_latency_settings) / sizeof(m_latency_settings[0]); i++)
+        {
+            latency_run(&m_latency_settings[i], &params, csv);
+        }
+        return 0;
+    }
+
+    if (csv)
+    {
+        printf("scenario,discovered_ms,subscribed_ms,ready_ms,round_trips_to_ready,round_trips,conn_events_per_min,flash_bytes\n");
+    }
+    else
+    {
+        printf("AMS time-to-ready, %u.%02u ms connection interval, %u packet(s) per event\n\n",
+               (unsigned)(params.conn_interval_us / 1000),
+               (unsigned)((params.conn_interval_us % 1000) / 10),
+               (unsigned)params.packets_per_event);
+        printf("%-16s %10s %10s %10s %10s %10s %10s %10s\n",
+               "scenario", "discover", "subscribe", "ready", "rt-ready", "rt-total", "events/min", "flash");
+    }
+
+    for (scenario = SCENARIO_FIRST_CONNECT; scenario < SCENARIO_COUNT; scenario++)
+    {
+        scenario_run(scenario, &params, csv);
+    }
+    return 0;
+}
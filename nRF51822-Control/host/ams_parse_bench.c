@@ -0,0 +1,120 @@
+/**@file
+ *
+ * @brief Micro-benchmark of the integer only decimal parsers against strtod.
+ *
+ * @details Parses the numeric attributes of the Protocol file many times over, once with
+ *          ams_parse and once with the floating point path it replaces, and prints the host CPU
+ *          time per value. Both paths produce thousandths, the float path parses PlaybackInfo
+ *          with one strtod call per field. The host has an FPU, so the gap is much smaller than
+ *          on the Cortex-M0 where every float operation is a soft-float library call. The flash
+ *          the two paths take on the chip is compared by "make parse-size".
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "nrf_error.h"
+#include "ams_parse.h"
+
+#define ITERATIONS                          1000000                                           /**< Parses of each value. */
+#define PLAYBACK_INFO_FIELDS                3                                                 /**< State, rate and elapsed time. */
+
+/**@brief Attribute value of the Protocol file. */
+typedef struct
+{
+    const char *                        p_name;
+    const char *                        p_text;
+    uint8_t                             fields;                                           /**< Number of comma separated fields. */
+} sample_t;
+
+static const sample_t m_samples[] =
+{
+    { "volume",        "0.5957915",    1 },
+    { "duration",      "201.990",      1 },
+    { "playback-info", "1,1.0,16.127", PLAYBACK_INFO_FIELDS },
+};
+
+static volatile int32_t                 m_sink;                                           /**< Keeps the results alive. */
+
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+/**@brief Function for parsing a sample with ams_parse.
+ */
+static void fixed_parse(const sample_t * p_sample, uint16_t len)
+{
+    int32_t values[PLAYBACK_INFO_FIELDS];
+
+    if (ams_parse_milli_list((const uint8_t *)p_sample->p_text, len, ',', values, p_sample->fields) != NRF_SUCCESS)
+    {
+        exit(EXIT_FAILURE);
+    }
+    m_sink = values[p_sample->fields - 1];
+}
+
+/**@brief Function for parsing a sample with strtod, the path ams_parse replaces.
+ */
+static void float_parse(const sample_t * p_sample)
+{
+    const char * p_text = p_sample->p_text;
+    char *       p_end;
+    int32_t      values[PLAYBACK_INFO_FIELDS] = { 0 };
+    uint8_t      i;
+
+    for (i = 0; i < p_sample->fields; i++)
+    {
+        values[i] = (int32_t)(strtod(p_text, &p_end) * 1000);
+        if (p_end == p_text)
+        {
+            exit(EXIT_FAILURE);
+        }
+        p_text = p_end + 1;
+    }
+    m_sink = values[p_sample->fields - 1];
+}
+
+int main(void)
+{
+    uint32_t i;
+    uint32_t s;
+
+    printf("AMS numeric parsers, host ns per value, %u iterations\n\n", ITERATIONS);
+    printf("%-16s %10s %10s\n", "value", "ams_parse", "strtod");
+
+    for (s = 0; s < sizeof(m_samples) / sizeof(m_samples[0]); s++)
+    {
+        const sample_t * p_sample = &m_samples[s];
+        uint16_t         len      = strlen(p_sample->p_text);
+        uint64_t         start;
+        uint64_t         fixed_ns;
+        uint64_t         float_ns;
+
+        start = cpu_time_ns();
+        for (i = 0; i < ITERATIONS; i++)
+        {
+            fixed_parse(p_sample, len);
+        }
+        fixed_ns = cpu_time_ns() - start;
+
+        start = cpu_time_ns();
+        for (i = 0; i < ITERATIONS; i++)
+        {
+            float_parse(p_sample);
+        }
+        float_ns = cpu_time_ns() - start;
+
+        printf("%-16s %10.1f %10.1f\n",
+               p_sample->p_name,
+               (double)fixed_ns / ITERATIONS,
+               (double)float_ns / ITERATIONS);
+    }
+    return 0;
+}
@@ -0,0 +1,353 @@
+/**@file
+ *
+ * @brief Notification storm benchmark of the AMS client.
+ *
+ * @details Connects the client to the simulated AMS server like the example application, waits
+ *          until it is subscribed, then plays a playback session script on the server. For the
+ *          time the script runs, plus a drain period, it reports:
+ *
+ *          - sent:        notifications sent by the server.
+ *          - lost:        notifications lost because the master queue was full.
+ *          - dropped:     notifications the client dropped because the app_scheduler queue was full.
+ *          - updates:     Entity Updates passed to the application.
+ *          - tracks:      BLE_AMS_C_EVT_TRACK_CHANGED events / tracks loaded by the server.
+ *          - notif/s:     notifications delivered per second of virtual time.
+ *          - ns/evt:      host CPU time per BLE stack event, handler and main loop.
+ *          - isr-max:     longest BLE stack event handler call, in ns.
+ *          - loop-max:    longest main loop run, in ns.
+ *
+ *          The built-in scripts are run unless script files are given with -f.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "nrf_error.h"
+#include "app_error.h"
+#include "ble_ams_c.h"
+#include "sim_softdevice.h"
+#include "sim_ams_server.h"
+#include "sim_app.h"
+#include "ams_app.h"
+
+#define DEFAULT_CONN_INTERVAL_MS            30                                                /**< Connection interval iOS grants a new connection. */
+#define DEFAULT_PACKETS_PER_EVENT           4                                                 /**< Packets the master sends per connection event. */
+#define DEFAULT_MASTER_QUEUE_SIZE           32                                                /**< Notifications the master can hold for sending. */
+#define STEP_US                             10000                                             /**< Granularity of the run loops. */
+#define READY_TIMEOUT_US                    5000000                                           /**< Longest wait for the client to be subscribed. */
+#define SETTLE_US                           1000000                                           /**< Time for the initial long reads to finish before the script starts. */
+#define DRAIN_US                            2000000                                           /**< Time the link runs after the script has ended. */
+#define SCRIPT_FILE_MAX                     16384                                             /**< Largest script file. */
+#define SCRIPT_FILES_MAX                    8                                                 /**< Number of -f options. */
+
+/**@brief Playback session script. */
+typedef struct
+{
+    const char *                        p_name;
+    const char *                        p_text;
+} script_t;
+
+/**@brief Client side counters of a run. */
+typedef struct
+{
+    uint32_t                            updates;                                          /**< Entity Updates passed to the application. */
+    uint32_t                            track_changes;                                    /**< BLE_AMS_C_EVT_TRACK_CHANGED events. */
+    uint32_t                            attribute_reads;                                  /**< BLE_AMS_C_EVT_ENTITY_ATTRIBUTE_READ events. */
+    bool                                subscribed;                                       /**< Whether BLE_AMS_C_EVT_ENTITY_UPDATE_SUBSCRIBED has been received. */
+} app_counters_t;
+
+static const script_t m_builtin_scripts[] =
+{
+    {
+        "skip-storm",
+        "# Rapid skips through an 823 track queue, one every 30 ms.\n"
+        "queue 823\n"
+        "wait 1000\n"
+        "repeat 200\n"
+        "    next\n"
+        "    wait 30\n"
+        "end\n"
+    },
+    {
+        "scrub",
+        "# Dragging the playback position back and forth, one update every 10 ms.\n"
+        "pause\n"
+        "seek 0\n"
+        "repeat 150\n"
+        "    seek +1\n"
+        "    wait 10\n"
+        "end\n"
+        "repeat 150\n"
+        "    seek -1\n"
+        "    wait 10\n"
+        "end\n"
+        "play\n"
+    },
+    {
+        "session",
+        "# A listening session: skips, scrubbing, volume changes, pauses.\n"
+        "queue 823\n"
+        "wait 3000\n"
+        "repeat 5\n"
+        "    next\n"
+        "    wait 400\n"
+        "end\n"
+        "repeat 20\n"
+        "    seek +3\n"
+        "    wait 50\n"
+        "end\n"
+        "repeat 16\n"
+        "    volume -0.03125\n"
+        "    wait 25\n"
+        "end\n"
+        "pause\n"
+        "wait 1000\n"
+        "play\n"
+        "next 10\n"
+        "wait 2000\n"
+        "prev\n"
+    },
+    {
+        "app-switch",
+        "# Switching between media apps, the supported commands change each time.\n"
+        "repeat 50\n"
+        "    commands 0,1,2,9,10\n"
+        "    set player 0 Podcasts\n"
+        "    wait 60\n"
+        "    commands all\n"
+        "    set player 0 Music\n"
+        "    wait 60\n"
+        "end\n"
+    },
+};
+
+static app_counters_t                   m_counters;
+
+static void on_ams_c_evt(ble_ams_c_evt_t * p_evt)
+{
+    switch (p_evt->evt_type)
+    {
+        case BLE_AMS_C_EVT_ENTITY_UPDATE_SUBSCRIBED:
+            APP_ERROR_CHECK(p_evt->data.error_code);
+            m_counters.subscribed = true;
+            break;
+
+        case BLE_AMS_C_EVT_PLAYER_UPDATE:
+        case BLE_AMS_C_EVT_QUEUE_UPDATE:
+        case BLE_AMS_C_EVT_TRACK_UPDATE:
+            m_counters.updates++;
+            break;
+
+        case BLE_AMS_C_EVT_TRACK_CHANGED:
+            m_counters.track_changes++;
+            break;
+
+        case BLE_AMS_C_EVT_ENTITY_ATTRIBUTE_READ:
+            m_counters.attribute_reads++;
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**@brief Function for running a script and printing its results.
+ */
+static void script_run(const script_t * p_script, const sim_link_params_t * p_params, bool csv)
+{
+    const sim_stats_t *            p_sim;
+    const sim_ams_server_stats_t * p_server;
+    ble_ams_c_stats_t              client_start;
+    ble_ams_c_stats_t *            p_client;
+    uint64_t                       start_us;
+    uint64_t                       duration_us;
+    uint64_t                       cpu_ns;
+    uint32_t                       waited_us;
+
+    sim_app_init(p_params, sim_ams_server_get(), on_ams_c_evt);
+    sim_ams_server_init();
+    sim_bonds_clear();
+    memset(&m_counters, 0, sizeof(m_counters));
+
+    sim_connect(SIM_CONN_HANDLE, true);
+    for (waited_us = 0; !m_counters.subscribed; waited_us += STEP_US)
+    {
+        if (waited_us >= READY_TIMEOUT_US)
+        {
+            fprintf(stderr, "%s: the client did not subscribe\n", p_script->p_name);
+            exit(EXIT_FAILURE);
+        }
+        sim_run(STEP_US);
+    }
+    sim_run(SETTLE_US);
+
+    if (sim_ams_server_script_load(p_script->p_text) != NRF_SUCCESS)
+    {
+        fprintf(stderr, "%s: script not loaded\n", p_script->p_name);
+        exit(EXIT_FAILURE);
+    }
+
+    p_client     = &ams_app_client_get()->stats;
+    client_start = *p_client;
+    memset(&m_counters, 0, sizeof(m_counters));
+    sim_stats_clear();
+    start_us = sim_time_us();
+
+    while (!sim_ams_server_script_done())
+    {
+        sim_run(STEP_US);
+    }
+    sim_run(DRAIN_US);
+
+    duration_us = sim_time_us() - start_us;
+    p_sim       = sim_stats_get();
+    p_server    = sim_ams_server_stats_get();
+    cpu_ns      = p_sim->ble_evt_cpu_ns + p_sim->main_loop_cpu_ns;
+
+    printf(csv ? "%s,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u\n"
+               : "%-12s %8u %6u %6u %7u %7u %10u %5u/%-5u %7u %8u %8u %8u %8u\n",
+           p_script->p_name,
+           (unsigned)(duration_us / 1000),
+           (unsigned)p_server->notifications,
+           (unsigned)p_sim->notifications_lost,
+           (unsigned)(p_client->hvx_dropped - client_start.hvx_dropped),
+           (unsigned)m_counters.updates,
+           (unsigned)(p_client->entity_updates_suppressed - client_start.entity_updates_suppressed),
+           (unsigned)m_counters.track_changes,
+           (unsigned)p_server->track_changes,
+           (unsigned)((uint64_t)p_sim->notifications * 1000000 / duration_us),
+           (unsigned)m_counters.attribute_reads,
+           (unsigned)((p_sim->ble_events > 0) ? (cpu_ns / p_sim->ble_events) : 0),
+           (unsigned)p_sim->ble_evt_cpu_ns_max,
+           (unsigned)p_sim->main_loop_cpu_ns_max);
+
+    sim_disconnect(SIM_CONN_HANDLE);
+}
+
+/**@brief Function for reading a script file.
+ */
+static script_t script_file_read(const char * p_path)
+{
+    script_t script;
+    char *   p_text = calloc(1, SCRIPT_FILE_MAX + 1);
+    FILE *   p_file = fopen(p_path, "r");
+    size_t   len;
+
+    if ((p_text == NULL) || (p_file == NULL))
+    {
+        perror(p_path);
+        exit(EXIT_FAILURE);
+    }
+
+    len = fread(p_text, 1, SCRIPT_FILE_MAX + 1, p_file);
+    fclose(p_file);
+    if (len > SCRIPT_FILE_MAX)
+    {
+        fprintf(stderr, "%s: larger than %u bytes\n", p_path, SCRIPT_FILE_MAX);
+        exit(EXIT_FAILURE);
+    }
+
+    script.p_name = (strrchr(p_path, '/') != NULL) ? (strrchr(p_path, '/') + 1) : p_path;
+    script.p_text = p_text;
+    return script;
+}
+
+static void usage(const char * p_name)
+{
+    fprintf(stderr,
+            "usage: %s [-i interval_ms] [-p packets_per_event] [-q queue_size] [-c] [-f script]...\n"
+            "  -i  connection interval in milliseconds (default %u)\n"
+            "  -p  packets the master sends per connection event (default %u)\n"
+            "  -q  notifications the master can hold for sending (default %u)\n"
+            "  -c  print CSV\n"
+            "  -f  run a script file instead of the built-in scripts\n",
+            p_name, DEFAULT_CONN_INTERVAL_MS, DEFAULT_PACKETS_PER_EVENT, DEFAULT_MASTER_QUEUE_SIZE);
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char * argv[])
+{
+    sim_link_params_t params;
+    script_t          files[SCRIPT_FILES_MAX];
+    uint32_t          file_count = 0;
+    const script_t *  p_scripts  = m_builtin_scripts;
+    uint32_t          script_count = sizeof(m_builtin_scripts) / sizeof(m_builtin_scripts[0]);
+    bool              csv = false;
+    int               opt;
+    uint32_t          i;
+
+    sim_app_params_default(&params);
+    params.conn_interval_us  = DEFAULT_CONN_INTERVAL_MS * 1000;
+    params.packets_per_event = DEFAULT_PACKETS_PER_EVENT;
+    params.master_queue_size = DEFAULT_MASTER_QUEUE_SIZE;
+
+    while ((opt = getopt(argc, argv, "i:p:q:cf:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'i':
+                params.conn_interval_us = (uint32_t)(strtod(optarg, NULL) * 1000);
+                break;
+
+            case 'p':
+                params.packets_per_event = (uint8_t)atoi(optarg);
+                break;
+
+            case 'q':
+                params.master_queue_size = (uint16_t)atoi(optarg);
+                break;
+
+            case 'c':
+                csv = true;
+                break;
+
+            case 'f':
+                if (file_count == SCRIPT_FILES_MAX)
+                {
+                    usage(argv[0]);
+                }
+                files[file_count++] = script_file_read(optarg);
+                break;
+
+            default:
+                usage(argv[0]);
+        }
+    }
+    if ((params.conn_interval_us < 7500) || (params.packets_per_event == 0) || (params.master_queue_size == 0))
+    {
+        usage(argv[0]);
+    }
+
+    if (file_count > 0)
+    {
+        p_scripts    = files;
+        script_count = file_count;
+    }
+
+    if (csv)
+    {
+        printf("script,duration_ms,sent,lost,dropped,updates,suppressed,track_changes,tracks_loaded,"
+               "notif_per_s,attribute_reads,cpu_ns_per_evt,isr_max_ns,loop_max_ns\n");
+    }
+    else
+    {
+        printf("AMS notification storms, %u.%02u ms connection interval, %u packet(s) per event, "
+               "master queue %u\n\n",
+               (unsigned)(params.conn_interval_us / 1000),
+               (unsigned)((params.conn_interval_us % 1000) / 10),
+               (unsigned)params.packets_per_event,
+               (unsigned)params.master_queue_size);
+        printf("%-12s %8s %6s %6s %7s %7s %10s %11s %7s %8s %8s %8s %8s\n",
+               "script", "ms", "sent", "lost", "dropped", "updates", "suppressed", "tracks",
+               "notif/s", "ea-reads", "ns/evt", "isr-max", "loop-max");
+    }
+
+    for (i = 0; i < script_count; i++)
+    {
+        script_run(&p_scripts[i], &params, csv);
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+/**@file
+ *
+ * @brief Smallest program parsing the numeric AMS attributes, for "make parse-size".
+ *
+ * @details Built once with ams_parse and once with -DPARSE_SIZE_FLOAT, where strtod does the
+ *          work as in the code ams_parse replaced. The difference of the two images is the flash
+ *          the float path costs.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nrf_error.h"
+#include "ams_parse.h"
+
+static const char * volatile m_p_text = "1,1.0,16.127";                                     /**< Read at run time, so nothing is folded. */
+volatile int32_t             m_sink;
+
+int main(void)
+{
+    const char * p_text = m_p_text;
+    int32_t      values[3];
+#ifdef PARSE_SIZE_FLOAT
+    char *       p_end;
+    uint8_t      i;
+
+    for (i = 0; i < 3; i++)
+    {
+        values[i] = (int32_t)(strtod(p_text, &p_end) * 1000);
+        p_text    = p_end + 1;
+    }
+#else
+    if (ams_parse_milli_list((const uint8_t *)p_text, strlen(p_text), ',', values, 3) != NRF_SUCCESS)
+    {
+        return 1;
+    }
+#endif
+    m_sink = values[0] + values[1] + values[2];
+    return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef APP_ERROR_H__
+#define APP_ERROR_H__
+
+/**@file
+ *
+ * @brief Host build of the nRF51 SDK error handling macros, errors end the process.
+ */
+
+#include <stdint.h>
+#include "nrf_error.h"
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t * p_file_name);
+
+/**@brief Macro for calling error handler function. */
+#define APP_ERROR_HANDLER(ERR_CODE)                                                           \
+    do                                                                                        \
+    {                                                                                         \
+        app_error_handler((ERR_CODE), __LINE__, (uint8_t*) __FILE__);                         \
+    } while (0)
+
+/**@brief Macro for calling error handler function if supplied error code any other than NRF_SUCCESS. */
+#define APP_ERROR_CHECK(ERR_CODE)                                                             \
+    do                                                                                        \
+    {                                                                                         \
+        const uint32_t LOCAL_ERR_CODE = (ERR_CODE);                                           \
+        if (LOCAL_ERR_CODE != NRF_SUCCESS)                                                    \
+        {                                                                                     \
+            APP_ERROR_HANDLER(LOCAL_ERR_CODE);                                                \
+        }                                                                                     \
+    } while (0)
+
+#endif // APP_ERROR_H__
@@ -0,0 +1,18 @@
+#ifndef APP_SCHEDULER_H__
+#define APP_SCHEDULER_H__
+
+/**@file
+ *
+ * @brief Host build of the app_scheduler API. Events are executed by the main loop of the
+ *        simulated SoftDevice.
+ */
+
+#include <stdint.h>
+
+/**@brief Scheduler event handler type. */
+typedef void (*app_sched_event_handler_t)(void * p_event_data, uint16_t event_size);
+
+uint32_t app_sched_event_put(void * p_event_data, uint16_t event_size, app_sched_event_handler_t handler);
+void     app_sched_execute(void);
+
+#endif // APP_SCHEDULER_H__
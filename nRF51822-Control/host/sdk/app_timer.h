@@ -0,0 +1,39 @@
+#ifndef APP_TIMER_H__
+#define APP_TIMER_H__
+
+/**@file
+ *
+ * @brief Host build of the app_timer API, running on the virtual clock of the simulated
+ *        SoftDevice.
+ */
+
+#include <stdint.h>
+
+#define APP_TIMER_CLOCK_FREQ                32768                                             /**< Clock frequency of the RTC timer used to implement the app timer module. */
+#define APP_TIMER_MIN_TIMEOUT_TICKS         5                                                 /**< Minimum value of the timeout_ticks parameter of app_timer_start(). */
+
+/**@brief Convert milliseconds to timer ticks. */
+#define APP_TIMER_TICKS(MS, PRESCALER)                                                       \
+            ((uint32_t)(((MS) * (uint64_t)APP_TIMER_CLOCK_FREQ) / (((PRESCALER) + 1) * 1000)))
+
+typedef uint32_t app_timer_id_t;                                                              /**< Timer ID type. */
+
+/**@brief Application time-out handler type. */
+typedef void (*app_timer_timeout_handler_t)(void * p_context);
+
+/**@brief Timer modes. */
+typedef enum
+{
+    APP_TIMER_MODE_SINGLE_SHOT,                                                               /**< The timer will expire only once. */
+    APP_TIMER_MODE_REPEATED                                                                   /**< The timer will restart each time it expires. */
+} app_timer_mode_t;
+
+uint32_t app_timer_create(app_timer_id_t *            p_timer_id,
+                          app_timer_mode_t            mode,
+                          app_timer_timeout_handler_t timeout_handler);
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void * p_context);
+uint32_t app_timer_stop(app_timer_id_t timer_id);
+uint32_t app_timer_cnt_get(uint32_t * p_ticks);
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t * p_ticks_diff);
+
+#endif // APP_TIMER_H__
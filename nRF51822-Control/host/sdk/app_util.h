@@ -0,0 +1,46 @@
+#ifndef APP_UTIL_H__
+#define APP_UTIL_H__
+
+/**@file
+ *
+ * @brief Host build of the nRF51 SDK application utilities.
+ */
+
+#include <stdint.h>
+
+/**@brief Interrupt priorities available to the application. */
+typedef enum
+{
+    APP_IRQ_PRIORITY_HIGH = 1,
+    APP_IRQ_PRIORITY_LOW  = 3
+} app_irq_priority_t;
+
+#define STATIC_ASSERT(EXPR)                 typedef char static_assert_failed[(EXPR) ? 1 : -1]         /**< Compile time check. */
+
+#define CEIL_DIV(A, B)                      (((A) - 1) / (B) + 1)                             /**< Division rounded up, A must not be 0. */
+
+#define MSEC_TO_UNITS(TIME, RESOLUTION)     (((TIME) * 1000) / (RESOLUTION))                  /**< Milliseconds to units of RESOLUTION microseconds. */
+
+enum
+{
+    UNIT_0_625_MS = 625,                                                                      /**< Number of microseconds in 0.625 milliseconds. */
+    UNIT_1_25_MS  = 1250,                                                                     /**< Number of microseconds in 1.25 milliseconds. */
+    UNIT_10_MS    = 10000                                                                     /**< Number of microseconds in 10 milliseconds. */
+};
+
+/**@brief Function for encoding a uint16 value in little endian, returns the number of bytes written. */
+static inline uint8_t uint16_encode(uint16_t value, uint8_t * p_encoded_data)
+{
+    p_encoded_data[0] = (uint8_t) ((value & 0x00FF) >> 0);
+    p_encoded_data[1] = (uint8_t) ((value & 0xFF00) >> 8);
+    return sizeof(uint16_t);
+}
+
+/**@brief Function for decoding a little endian uint16 value. */
+static inline uint16_t uint16_decode(const uint8_t * p_encoded_data)
+{
+    return ( (((uint16_t)((uint8_t *)p_encoded_data)[0])) |
+             (((uint16_t)((uint8_t *)p_encoded_data)[1]) << 8 ));
+}
+
+#endif // APP_UTIL_H__
@@ -0,0 +1,83 @@
+#ifndef BLE_H__
+#define BLE_H__
+
+/**@file
+ *
+ * @brief Host build of the S110 BLE event structure and common API.
+ */
+
+#include <stdint.h>
+#include "ble_types.h"
+#include "ble_gap.h"
+#include "ble_gattc.h"
+
+#define BLE_EVT_BASE                        0x01                                              /**< Common BLE Event base. */
+#define BLE_GATTS_EVT_BASE                  0x50                                              /**< GATTS BLE Event base. */
+
+/**@brief Common BLE Event IDs. */
+enum
+{
+    BLE_EVT_TX_COMPLETE = BLE_EVT_BASE,                                                       /**< Transmission Complete. */
+    BLE_EVT_USER_MEM_REQUEST,                                                                 /**< User Memory request. */
+    BLE_EVT_USER_MEM_RELEASE                                                                  /**< User Memory release. */
+};
+
+/**@brief GATT Server Event IDs used by the application. */
+enum
+{
+    BLE_GATTS_EVT_WRITE = BLE_GATTS_EVT_BASE,                                                 /**< Write operation performed. */
+    BLE_GATTS_EVT_TIMEOUT = BLE_GATTS_EVT_BASE + 6                                            /**< Timeout. */
+};
+
+/**@brief GATT Server event, limited to the connection handle. */
+typedef struct
+{
+    uint16_t conn_handle;                                                                     /**< Connection Handle on which event occured. */
+} ble_gatts_evt_t;
+
+/**@brief Event structure for BLE_EVT_TX_COMPLETE. */
+typedef struct
+{
+    uint8_t count;                                                                            /**< Number of packets transmitted. */
+} ble_evt_tx_complete_t;
+
+/**@brief Event structure for common events. */
+typedef struct
+{
+    uint16_t conn_handle;                                                                     /**< Connection Handle on which this event occured. */
+    union
+    {
+        ble_evt_tx_complete_t tx_complete;                                                    /**< Transmission Complete. */
+    } params;
+} ble_common_evt_t;
+
+/**@brief BLE Event header. */
+typedef struct
+{
+    uint16_t evt_id;                                                                          /**< Value from a BLE_<module>_EVT series. */
+    uint16_t evt_len;                                                                         /**< Length in octets excluding this header. */
+} ble_evt_hdr_t;
+
+/**@brief Common BLE Event type, wrapping the module specific event reports. */
+typedef struct
+{
+    ble_evt_hdr_t header;                                                                     /**< Event header. */
+    union
+    {
+        ble_common_evt_t common_evt;                                                          /**< Common Event, evt_id in BLE_EVT_* series. */
+        ble_gap_evt_t    gap_evt;                                                             /**< GAP originated event, evt_id in BLE_GAP_EVT_* series. */
+        ble_gattc_evt_t  gattc_evt;                                                           /**< GATT client originated event, evt_id in BLE_GATTC_EVT* series. */
+        ble_gatts_evt_t  gatts_evt;                                                           /**< GATT server originated event, evt_id in BLE_GATTS_EVT* series. */
+    } evt;
+} ble_evt_t;
+
+/**@brief Common BLE Option type, wrapping the module specific options. */
+typedef union
+{
+    ble_gap_opt_t gap;                                                                        /**< GAP option, opt_id in BLE_GAP_OPT_* series. */
+} ble_opt_t;
+
+uint32_t sd_ble_tx_buffer_count_get(uint8_t * p_count);
+uint32_t sd_ble_opt_set(uint32_t opt_id, ble_opt_t const * p_opt);
+
+#endif // BLE_H__
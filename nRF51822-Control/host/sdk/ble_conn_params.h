@@ -0,0 +1,14 @@
+#ifndef BLE_CONN_PARAMS_H__
+#define BLE_CONN_PARAMS_H__
+
+/**@file
+ *
+ * @brief Host build of the Connection Parameters module API used by the application.
+ */
+
+#include <stdint.h>
+#include "ble_gap.h"
+
+uint32_t ble_conn_params_change_conn_params(ble_gap_conn_params_t * new_params);
+
+#endif // BLE_CONN_PARAMS_H__
@@ -0,0 +1,16 @@
+#ifndef BLE_ERR_H__
+#define BLE_ERR_H__
+
+/**@file
+ *
+ * @brief Host build of the S110 BLE error codes.
+ */
+
+#include "nrf_error.h"
+
+#define BLE_ERROR_NOT_ENABLED               (NRF_ERROR_STK_BASE_NUM + 0x001)                  /**< ble_enable has not been called. */
+#define BLE_ERROR_INVALID_CONN_HANDLE       (NRF_ERROR_STK_BASE_NUM + 0x002)                  /**< Invalid connection handle. */
+#define BLE_ERROR_INVALID_ATTR_HANDLE       (NRF_ERROR_STK_BASE_NUM + 0x003)                  /**< Invalid attribute handle. */
+#define BLE_ERROR_NO_TX_BUFFERS             (NRF_ERROR_STK_BASE_NUM + 0x004)                  /**< Buffer capacity exceeded. */
+
+#endif // BLE_ERR_H__
@@ -0,0 +1,9 @@
+#ifndef BLE_FLASH_H__
+#define BLE_FLASH_H__
+
+/**@file
+ *
+ * @brief Host build placeholder, the AMS client stores its records through the Device Manager.
+ */
+
+#endif // BLE_FLASH_H__
@@ -0,0 +1,98 @@
+#ifndef BLE_GAP_H__
+#define BLE_GAP_H__
+
+/**@file
+ *
+ * @brief Host build of the S110 GAP definitions used by the AMS client.
+ */
+
+#include "ble_types.h"
+
+#define BLE_GAP_EVT_BASE                    0x10                                              /**< GAP BLE Event base. */
+#define BLE_GAP_EVT_LAST                    0x2F                                              /**< GAP BLE Event last. */
+
+#define BLE_GAP_OPT_LOCAL_CONN_LATENCY      0x20                                              /**< Local connection latency option. */
+
+#define BLE_GAP_ADDR_LEN                    6                                                 /**< Bluetooth device address length. */
+
+/**@brief GAP Event IDs. */
+enum
+{
+    BLE_GAP_EVT_CONNECTED = BLE_GAP_EVT_BASE,                                                 /**< Connection established. */
+    BLE_GAP_EVT_DISCONNECTED,                                                                 /**< Disconnected from peer. */
+    BLE_GAP_EVT_CONN_PARAM_UPDATE,                                                            /**< Connection Parameters updated. */
+    BLE_GAP_EVT_SEC_PARAMS_REQUEST,                                                           /**< Request to provide security parameters. */
+    BLE_GAP_EVT_SEC_INFO_REQUEST,                                                             /**< Request to provide security information. */
+    BLE_GAP_EVT_PASSKEY_DISPLAY,                                                              /**< Request to display a passkey to the user. */
+    BLE_GAP_EVT_AUTH_KEY_REQUEST,                                                             /**< Request to provide an authentication key. */
+    BLE_GAP_EVT_AUTH_STATUS,                                                                  /**< Authentication procedure completed with status. */
+    BLE_GAP_EVT_CONN_SEC_UPDATE,                                                              /**< Connection security updated. */
+    BLE_GAP_EVT_TIMEOUT,                                                                      /**< Timeout expired. */
+};
+
+/**@brief Bluetooth Low Energy address. */
+typedef struct
+{
+    uint8_t addr_type;                                                                        /**< See BLE_GAP_ADDR_TYPES. */
+    uint8_t addr[BLE_GAP_ADDR_LEN];                                                           /**< 48-bit address, LSB format. */
+} ble_gap_addr_t;
+
+/**@brief GAP connection parameters. */
+typedef struct
+{
+    uint16_t min_conn_interval;                                                               /**< Minimum Connection Interval in 1.25 ms units. */
+    uint16_t max_conn_interval;                                                               /**< Maximum Connection Interval in 1.25 ms units. */
+    uint16_t slave_latency;                                                                   /**< Slave Latency in number of connection events. */
+    uint16_t conn_sup_timeout;                                                                /**< Connection Supervision Timeout in 10 ms units. */
+} ble_gap_conn_params_t;
+
+/**@brief Event data of BLE_GAP_EVT_CONNECTED. */
+typedef struct
+{
+    ble_gap_addr_t        peer_addr;                                                          /**< Bluetooth address of the peer device. */
+    uint8_t               irk_match :1;                                                       /**< If 1, peer device's address resolved using an IRK. */
+    uint8_t               irk_match_idx :7;                                                   /**< Index in IRK list where the address was matched. */
+    ble_gap_conn_params_t conn_params;                                                        /**< GAP Connection Parameters. */
+} ble_gap_evt_connected_t;
+
+/**@brief Event data of BLE_GAP_EVT_DISCONNECTED. */
+typedef struct
+{
+    uint8_t reason;                                                                           /**< HCI error code. */
+} ble_gap_evt_disconnected_t;
+
+/**@brief Event data of BLE_GAP_EVT_CONN_PARAM_UPDATE. */
+typedef struct
+{
+    ble_gap_conn_params_t conn_params;                                                        /**< GAP Connection Parameters. */
+} ble_gap_evt_conn_param_update_t;
+
+/**@brief GAP event structure. */
+typedef struct
+{
+    uint16_t conn_handle;                                                                     /**< Connection Handle on which event occured. */
+    union
+    {
+        ble_gap_evt_connected_t         connected;                                            /**< Connected Event Parameters. */
+        ble_gap_evt_disconnected_t      disconnected;                                         /**< Disconnected Event Parameters. */
+        ble_gap_evt_conn_param_update_t conn_param_update;                                    /**< Connection Parameter Update Parameters. */
+    } params;
+} ble_gap_evt_t;
+
+/**@brief Local connection latency option. */
+typedef struct
+{
+    uint16_t   conn_handle;                                                                   /**< Connection Handle. */
+    uint16_t   requested_latency;                                                             /**< Requested local connection latency. */
+    uint16_t * p_actual_latency;                                                              /**< Pointer to storage for the actual local connection latency. */
+} ble_gap_opt_local_conn_latency_t;
+
+/**@brief Option structure for GAP options. */
+typedef union
+{
+    ble_gap_opt_local_conn_latency_t local_conn_latency;                                      /**< Parameters for the Local connection latency option. */
+} ble_gap_opt_t;
+
+uint32_t sd_ble_gap_conn_param_update(uint16_t conn_handle, ble_gap_conn_params_t const * p_conn_params);
+
+#endif // BLE_GAP_H__
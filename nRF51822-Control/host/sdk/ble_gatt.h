@@ -0,0 +1,49 @@
+#ifndef BLE_GATT_H__
+#define BLE_GATT_H__
+
+/**@file
+ *
+ * @brief Host build of the S110 common GATT definitions.
+ */
+
+#include "ble_types.h"
+
+#define GATT_MTU_SIZE_DEFAULT               23                                                /**< Default MTU size. */
+
+#define BLE_GATT_HANDLE_INVALID             0x0000                                            /**< Invalid Attribute Handle. */
+
+#define BLE_GATT_OP_INVALID                 0x00                                              /**< Invalid Operation. */
+#define BLE_GATT_OP_WRITE_REQ               0x01                                              /**< Write Request. */
+#define BLE_GATT_OP_WRITE_CMD               0x02                                              /**< Write Command. */
+
+#define BLE_GATT_HVX_INVALID                0x00                                              /**< Invalid Operation. */
+#define BLE_GATT_HVX_NOTIFICATION           0x01                                              /**< Handle Value Notification. */
+#define BLE_GATT_HVX_INDICATION             0x02                                              /**< Handle Value Indication. */
+
+#define BLE_GATT_STATUS_SUCCESS                         0x0000                                /**< Success. */
+#define BLE_GATT_STATUS_ATTERR_INVALID_HANDLE           0x0101                                /**< ATT Error: Invalid Attribute Handle. */
+#define BLE_GATT_STATUS_ATTERR_READ_NOT_PERMITTED       0x0102                                /**< ATT Error: Read not permitted. */
+#define BLE_GATT_STATUS_ATTERR_WRITE_NOT_PERMITTED      0x0103                                /**< ATT Error: Write not permitted. */
+#define BLE_GATT_STATUS_ATTERR_INVALID_PDU              0x0104                                /**< ATT Error: Used in ATT as Invalid PDU. */
+#define BLE_GATT_STATUS_ATTERR_INSUF_AUTHENTICATION     0x0105                                /**< ATT Error: Authenticated link required. */
+#define BLE_GATT_STATUS_ATTERR_REQUEST_NOT_SUPPORTED    0x0106                                /**< ATT Error: Used in ATT as Request Not Supported. */
+#define BLE_GATT_STATUS_ATTERR_INVALID_OFFSET           0x0107                                /**< ATT Error: Offset specified was past the end of the attribute. */
+#define BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND      0x010A                                /**< ATT Error: Used in ATT as Attribute not found. */
+#define BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_LONG       0x010B                                /**< ATT Error: Attribute cannot be read or written using read/write blob requests. */
+#define BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH   0x010D                                /**< ATT Error: Invalid value size. */
+#define BLE_GATT_STATUS_ATTERR_INSUF_ENCRYPTION         0x010F                                /**< ATT Error: Encrypted link required. */
+#define BLE_GATT_STATUS_ATTERR_APP_BEGIN                0x0180                                /**< ATT Error: Application range begin. */
+
+/**@brief GATT Characteristic Properties. */
+typedef struct
+{
+    uint8_t broadcast       :1;                                                               /**< Broadcasting of the value permitted. */
+    uint8_t read            :1;                                                               /**< Reading the value permitted. */
+    uint8_t write_wo_resp   :1;                                                               /**< Writing the value with Write Command permitted. */
+    uint8_t write           :1;                                                               /**< Writing the value with Write Request permitted. */
+    uint8_t notify          :1;                                                               /**< Notications of the value permitted. */
+    uint8_t indicate        :1;                                                               /**< Indications of the value permitted. */
+    uint8_t auth_signed_wr  :1;                                                               /**< Writing the value with Signed Write Command permitted. */
+} ble_gatt_char_props_t;
+
+#endif // BLE_GATT_H__
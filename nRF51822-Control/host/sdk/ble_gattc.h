@@ -0,0 +1,145 @@
+#ifndef BLE_GATTC_H__
+#define BLE_GATTC_H__
+
+/**@file
+ *
+ * @brief Host build of the S110 GATT Client API, served by the simulated SoftDevice.
+ */
+
+#include "ble_types.h"
+#include "ble_gatt.h"
+
+#define BLE_GATTC_EVT_BASE                  0x30                                              /**< GATTC BLE Event base. */
+#define BLE_GATTC_EVT_LAST                  0x4F                                              /**< GATTC BLE Event last. */
+
+/**@brief GATT Client Event IDs. */
+enum
+{
+    BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP = BLE_GATTC_EVT_BASE,                                    /**< Primary Service Discovery Response event. */
+    BLE_GATTC_EVT_REL_DISC_RSP,                                                               /**< Relationship Discovery Response event. */
+    BLE_GATTC_EVT_CHAR_DISC_RSP,                                                              /**< Characteristic Discovery Response event. */
+    BLE_GATTC_EVT_DESC_DISC_RSP,                                                              /**< Descriptor Discovery Response event. */
+    BLE_GATTC_EVT_CHAR_VAL_BY_UUID_READ_RSP,                                                  /**< Read By UUID Response event. */
+    BLE_GATTC_EVT_READ_RSP,                                                                   /**< Read Response event. */
+    BLE_GATTC_EVT_CHAR_VALS_READ_RSP,                                                         /**< Read multiple Response event. */
+    BLE_GATTC_EVT_WRITE_RSP,                                                                  /**< Write Response event. */
+    BLE_GATTC_EVT_HVX,                                                                        /**< Handle Value Notification or Indication event. */
+    BLE_GATTC_EVT_TIMEOUT                                                                     /**< Timeout event. */
+};
+
+/**@brief Operation Handle Range. */
+typedef struct
+{
+    uint16_t start_handle;                                                                    /**< Start Handle. */
+    uint16_t end_handle;                                                                      /**< End Handle. */
+} ble_gattc_handle_range_t;
+
+/**@brief GATT service. */
+typedef struct
+{
+    ble_uuid_t               uuid;                                                            /**< Service UUID. */
+    ble_gattc_handle_range_t handle_range;                                                    /**< Service Handle Range. */
+} ble_gattc_service_t;
+
+/**@brief GATT characteristic. */
+typedef struct
+{
+    ble_uuid_t            uuid;                                                               /**< Characteristic UUID. */
+    ble_gatt_char_props_t char_props;                                                         /**< Characteristic Properties. */
+    uint8_t               char_ext_props : 1;                                                 /**< Extended properties present. */
+    uint16_t              handle_decl;                                                        /**< Handle of the Characteristic Declaration. */
+    uint16_t              handle_value;                                                       /**< Handle of the Characteristic Value. */
+} ble_gattc_char_t;
+
+/**@brief Descriptor. */
+typedef struct
+{
+    uint16_t   handle;                                                                        /**< Descriptor Handle. */
+    ble_uuid_t uuid;                                                                          /**< Descriptor UUID. */
+} ble_gattc_desc_t;
+
+/**@brief Write Parameters. */
+typedef struct
+{
+    uint8_t    write_op;                                                                      /**< Write Operation to be performed, see BLE_GATT_OP_*. */
+    uint16_t   handle;                                                                        /**< Handle to the attribute to be written. */
+    uint16_t   offset;                                                                        /**< Offset in bytes. */
+    uint16_t   len;                                                                           /**< Length of data in bytes. */
+    uint8_t  * p_value;                                                                       /**< Pointer to the value data. */
+    uint8_t    flags;                                                                         /**< Flags for prepared writes. */
+} ble_gattc_write_params_t;
+
+/**@brief Event structure for BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP. */
+typedef struct
+{
+    uint16_t            count;                                                                /**< Service count. */
+    ble_gattc_service_t services[1];                                                          /**< Service data, variable length. */
+} ble_gattc_evt_prim_srvc_disc_rsp_t;
+
+/**@brief Event structure for BLE_GATTC_EVT_CHAR_DISC_RSP. */
+typedef struct
+{
+    uint16_t         count;                                                                   /**< Characteristic count. */
+    ble_gattc_char_t chars[1];                                                                /**< Characteristic data, variable length. */
+} ble_gattc_evt_char_disc_rsp_t;
+
+/**@brief Event structure for BLE_GATTC_EVT_DESC_DISC_RSP. */
+typedef struct
+{
+    uint16_t         count;                                                                   /**< Descriptor count. */
+    ble_gattc_desc_t descs[1];                                                                /**< Descriptor data, variable length. */
+} ble_gattc_evt_desc_disc_rsp_t;
+
+/**@brief Event structure for BLE_GATTC_EVT_READ_RSP. */
+typedef struct
+{
+    uint16_t handle;                                                                          /**< Attribute Handle. */
+    uint16_t offset;                                                                          /**< Offset of the attribute data. */
+    uint16_t len;                                                                             /**< Attribute data length. */
+    uint8_t  data[1];                                                                         /**< Attribute data, variable length. */
+} ble_gattc_evt_read_rsp_t;
+
+/**@brief Event structure for BLE_GATTC_EVT_WRITE_RSP. */
+typedef struct
+{
+    uint16_t handle;                                                                          /**< Attribute Handle. */
+    uint8_t  write_op;                                                                        /**< Type of write operation, see BLE_GATT_OP_*. */
+    uint16_t offset;                                                                          /**< Data Offset. */
+    uint16_t len;                                                                             /**< Data length. */
+    uint8_t  data[1];                                                                         /**< Data, variable length. */
+} ble_gattc_evt_write_rsp_t;
+
+/**@brief Event structure for BLE_GATTC_EVT_HVX. */
+typedef struct
+{
+    uint16_t handle;                                                                          /**< Handle to which the HVx operation applies. */
+    uint8_t  type;                                                                            /**< Indication or Notification, see BLE_GATT_HVX_*. */
+    uint16_t len;                                                                             /**< Attribute data length. */
+    uint8_t  data[1];                                                                         /**< Attribute data, variable length. */
+} ble_gattc_evt_hvx_t;
+
+/**@brief GATTC event type. */
+typedef struct
+{
+    uint16_t conn_handle;                                                                     /**< Connection Handle on which event occured. */
+    uint16_t gatt_status;                                                                     /**< GATT status code for the operation, see BLE_GATT_STATUS_*. */
+    uint16_t error_handle;                                                                    /**< In case of error: The handle causing the error. */
+    union
+    {
+        ble_gattc_evt_prim_srvc_disc_rsp_t prim_srvc_disc_rsp;                                /**< Primary Service Discovery Response Event Parameters. */
+        ble_gattc_evt_char_disc_rsp_t      char_disc_rsp;                                     /**< Characteristic Discovery Response Event Parameters. */
+        ble_gattc_evt_desc_disc_rsp_t      desc_disc_rsp;                                     /**< Descriptor Discovery Response Event Parameters. */
+        ble_gattc_evt_read_rsp_t           read_rsp;                                          /**< Read Response Event Parameters. */
+        ble_gattc_evt_write_rsp_t          write_rsp;                                         /**< Write Response Event Parameters. */
+        ble_gattc_evt_hvx_t                hvx;                                               /**< Handle Value Notification/Indication Event Parameters. */
+    } params;
+} ble_gattc_evt_t;
+
+uint32_t sd_ble_gattc_primary_services_discover(uint16_t conn_handle, uint16_t start_handle, ble_uuid_t const * p_srvc_uuid);
+uint32_t sd_ble_gattc_characteristics_discover(uint16_t conn_handle, ble_gattc_handle_range_t const * p_handle_range);
+uint32_t sd_ble_gattc_descriptors_discover(uint16_t conn_handle, ble_gattc_handle_range_t const * p_handle_range);
+uint32_t sd_ble_gattc_read(uint16_t conn_handle, uint16_t handle, uint16_t offset);
+uint32_t sd_ble_gattc_write(uint16_t conn_handle, ble_gattc_write_params_t const * p_write_params);
+uint32_t sd_ble_gattc_hv_confirm(uint16_t conn_handle, uint16_t handle);
+
+#endif // BLE_GATTC_H__
@@ -0,0 +1,20 @@
+#ifndef BLE_SRV_COMMON_H__
+#define BLE_SRV_COMMON_H__
+
+/**@file
+ *
+ * @brief Host build of the nRF51 SDK common service definitions.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble_types.h"
+#include "app_util.h"
+#include "ble.h"
+#include "ble_gap.h"
+#include "ble_gatt.h"
+
+/**@brief Error handler type. */
+typedef void (*ble_srv_error_handler_t) (uint32_t nrf_error);
+
+#endif // BLE_SRV_COMMON_H__
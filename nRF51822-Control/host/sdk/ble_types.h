@@ -0,0 +1,52 @@
+#ifndef BLE_TYPES_H__
+#define BLE_TYPES_H__
+
+/**@file
+ *
+ * @brief Host build of the S110 common types.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BLE_CONN_HANDLE_INVALID             0xFFFF                                            /**< Invalid connection handle. */
+
+#define BLE_UUID_TYPE_UNKNOWN               0x00                                              /**< Invalid UUID type. */
+#define BLE_UUID_TYPE_BLE                   0x01                                              /**< Bluetooth SIG UUID (16-bit). */
+#define BLE_UUID_TYPE_VENDOR_BEGIN          0x02                                              /**< Vendor UUID types start at this index (128-bit). */
+
+#define BLE_UUID_CHARACTERISTIC                     0x2803                                    /**< Characteristic declaration. */
+#define BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG      0x2902                                    /**< Client Characteristic Configuration. */
+#define BLE_UUID_GATT                               0x1801                                    /**< Generic Attribute Profile service. */
+#define BLE_UUID_GATT_CHARACTERISTIC_SERVICE_CHANGED 0x2A05                                   /**< Service Changed Characteristic. */
+
+/**@brief Copy the values of one UUID to another. */
+#define BLE_UUID_COPY_INST(dst, src)                                                        \
+    do                                                                                      \
+    {                                                                                       \
+        (dst).type = (src).type;                                                            \
+        (dst).uuid = (src).uuid;                                                            \
+    } while (0)
+
+/**@brief Set a Bluetooth SIG 16-bit UUID. */
+#define BLE_UUID_BLE_ASSIGN(instance, value)                                                \
+    do                                                                                      \
+    {                                                                                       \
+        (instance).type = BLE_UUID_TYPE_BLE;                                                \
+        (instance).uuid = value;                                                            \
+    } while (0)
+
+/**@brief 128 bit UUID values. */
+typedef struct
+{
+    uint8_t uuid128[16];
+} ble_uuid128_t;
+
+/**@brief Bluetooth Low Energy UUID type, encapsulates both 16-bit and 128-bit UUIDs. */
+typedef struct
+{
+    uint16_t uuid;                                                                            /**< 16-bit UUID value or octets 12-13 of 128-bit UUID. */
+    uint8_t  type;                                                                            /**< UUID type, see BLE_UUID_TYPE_*. */
+} ble_uuid_t;
+
+#endif // BLE_TYPES_H__
@@ -0,0 +1,73 @@
+#ifndef DEVICE_MANAGER_H__
+#define DEVICE_MANAGER_H__
+
+/**@file
+ *
+ * @brief Host build of the Device Manager API used by the AMS client, served by the simulated
+ *        SoftDevice. The limits come from the application's device_manager_cnfg.h.
+ */
+
+#include <stdint.h>
+#include "ble.h"
+#include "device_manager_cnfg.h"
+
+#define DM_INVALID_ID                       0xFF                                              /**< Invalid instance idenitifer. */
+
+typedef uint32_t api_result_t;                                                                /**< Result of an API call. */
+typedef uint8_t  dm_application_instance_t;                                                   /**< Application instance identifier. */
+
+/**@brief Device Manager events. */
+enum
+{
+    DM_EVT_RFU = 0x00,                                                                        /**< Reserved for future use. */
+    DM_EVT_CONNECTION = 0x11,                                                                 /**< Indicates that link with the peer is established. */
+    DM_EVT_DISCONNECTION,                                                                     /**< Indicates that peer has disconnected. */
+    DM_EVT_SECURITY_SETUP = 0x21,                                                             /**< Security procedure for link started indication. */
+    DM_EVT_SECURITY_SETUP_COMPLETE,                                                           /**< Security procedure for link completion indication. */
+    DM_EVT_LINK_SECURED,                                                                      /**< Indicates that link with the peer is secured. */
+    DM_EVT_SECURITY_SETUP_REFRESH,                                                            /**< Indicates that the security on the link was re-established. */
+    DM_EVT_DEVICE_CONTEXT_LOADED = 0x41,                                                      /**< Indicates that device context for a peer is loaded. */
+    DM_EVT_DEVICE_CONTEXT_STORED,                                                             /**< Indicates that device context is stored persistently. */
+    DM_EVT_DEVICE_CONTEXT_DELETED,                                                            /**< Indicates that device context is deleted. */
+    DM_EVT_SERVICE_CONTEXT_LOADED = 0x51,                                                     /**< Indicates that service context for a peer is loaded. */
+    DM_EVT_SERVICE_CONTEXT_STORED,                                                            /**< Indicates that service context is stored persistently. */
+    DM_EVT_SERVICE_CONTEXT_DELETED,                                                           /**< Indicates that service context is deleted. */
+    DM_EVT_APPL_CONTEXT_LOADED = 0x61,                                                        /**< Indicates that application context for a peer is loaded. */
+    DM_EVT_APPL_CONTEXT_STORED,                                                               /**< Indicates that application context is stored persistently. */
+    DM_EVT_APPL_CONTEXT_DELETED                                                               /**< Indicates that application context is deleted. */
+};
+
+/**@brief Unique Device Manager handle of an application, connection, bond and service. */
+typedef struct
+{
+    uint8_t appl_id;                                                                          /**< Identifies the application instances for the device that is being managed. */
+    uint8_t connection_id;                                                                    /**< Identifies the active connection instance. */
+    uint8_t device_id;                                                                        /**< Identifies peer instance in the data base. */
+    uint8_t service_id;                                                                       /**< Service identifier. */
+} dm_handle_t;
+
+/**@brief Application context of a bond. */
+typedef struct
+{
+    uint32_t  flags;                                                                          /**< Additional flags identifying the application context. */
+    uint32_t  len;                                                                            /**< Length of the context. */
+    uint8_t * p_data;                                                                         /**< Pointer to the context data. */
+} dm_application_context_t;
+
+/**@brief Device Manager event. */
+typedef struct
+{
+    uint8_t event_id;                                                                         /**< Identifies the event. */
+    union
+    {
+        ble_gap_evt_t            * p_gap_param;                                               /**< All events that are triggered in device manager as a result of GAP events. */
+        dm_application_context_t * p_app_context;                                             /**< Application context being loaded or stored. */
+    } event_param;                                                                            /**< Event parameters. */
+    uint16_t event_paramlen;                                                                  /**< Length of the event parameters. */
+} dm_event_t;
+
+api_result_t dm_security_setup_req(dm_handle_t * p_handle);
+api_result_t dm_application_context_set(dm_handle_t const * p_handle, dm_application_context_t const * p_context);
+api_result_t dm_application_context_get(dm_handle_t const * p_handle, dm_application_context_t * p_context);
+
+#endif // DEVICE_MANAGER_H__
@@ -0,0 +1,18 @@
+#ifndef NORDIC_COMMON_H__
+#define NORDIC_COMMON_H__
+
+/**@file
+ *
+ * @brief Host build of the common nRF51 SDK macros.
+ */
+
+#define MSB(a)                              (((a) & 0xFF00) >> 8)                             /**< Most significant byte of a 16 bit value. */
+#define LSB(a)                              ((a) & 0x00FF)                                    /**< Least significant byte of a 16 bit value. */
+
+#define MIN(a, b)                           ((a) < (b) ? (a) : (b))
+#define MAX(a, b)                           ((a) < (b) ? (b) : (a))
+
+#define UNUSED_PARAMETER(X)                 ((void)(X))
+#define UNUSED_VARIABLE(X)                  ((void)(X))
+
+#endif // NORDIC_COMMON_H__
@@ -0,0 +1,30 @@
+#ifndef NRF_H__
+#define NRF_H__
+
+/**@file
+ *
+ * @brief Host build of the nRF51 device header, limited to the interrupts used by the AMS client.
+ */
+
+#include <stdint.h>
+
+/**@brief Interrupt numbers. */
+typedef enum
+{
+    SWI0_IRQn = 20,
+    SWI1_IRQn = 21,
+    SWI2_IRQn = 22,
+    SWI3_IRQn = 23,
+    SWI4_IRQn = 24,
+    SWI5_IRQn = 25
+} IRQn_Type;
+
+/**@brief Data Memory Barrier, also a compiler barrier on the host. */
+#define __DMB()                             __sync_synchronize()
+
+void NVIC_SetPendingIRQ(IRQn_Type IRQn);
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn);
+
+void SWI3_IRQHandler(void);
+
+#endif // NRF_H__
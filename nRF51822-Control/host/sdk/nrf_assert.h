@@ -0,0 +1,13 @@
+#ifndef NRF_ASSERT_H_
+#define NRF_ASSERT_H_
+
+/**@file
+ *
+ * @brief Host build of the nRF51 SDK assert macro, checked with the C library assert.
+ */
+
+#include <assert.h>
+
+#define ASSERT(expr)                        assert(expr)
+
+#endif // NRF_ASSERT_H_
@@ -0,0 +1,33 @@
+#ifndef NRF_ERROR_H__
+#define NRF_ERROR_H__
+
+/**@file
+ *
+ * @brief Host build of the nRF51 SDK error codes, values as in SDK 6.0.
+ */
+
+#define NRF_ERROR_BASE_NUM                  (0x0)                                             /**< Global error base. */
+#define NRF_ERROR_SDM_BASE_NUM              (0x1000)                                          /**< SDM error base. */
+#define NRF_ERROR_SOC_BASE_NUM              (0x2000)                                          /**< SoC error base. */
+#define NRF_ERROR_STK_BASE_NUM              (0x3000)                                          /**< STK error base. */
+
+#define NRF_SUCCESS                         (NRF_ERROR_BASE_NUM + 0)                          /**< Successful command. */
+#define NRF_ERROR_SVC_HANDLER_MISSING       (NRF_ERROR_BASE_NUM + 1)                          /**< SVC handler is missing. */
+#define NRF_ERROR_SOFTDEVICE_NOT_ENABLED    (NRF_ERROR_BASE_NUM + 2)                          /**< SoftDevice has not been enabled. */
+#define NRF_ERROR_INTERNAL                  (NRF_ERROR_BASE_NUM + 3)                          /**< Internal Error. */
+#define NRF_ERROR_NO_MEM                    (NRF_ERROR_BASE_NUM + 4)                          /**< No Memory for operation. */
+#define NRF_ERROR_NOT_FOUND                 (NRF_ERROR_BASE_NUM + 5)                          /**< Not found. */
+#define NRF_ERROR_NOT_SUPPORTED             (NRF_ERROR_BASE_NUM + 6)                          /**< Not supported. */
+#define NRF_ERROR_INVALID_PARAM             (NRF_ERROR_BASE_NUM + 7)                          /**< Invalid Parameter. */
+#define NRF_ERROR_INVALID_STATE             (NRF_ERROR_BASE_NUM + 8)                          /**< Invalid state, operation disallowed in this state. */
+#define NRF_ERROR_INVALID_LENGTH            (NRF_ERROR_BASE_NUM + 9)                          /**< Invalid Length. */
+#define NRF_ERROR_INVALID_FLAGS             (NRF_ERROR_BASE_NUM + 10)                         /**< Invalid Flags. */
+#define NRF_ERROR_INVALID_DATA              (NRF_ERROR_BASE_NUM + 11)                         /**< Invalid Data. */
+#define NRF_ERROR_DATA_SIZE                 (NRF_ERROR_BASE_NUM + 12)                         /**< Data size exceeds limit. */
+#define NRF_ERROR_TIMEOUT                   (NRF_ERROR_BASE_NUM + 13)                         /**< Operation timed out. */
+#define NRF_ERROR_NULL                      (NRF_ERROR_BASE_NUM + 14)                         /**< Null Pointer. */
+#define NRF_ERROR_FORBIDDEN                 (NRF_ERROR_BASE_NUM + 15)                         /**< Forbidden Operation. */
+#define NRF_ERROR_INVALID_ADDR              (NRF_ERROR_BASE_NUM + 16)                         /**< Bad Memory Address. */
+#define NRF_ERROR_BUSY                      (NRF_ERROR_BASE_NUM + 17)                         /**< Busy. */
+
+#endif // NRF_ERROR_H__
@@ -0,0 +1,9 @@
+#ifndef NRF_GPIO_H__
+#define NRF_GPIO_H__
+
+/**@file
+ *
+ * @brief Host build placeholder, the AMS client does not drive GPIOs.
+ */
+
+#endif // NRF_GPIO_H__
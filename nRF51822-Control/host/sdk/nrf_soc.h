@@ -0,0 +1,17 @@
+#ifndef NRF_SOC_H__
+#define NRF_SOC_H__
+
+/**@file
+ *
+ * @brief Host build of the SoftDevice SoC API used by the AMS client.
+ */
+
+#include <stdint.h>
+#include "nrf.h"
+
+uint32_t sd_nvic_SetPriority(IRQn_Type IRQn, uint32_t priority);
+uint32_t sd_nvic_EnableIRQ(IRQn_Type IRQn);
+uint32_t sd_nvic_critical_region_enter(uint8_t * p_is_nested_critical_region);
+uint32_t sd_nvic_critical_region_exit(uint8_t is_nested_critical_region);
+
+#endif // NRF_SOC_H__
@@ -0,0 +1,1094 @@
+#include "sim_ams_server.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "ble_ams_c.h"
+
+#define AMS_ERROR_INVALID_STATE             (BLE_GATT_STATUS_ATTERR_APP_BEGIN + 0x20)         /**< AMS error: notifications are not enabled or no attribute is selected. */
+#define AMS_ERROR_INVALID_COMMAND           (BLE_GATT_STATUS_ATTERR_APP_BEGIN + 0x21)         /**< AMS error: malformed command or unknown entity. */
+#define AMS_ERROR_ABSENT_ATTRIBUTE          (BLE_GATT_STATUS_ATTERR_APP_BEGIN + 0x22)         /**< AMS error: the attribute has no value. */
+
+#define ENTITY_COUNT                        3                                                 /**< Player, Queue and Track. */
+#define ATTRIBUTE_COUNT                     4                                                 /**< Most attributes of an entity. */
+#define ENTITY_UPDATE_HEADER_LENGTH         3                                                 /**< Entity ID, Attribute ID and Entity Update flags. */
+#define ENTITY_UPDATE_VALUE_MAX             (GATT_MTU_SIZE_DEFAULT - 3 - ENTITY_UPDATE_HEADER_LENGTH) /**< Longest value fitting an Entity Update notification. */
+#define SUPPORTED_COMMAND_COUNT             (BLE_AMS_REMOTE_COMMAND_SKIP_BACKWARD + 1)        /**< Remote commands supported by the media app. */
+#define SUPPORTED_COMMANDS_ALL              ((1 << SUPPORTED_COMMAND_COUNT) - 1)              /**< Every remote command, as for Music.app. */
+#define NO_SELECTION                        0xFF                                              /**< No attribute is selected on Entity Attribute. */
+#define SKIP_INTERVAL_MS                    15000                                             /**< Jump of the Skip Forward and Skip Backward commands. */
+#define VOLUME_STEP                         0.0625                                            /**< Change of the Volume Up and Volume Down commands, 16 steps. */
+#define REPEAT_MODE_COUNT                   3                                                 /**< Off, One and All, values of Queue/RepeatMode. */
+#define SHUFFLE_MODE_COUNT                  3                                                 /**< Off, One and All, values of Queue/ShuffleMode. */
+#define TRACKS_PER_ALBUM                    12                                                /**< Tracks of a generated album. */
+
+#define SCRIPT_STEP_MAX                     256                                               /**< Number of steps a script can hold. */
+#define SCRIPT_DEPTH_MAX                    4                                                 /**< Nesting depth of repeat blocks. */
+#define SCRIPT_LINE_MAX                     128                                               /**< Longest script line. */
+
+/**@brief Handles of the attribute table. */
+enum
+{
+    HANDLE_GAP_SERVICE = 1,
+    HANDLE_DEVICE_NAME_DECL,
+    HANDLE_DEVICE_NAME,
+    HANDLE_APPEARANCE_DECL,
+    HANDLE_APPEARANCE,
+    HANDLE_GATT_SERVICE,
+    HANDLE_SERVICE_CHANGED_DECL,
+    HANDLE_SERVICE_CHANGED,
+    HANDLE_SERVICE_CHANGED_CCCD,
+    HANDLE_AMS_SERVICE,
+    HANDLE_REMOTE_COMMAND_DECL,
+    HANDLE_REMOTE_COMMAND,
+    HANDLE_REMOTE_COMMAND_CCCD,
+    HANDLE_ENTITY_UPDATE_DECL,
+    HANDLE_ENTITY_UPDATE,
+    HANDLE_ENTITY_UPDATE_CCCD,
+    HANDLE_ENTITY_ATTRIBUTE_DECL,
+    HANDLE_ENTITY_ATTRIBUTE,
+    HANDLE_DIS_SERVICE,
+    HANDLE_MANUFACTURER_NAME_DECL,
+    HANDLE_MANUFACTURER_NAME,
+    HANDLE_END
+};
+
+#define SERVICE(UUID, UUID128)              { SIM_ATTR_PRIMARY_SERVICE, (UUID), (UUID128), { 0 } }
+#define CHARACTERISTIC(UUID, UUID128, ...)  { SIM_ATTR_CHAR_DECL,  (UUID), (UUID128), { __VA_ARGS__ } }, \
+                                            { SIM_ATTR_CHAR_VALUE, (UUID), (UUID128), { __VA_ARGS__ } }
+#define DESCRIPTOR(UUID)                    { SIM_ATTR_DESCRIPTOR, (UUID), false, { 0 } }
+
+/**@brief GAP and GATT services, up to HANDLE_SERVICE_CHANGED_CCCD. */
+#define ATTRS_GAP_GATT                                                                        \
+    SERVICE(0x1800, false),                                                                   \
+    CHARACTERISTIC(0x2A00, false, .read = 1),                                                 \
+    CHARACTERISTIC(0x2A01, false, .read = 1),                                                 \
+    SERVICE(0x1801, false),                                                                   \
+    CHARACTERISTIC(0x2A05, false, .indicate = 1),                                             \
+    DESCRIPTOR(BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG)
+
+/**@brief AMS and Device Information services, from HANDLE_AMS_SERVICE. */
+#define ATTRS_AMS_DIS                                                                         \
+    SERVICE(BLE_UUID_APPLE_MEDIA_SERVICE, true),                                              \
+    CHARACTERISTIC(BLE_UUID_AMS_REMOTE_COMMAND_CHAR, true, .write = 1, .notify = 1),          \
+    DESCRIPTOR(BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG),                                       \
+    CHARACTERISTIC(BLE_UUID_AMS_ENTITY_UPDATE_CHAR, true, .write = 1, .notify = 1),           \
+    DESCRIPTOR(BLE_UUID_DESCRIPTOR_CLIENT_CHAR_CONFIG),                                       \
+    CHARACTERISTIC(BLE_UUID_AMS_ENTITY_ATTRIBUTE_CHAR, true, .read = 1, .write = 1),          \
+    SERVICE(0x180A, false),                                                                   \
+    CHARACTERISTIC(0x2A29, false, .read = 1)
+
+#define TABLE_CHANGE_SHIFT                  3                                                 /**< Attributes of the Battery service inserted in front of AMS by @ref sim_ams_server_table_change. */
+
+static sim_gatt_attr_t m_attrs[HANDLE_END - 1] =
+{
+    ATTRS_GAP_GATT,
+    ATTRS_AMS_DIS,
+};
+
+static sim_gatt_attr_t m_attrs_changed[HANDLE_END - 1 + TABLE_CHANGE_SHIFT] =
+{
+    ATTRS_GAP_GATT,
+    SERVICE(0x180F, false),
+    CHARACTERISTIC(0x2A19, false, .read = 1),
+    ATTRS_AMS_DIS,
+};
+
+static const uint8_t m_attribute_count[ENTITY_COUNT] = { 3, 4, 4 };                    /**< Number of attributes of each entity. */
+
+/**@brief Media values of the Protocol file. */
+static const char * const m_initial_values[ENTITY_COUNT][ATTRIBUTE_COUNT] =
+{
+    { "Music", "1,1.0,16.127", "0.5957915", NULL },
+    { "1", "823", "2", "0" },
+    { "Nickel Creek", "Reason's Why (The Very Best)", "Jealous of the Moon", "201.990" },
+};
+
+/**@brief Operations of a script step. */
+typedef enum
+{
+    SCRIPT_OP_WAIT,                                                                           /**< Let value milliseconds pass. */
+    SCRIPT_OP_SET,                                                                            /**< Set an attribute to text. */
+    SCRIPT_OP_QUEUE,                                                                          /**< Load a queue of value tracks and play its first one. */
+    SCRIPT_OP_SKIP,                                                                           /**< Move value tracks through the queue. */
+    SCRIPT_OP_PLAY,                                                                           /**< Resume playback. */
+    SCRIPT_OP_PAUSE,                                                                          /**< Pause playback. */
+    SCRIPT_OP_SEEK,                                                                           /**< Move the playback position to, or by, value milliseconds. */
+    SCRIPT_OP_VOLUME,                                                                         /**< Set, or change, the volume by volume. */
+    SCRIPT_OP_COMMANDS,                                                                       /**< Set the supported remote commands to the bitmap in value. */
+    SCRIPT_OP_REPEAT,                                                                         /**< Run the block up to the matching end value times. */
+    SCRIPT_OP_END                                                                             /**< End of a repeat block. */
+} script_op_t;
+
+/**@brief Step of a playback session script. */
+typedef struct
+{
+    script_op_t                         op;
+    int32_t                             value;                                            /**< Time, count or bitmap, depending on op. */
+    double                              volume;                                           /**< Volume, for SCRIPT_OP_VOLUME. */
+    bool                                relative;                                         /**< Whether value or volume is a change rather than an absolute setting. */
+    uint8_t                             entity_id;                                        /**< Entity, for SCRIPT_OP_SET. */
+    uint8_t                             attribute_id;                                     /**< Attribute, for SCRIPT_OP_SET. */
+    uint16_t                            match;                                            /**< Index of the matching end or repeat step. */
+    char                                text[SIM_AMS_SERVER_VALUE_MAX];                   /**< Value, for SCRIPT_OP_SET. */
+} script_step_t;
+
+/**@brief State of the service as seen by one connected device. */
+typedef struct
+{
+    uint8_t                             subscribed[ENTITY_COUNT];                         /**< Bit n set if attribute n of the entity is subscribed to. */
+    uint16_t                            rc_cccd;
+    uint16_t                            eu_cccd;
+    uint8_t                             selected_entity;                                  /**< Entity selected on Entity Attribute. */
+    uint8_t                             selected_attribute;                               /**< Attribute selected on Entity Attribute. */
+} link_t;
+
+static char      m_values[ENTITY_COUNT][ATTRIBUTE_COUNT][SIM_AMS_SERVER_VALUE_MAX];
+static link_t    m_links[SIM_CONN_COUNT];                                               /**< Per connection state, indexed by connection handle. */
+static uint16_t  m_sc_cccd[SIM_CONN_COUNT];                                             /**< Service Changed CCCD of each master, kept across connections like for a bonded device. */
+static bool      m_sc_pending[SIM_CONN_COUNT];                                          /**< Whether a master has yet to be told of a table change. */
+static bool      m_table_changed;                                                       /**< Whether m_attrs_changed is served. */
+static sim_ams_server_stats_t m_stats;
+
+static uint16_t  m_supported_commands;                                                  /**< Bit n set if RemoteCommandID n is supported. */
+static bool      m_playing;
+static uint32_t  m_elapsed_ms;                                                          /**< Playback position at m_elapsed_time_us. */
+static uint64_t  m_elapsed_time_us;                                                     /**< Virtual time the playback position was last set. */
+static uint32_t  m_duration_ms;                                                         /**< Duration of the current track. */
+static uint32_t  m_queue_index;
+static uint32_t  m_queue_count;
+static double    m_volume;
+static uint8_t   m_shuffle_mode;
+static uint8_t   m_repeat_mode;
+
+static script_step_t m_script[SCRIPT_STEP_MAX];
+static uint16_t  m_script_length;
+static uint16_t  m_script_pc;                                                           /**< Index of the next step. */
+static int32_t   m_script_loops[SCRIPT_DEPTH_MAX];                                      /**< Remaining runs of the open repeat blocks. */
+static uint8_t   m_script_depth;
+static bool      m_script_started;                                                      /**< Whether the script has been started by a connection event. */
+static uint64_t  m_script_time_us;                                                      /**< Virtual time the next step is due. */
+
+/**@brief Function for getting the handle an attribute of the enum has in the table served.
+ */
+static uint16_t handle_to_table(uint16_t handle)
+{
+    return (m_table_changed && (handle > HANDLE_SERVICE_CHANGED_CCCD)) ? (handle + TABLE_CHANGE_SHIFT) : handle;
+}
+
+/**@brief Function for getting the enum handle of an attribute in the table served, 0 for the
+ *        attributes only in m_attrs_changed.
+ */
+static uint16_t handle_from_table(uint16_t handle)
+{
+    if (!m_table_changed || (handle <= HANDLE_SERVICE_CHANGED_CCCD))
+    {
+        return handle;
+    }
+    return (handle > HANDLE_SERVICE_CHANGED_CCCD + TABLE_CHANGE_SHIFT) ? (handle - TABLE_CHANGE_SHIFT) : 0;
+}
+
+/**@brief Function for notifying an attribute on Entity Update to one connection if subscribed to.
+ */
+static void entity_update_link_notify(uint16_t conn_handle, uint8_t entity_id, uint8_t attribute_id)
+{
+    const link_t * p_link = &m_links[conn_handle];
+    uint8_t        data[ENTITY_UPDATE_HEADER_LENGTH + ENTITY_UPDATE_VALUE_MAX];
+    uint16_t       len;
+
+    if ((p_link->eu_cccd & BLE_GATT_HVX_NOTIFICATION) == 0 ||
+        (p_link->subscribed[entity_id] & (1 << attribute_id)) == 0)
+    {
+        return;
+    }
+
+    len     = strlen(m_values[entity_id][attribute_id]);
+    data[0] = entity_id;
+    data[1] = attribute_id;
+    data[2] = 0;
+    if (len > ENTITY_UPDATE_VALUE_MAX)
+    {
+        len      = ENTITY_UPDATE_VALUE_MAX;
+        data[2] |= BLE_AMS_ENTITY_UPDATE_FLAG_TRUNCATED;
+    }
+    memcpy(&data[ENTITY_UPDATE_HEADER_LENGTH], m_values[entity_id][attribute_id], len);
+
+    m_stats.notifications++;
+    (void)sim_hvx_send(conn_handle, handle_to_table(HANDLE_ENTITY_UPDATE), BLE_GATT_HVX_NOTIFICATION, data, ENTITY_UPDATE_HEADER_LENGTH + len);
+}
+
+/**@brief Function for notifying an attribute on Entity Update to every subscribed connection.
+ */
+static void entity_update_notify(uint8_t entity_id, uint8_t attribute_id)
+{
+    uint16_t conn_handle;
+
+    for (conn_handle = 0; conn_handle < SIM_CONN_COUNT; conn_handle++)
+    {
+        entity_update_link_notify(conn_handle, entity_id, attribute_id);
+    }
+}
+
+/**@brief Function for notifying the supported remote commands to one connection.
+ */
+static void remote_command_link_notify(uint16_t conn_handle)
+{
+    uint8_t commands[SUPPORTED_COMMAND_COUNT];
+    uint8_t count = 0;
+    uint8_t i;
+
+    if ((m_links[conn_handle].rc_cccd & BLE_GATT_HVX_NOTIFICATION) == 0)
+    {
+        return;
+    }
+
+    for (i = 0; i < SUPPORTED_COMMAND_COUNT; i++)
+    {
+        if (m_supported_commands & (1 << i))
+        {
+            commands[count++] = i;
+        }
+    }
+
+    m_stats.notifications++;
+    (void)sim_hvx_send(conn_handle, handle_to_table(HANDLE_REMOTE_COMMAND), BLE_GATT_HVX_NOTIFICATION, commands, count);
+}
+
+/**@brief Function for notifying the supported remote commands to every connection.
+ */
+static void remote_command_notify(void)
+{
+    uint16_t conn_handle;
+
+    for (conn_handle = 0; conn_handle < SIM_CONN_COUNT; conn_handle++)
+    {
+        remote_command_link_notify(conn_handle);
+    }
+}
+
+/**@brief Function for changing an attribute and notifying it.
+ */
+static void value_set(uint8_t entity_id, uint8_t attribute_id, const char * p_value)
+{
+    snprintf(m_values[entity_id][attribute_id], SIM_AMS_SERVER_VALUE_MAX, "%s", p_value);
+    entity_update_notify(entity_id, attribute_id);
+}
+
+/**@brief Function for changing an attribute to a formatted value and notifying it.
+ */
+static void value_printf(uint8_t entity_id, uint8_t attribute_id, const char * p_format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+static void value_printf(uint8_t entity_id, uint8_t attribute_id, const char * p_format, ...)
+{
+    char    value[SIM_AMS_SERVER_VALUE_MAX];
+    va_list args;
+
+    va_start(args, p_format);
+    vsnprintf(value, sizeof(value), p_format, args);
+    va_end(args);
+
+    value_set(entity_id, attribute_id, value);
+}
+
+/**@brief Function for getting the playback position.
+ */
+static uint32_t elapsed_get(void)
+{
+    uint64_t elapsed_ms = m_elapsed_ms;
+
+    if (m_playing)
+    {
+        elapsed_ms += (sim_time_us() - m_elapsed_time_us) / 1000;
+    }
+    return (uint32_t)MIN(elapsed_ms, m_duration_ms);
+}
+
+/**@brief Function for setting the playback position and notifying Player/PlaybackInfo.
+ */
+static void playback_set(bool playing, uint32_t elapsed_ms)
+{
+    m_playing         = playing;
+    m_elapsed_ms      = MIN(elapsed_ms, m_duration_ms);
+    m_elapsed_time_us = sim_time_us();
+
+    value_printf(BLE_AMS_ENTITY_ID_PLAYER,
+                 BLE_AMS_PLAYER_ATTRIBUTE_ID_PLAYBACK_INFO,
+                 "%u,%s,%u.%03u",
+                 m_playing ? 1 : 0,
+                 m_playing ? "1.0" : "0.0",
+                 (unsigned)(m_elapsed_ms / 1000),
+                 (unsigned)(m_elapsed_ms % 1000));
+}
+
+/**@brief Function for loading a track of the queue, as Music.app notifies it.
+ *
+ * @details Albums get long names, so their Entity Updates are truncated. Every fourth title
+ *          is long as well.
+ */
+static void track_load(uint32_t index)
+{
+    uint32_t album = index / TRACKS_PER_ALBUM;
+
+    m_queue_index = index;
+    m_duration_ms = (150 + ((index * 37) % 180)) * 1000 + ((index * 251) % 1000);
+    m_stats.track_changes++;
+
+    value_printf(BLE_AMS_ENTITY_ID_TRACK, BLE_AMS_TRACK_ATTRIBUTE_ID_ARTIST, "Artist %u", (unsigned)(album % 40));
+    value_printf(BLE_AMS_ENTITY_ID_TRACK, BLE_AMS_TRACK_ATTRIBUTE_ID_ALBUM, "Album %u (Deluxe Edition)", (unsigned)album);
+    value_printf(BLE_AMS_ENTITY_ID_TRACK,
+                 BLE_AMS_TRACK_ATTRIBUTE_ID_TITLE,
+                 (index % 4) == 3 ? "Track %u (Live at the Ryman)" : "Track %u",
+                 (unsigned)index);
+    value_printf(BLE_AMS_ENTITY_ID_TRACK,
+                 BLE_AMS_TRACK_ATTRIBUTE_ID_DURATION,
+                 "%u.%03u",
+                 (unsigned)(m_duration_ms / 1000),
+                 (unsigned)(m_duration_ms % 1000));
+    value_printf(BLE_AMS_ENTITY_ID_QUEUE, BLE_AMS_QUEUE_ATTRIBUTE_ID_INDEX, "%u", (unsigned)index);
+    playback_set(m_playing, 0);
+}
+
+/**@brief Function for moving through the queue, wrapping around at its ends.
+ */
+static void queue_skip(int32_t count)
+{
+    int64_t index = ((int64_t)m_queue_index + count) % (int64_t)m_queue_count;
+
+    track_load((uint32_t)((index < 0) ? (index + m_queue_count) : index));
+}
+
+/**@brief Function for setting the volume and notifying Player/Volume.
+ */
+static void volume_set(double volume)
+{
+    m_volume = (volume < 0.0) ? 0.0 : ((volume > 1.0) ? 1.0 : volume);
+    value_printf(BLE_AMS_ENTITY_ID_PLAYER, BLE_AMS_PLAYER_ATTRIBUTE_ID_VOLUME, "%g", m_volume);
+}
+
+/**@brief Function for applying a remote command like Music.app.
+ */
+static void remote_command_apply(uint8_t command)
+{
+    switch (command)
+    {
+        case BLE_AMS_REMOTE_COMMAND_PLAY:
+            playback_set(true, elapsed_get());
+            break;
+
+        case BLE_AMS_REMOTE_COMMAND_PAUSE:
+            playback_set(false, elapsed_get());
+            break;
+
+        case BLE_AMS_REMOTE_COMMAND_TOGGLE_PLAY_PAUSE:
+            playback_set(!m_playing, elapsed_get());
+            break;
+
+        case BLE_AMS_REMOTE_COMMAND_NEXT_TRACK:
+            queue_skip(1);
+            break;
+
+        case BLE_AMS_REMOTE_COMMAND_PREV_TRACK:
+            queue_skip(-1);
+            break;
+
+        case BLE_AMS_REMOTE_COMMAND_VOLUME_UP:
+            volume_set(m_volume + VOLUME_STEP);
+            break;
+
+        case BLE_AMS_REMOTE_COMMAND_VOLUME_DOWN:
+            volume_set(m_volume - VOLUME_STEP);
+            break;
+
+        case BLE_AMS_REMOTE_COMMAND_REPEAT_MODE:
+            m_repeat_mode = (m_repeat_mode + 1) % REPEAT_MODE_COUNT;
+            value_printf(BLE_AMS_ENTITY_ID_QUEUE, BLE_AMS_QUEUE_ATTRIBUTE_ID_REPEAT_MODE, "%u", m_repeat_mode);
+            break;
+
+        case BLE_AMS_REMOTE_COMMAND_SHUFFLE_MODE:
+            m_shuffle_mode = (m_shuffle_mode + 1) % SHUFFLE_MODE_COUNT;
+            value_printf(BLE_AMS_ENTITY_ID_QUEUE, BLE_AMS_QUEUE_ATTRIBUTE_ID_SHUFFLE_MODE, "%u", m_shuffle_mode);
+            break;
+
+        case BLE_AMS_REMOTE_COMMAND_SKIP_FORWARD:
+            playback_set(m_playing, elapsed_get() + SKIP_INTERVAL_MS);
+            break;
+
+        case BLE_AMS_REMOTE_COMMAND_SKIP_BACKWARD:
+            playback_set(m_playing, (elapsed_get() > SKIP_INTERVAL_MS) ? (elapsed_get() - SKIP_INTERVAL_MS) : 0);
+            break;
+    }
+}
+
+/**@brief Function for running the next step of the script.
+ */
+static void script_step_run(void)
+{
+    const script_step_t * p_step = &m_script[m_script_pc++];
+
+    m_stats.script_steps++;
+
+    switch (p_step->op)
+    {
+        case SCRIPT_OP_WAIT:
+            m_script_time_us += (uint64_t)p_step->value * 1000;
+            break;
+
+        case SCRIPT_OP_SET:
+            value_set(p_step->entity_id, p_step->attribute_id, p_step->text);
+            break;
+
+        case SCRIPT_OP_QUEUE:
+            m_queue_count = p_step->value;
+            value_printf(BLE_AMS_ENTITY_ID_QUEUE, BLE_AMS_QUEUE_ATTRIBUTE_ID_COUNT, "%u", (unsigned)m_queue_count);
+            track_load(0);
+            break;
+
+        case SCRIPT_OP_SKIP:
+            queue_skip(p_step->value);
+            break;
+
+        case SCRIPT_OP_PLAY:
+            playback_set(true, elapsed_get());
+            break;
+
+        case SCRIPT_OP_PAUSE:
+            playback_set(false, elapsed_get());
+            break;
+
+        case SCRIPT_OP_SEEK:
+        {
+            int64_t elapsed_ms = p_step->relative ? ((int64_t)elapsed_get() + p_step->value) : p_step->value;
+            playback_set(m_playing, (elapsed_ms < 0) ? 0 : (uint32_t)elapsed_ms);
+            break;
+        }
+
+        case SCRIPT_OP_VOLUME:
+            volume_set(p_step->relative ? (m_volume + p_step->volume) : p_step->volume);
+            break;
+
+        case SCRIPT_OP_COMMANDS:
+            m_supported_commands = p_step->value;
+            remote_command_notify();
+            break;
+
+        case SCRIPT_OP_REPEAT:
+            if (p_step->value <= 0)
+            {
+                m_script_pc = p_step->match + 1;
+            }
+            else
+            {
+                m_script_loops[m_script_depth++] = p_step->value;
+            }
+            break;
+
+        case SCRIPT_OP_END:
+            if (--m_script_loops[m_script_depth - 1] > 0)
+            {
+                m_script_pc = p_step->match + 1;
+            }
+            else
+            {
+                m_script_depth--;
+            }
+            break;
+    }
+}
+
+/**@brief Function for reading a time in seconds, with up to millisecond resolution, as milliseconds.
+ */
+static bool seconds_parse(const char * p_text, int32_t * p_ms, bool * p_relative)
+{
+    char * p_end;
+    double seconds;
+
+    *p_relative = (*p_text == '+') || (*p_text == '-');
+    seconds     = strtod(p_text, &p_end);
+    *p_ms       = (int32_t)(seconds * 1000 + ((seconds < 0) ? -0.5 : 0.5));
+
+    return (p_end != p_text) && (*p_end == '\0');
+}
+
+/**@brief Function for reading an integer argument.
+ */
+static bool integer_parse(const char * p_text, int32_t * p_value)
+{
+    char * p_end;
+
+    *p_value = (int32_t)strtol(p_text, &p_end, 0);
+    return (p_end != p_text) && (*p_end == '\0');
+}
+
+/**@brief Function for reading an entity name or ID.
+ */
+static bool entity_parse(const char * p_text, uint8_t * p_entity_id)
+{
+    static const char * const names[ENTITY_COUNT] = { "player", "queue", "track" };
+    int32_t                   value;
+    uint8_t                   i;
+
+    for (i = 0; i < ENTITY_COUNT; i++)
+    {
+        if (strcmp(p_text, names[i]) == 0)
+        {
+            *p_entity_id = i;
+            return true;
+        }
+    }
+
+    if (integer_parse(p_text, &value) && (value >= 0) && (value < ENTITY_COUNT))
+    {
+        *p_entity_id = value;
+        return true;
+    }
+    return false;
+}
+
+/**@brief Function for reading a comma separated list of remote command IDs as a bitmap.
+ */
+static bool commands_parse(char * p_text, int32_t * p_bitmap)
+{
+    char * p_token;
+    char * p_save;
+
+    *p_bitmap = 0;
+    if (strcmp(p_text, "none") == 0)
+    {
+        return true;
+    }
+    if (strcmp(p_text, "all") == 0)
+    {
+        *p_bitmap = SUPPORTED_COMMANDS_ALL;
+        return true;
+    }
+
+    for (p_token = strtok_r(p_text, ",", &p_save); p_token != NULL; p_token = strtok_r(NULL, ",", &p_save))
+    {
+        int32_t command;
+
+        if (!integer_parse(p_token, &command) || (command < 0) || (command >= SUPPORTED_COMMAND_COUNT))
+        {
+            return false;
+        }
+        *p_bitmap |= (1 << command);
+    }
+    return true;
+}
+
+/**@brief Function for parsing one script line into a step.
+ *
+ * @param[in]   p_line  Line without comment, modified while parsing.
+ * @param[out]  p_step  Step, left alone for blank lines.
+ * @param[out]  p_blank Whether the line holds no step.
+ *
+ * @return      false if the line is malformed, true otherwise.
+ */
+static bool script_line_parse(char * p_line, script_step_t * p_step, bool * p_blank)
+{
+    char * p_save;
+    char * p_keyword = strtok_r(p_line, " \t\r\n", &p_save);
+    char * p_arg;
+
+    *p_blank = (p_keyword == NULL);
+    if (*p_blank)
+    {
+        return true;
+    }
+
+    memset(p_step, 0, sizeof(*p_step));
+
+    if (strcmp(p_keyword, "set") == 0)
+    {
+        char *  p_entity    = strtok_r(NULL, " \t", &p_save);
+        char *  p_attribute = strtok_r(NULL, " \t", &p_save);
+        int32_t attribute_id;
+
+        p_step->op = SCRIPT_OP_SET;
+        if ((p_entity == NULL) || (p_attribute == NULL) ||
+            !entity_parse(p_entity, &p_step->entity_id) ||
+            !integer_parse(p_attribute, &attribute_id) ||
+            (attribute_id < 0) || (attribute_id >= m_attribute_count[p_step->entity_id]))
+        {
+            return false;
+        }
+        p_step->attribute_id = attribute_id;
+
+        // The value is the rest of the line, spaces included.
+        p_arg = strtok_r(NULL, "\r\n", &p_save);
+        while ((p_arg != NULL) && isspace((unsigned char)*p_arg))
+        {
+            p_arg++;
+        }
+        snprintf(p_step->text, sizeof(p_step->text), "%s", (p_arg != NULL) ? p_arg : "");
+        return true;
+    }
+
+    p_arg = strtok_r(NULL, " \t\r\n", &p_save);
+    if (strtok_r(NULL, " \t\r\n", &p_save) != NULL)
+    {
+        return false;
+    }
+
+    if (strcmp(p_keyword, "wait") == 0)
+    {
+        p_step->op = SCRIPT_OP_WAIT;
+        return (p_arg != NULL) && integer_parse(p_arg, &p_step->value) && (p_step->value >= 0);
+    }
+    if (strcmp(p_keyword, "queue") == 0)
+    {
+        p_step->op = SCRIPT_OP_QUEUE;
+        return (p_arg != NULL) && integer_parse(p_arg, &p_step->value) && (p_step->value > 0);
+    }
+    if ((strcmp(p_keyword, "next") == 0) || (strcmp(p_keyword, "prev") == 0))
+    {
+        p_step->op    = SCRIPT_OP_SKIP;
+        p_step->value = 1;
+        if ((p_arg != NULL) && (!integer_parse(p_arg, &p_step->value) || (p_step->value <= 0)))
+        {
+            return false;
+        }
+        if (p_keyword[0] == 'p')
+        {
+            p_step->value = -p_step->value;
+        }
+        return true;
+    }
+    if ((strcmp(p_keyword, "play") == 0) || (strcmp(p_keyword, "pause") == 0))
+    {
+        p_step->op = (strcmp(p_keyword, "play") == 0) ? SCRIPT_OP_PLAY : SCRIPT_OP_PAUSE;
+        return (p_arg == NULL);
+    }
+    if (strcmp(p_keyword, "seek") == 0)
+    {
+        p_step->op = SCRIPT_OP_SEEK;
+        return (p_arg != NULL) && seconds_parse(p_arg, &p_step->value, &p_step->relative);
+    }
+    if (strcmp(p_keyword, "volume") == 0)
+    {
+        char * p_end;
+
+        p_step->op = SCRIPT_OP_VOLUME;
+        if (p_arg == NULL)
+        {
+            return false;
+        }
+        p_step->relative = (*p_arg == '+') || (*p_arg == '-');
+        p_step->volume   = strtod(p_arg, &p_end);
+        return (p_end != p_arg) && (*p_end == '\0');
+    }
+    if (strcmp(p_keyword, "commands") == 0)
+    {
+        p_step->op = SCRIPT_OP_COMMANDS;
+        return (p_arg != NULL) && commands_parse(p_arg, &p_step->value);
+    }
+    if (strcmp(p_keyword, "repeat") == 0)
+    {
+        p_step->op = SCRIPT_OP_REPEAT;
+        return (p_arg != NULL) && integer_parse(p_arg, &p_step->value) && (p_step->value >= 0);
+    }
+    if (strcmp(p_keyword, "end") == 0)
+    {
+        p_step->op = SCRIPT_OP_END;
+        return (p_arg == NULL);
+    }
+    return false;
+}
+
+static void server_connect(uint16_t conn_handle)
+{
+    link_t * p_link = &m_links[conn_handle];
+
+    memset(p_link->subscribed, 0, sizeof(p_link->subscribed));
+    p_link->rc_cccd            = 0;
+    p_link->eu_cccd            = 0;
+    p_link->selected_entity    = NO_SELECTION;
+    p_link->selected_attribute = NO_SELECTION;
+}
+
+/**@brief Function for indicating a table change to a master that enabled Service Changed.
+ */
+static void service_changed_indicate(uint16_t conn_handle)
+{
+    uint8_t range[4];
+
+    if (!m_sc_pending[conn_handle] || ((m_sc_cccd[conn_handle] & BLE_GATT_HVX_INDICATION) == 0))
+    {
+        return;
+    }
+
+    // Everything after the GATT service may have moved.
+    (void)uint16_encode(HANDLE_SERVICE_CHANGED_CCCD + 1, &range[0]);
+    (void)uint16_encode(0xFFFF, &range[2]);
+
+    if (sim_hvx_send(conn_handle, HANDLE_SERVICE_CHANGED, BLE_GATT_HVX_INDICATION, range, sizeof(range)) == NRF_SUCCESS)
+    {
+        m_sc_pending[conn_handle] = false;
+    }
+}
+
+static void server_conn_event(uint16_t conn_handle, uint32_t event_counter)
+{
+    UNUSED_PARAMETER(event_counter);
+
+    service_changed_indicate(conn_handle);
+
+    if (m_script_pc == m_script_length)
+    {
+        return;
+    }
+    if (!m_script_started)
+    {
+        m_script_started = true;
+        m_script_time_us = sim_time_us();
+    }
+
+    while ((m_script_pc < m_script_length) && (m_script_time_us <= sim_time_us()))
+    {
+        script_step_run();
+    }
+}
+
+/**@brief Function for handling a CCCD write.
+ */
+static uint16_t cccd_write(uint16_t * p_cccd, const uint8_t * p_data, uint16_t len)
+{
+    if (len != 2)
+    {
+        return BLE_GATT_STATUS_ATTERR_INVALID_ATT_VAL_LENGTH;
+    }
+    *p_cccd = uint16_decode(p_data);
+    return BLE_GATT_STATUS_SUCCESS;
+}
+
+/**@brief Function for handling a subscription written to Entity Update.
+ *
+ * @details A subscription replaces the previous one of the entity, the current values of the
+ *          subscribed attributes are notified right away.
+ */
+static uint16_t entity_update_write(uint16_t conn_handle, const uint8_t * p_data, uint16_t len)
+{
+    link_t * p_link     = &m_links[conn_handle];
+    uint8_t  entity_id;
+    uint8_t  attributes = 0;
+    uint8_t  i;
+
+    if ((p_link->eu_cccd & BLE_GATT_HVX_NOTIFICATION) == 0)
+    {
+        return AMS_ERROR_INVALID_STATE;
+    }
+    if ((len < 2) || (p_data[0] >= ENTITY_COUNT))
+    {
+        return AMS_ERROR_INVALID_COMMAND;
+    }
+
+    entity_id = p_data[0];
+    for (i = 1; i < len; i++)
+    {
+        if (p_data[i] >= m_attribute_count[entity_id])
+        {
+            return AMS_ERROR_INVALID_COMMAND;
+        }
+        attributes |= (1 << p_data[i]);
+    }
+
+    p_link->subscribed[entity_id] = attributes;
+    for (i = 0; i < m_attribute_count[entity_id]; i++)
+    {
+        entity_update_link_notify(conn_handle, entity_id, i);
+    }
+    return BLE_GATT_STATUS_SUCCESS;
+}
+
+/**@brief Function for handling an attribute selection written to Entity Attribute.
+ */
+static uint16_t entity_attribute_write(uint16_t conn_handle, const uint8_t * p_data, uint16_t len)
+{
+    if ((len != 2) || (p_data[0] >= ENTITY_COUNT) || (p_data[1] >= m_attribute_count[p_data[0]]))
+    {
+        return AMS_ERROR_INVALID_COMMAND;
+    }
+
+    m_links[conn_handle].selected_entity    = p_data[0];
+    m_links[conn_handle].selected_attribute = p_data[1];
+    return BLE_GATT_STATUS_SUCCESS;
+}
+
+/**@brief Function for handling a remote command.
+ */
+static uint16_t remote_command_write(const uint8_t * p_data, uint16_t len)
+{
+    if ((len != 1) || (p_data[0] >= SUPPORTED_COMMAND_COUNT) || ((m_supported_commands & (1 << p_data[0])) == 0))
+    {
+        return AMS_ERROR_INVALID_COMMAND;
+    }
+
+    m_stats.remote_commands++;
+    remote_command_apply(p_data[0]);
+    return BLE_GATT_STATUS_SUCCESS;
+}
+
+static uint16_t server_write(uint16_t conn_handle, uint16_t handle, const uint8_t * p_data, uint16_t len)
+{
+    link_t * p_link = &m_links[conn_handle];
+    uint16_t status;
+
+    switch (handle_from_table(handle))
+    {
+        case HANDLE_SERVICE_CHANGED_CCCD:
+            return cccd_write(&m_sc_cccd[conn_handle], p_data, len);
+
+        case HANDLE_REMOTE_COMMAND_CCCD:
+            status = cccd_write(&p_link->rc_cccd, p_data, len);
+            if (status == BLE_GATT_STATUS_SUCCESS)
+            {
+                remote_command_link_notify(conn_handle);
+            }
+            return status;
+
+        case HANDLE_ENTITY_UPDATE_CCCD:
+            return cccd_write(&p_link->eu_cccd, p_data, len);
+
+        case HANDLE_REMOTE_COMMAND:
+            return remote_command_write(p_data, len);
+
+        case HANDLE_ENTITY_UPDATE:
+            return entity_update_write(conn_handle, p_data, len);
+
+        case HANDLE_ENTITY_ATTRIBUTE:
+            return entity_attribute_write(conn_handle, p_data, len);
+
+        default:
+            return BLE_GATT_STATUS_ATTERR_WRITE_NOT_PERMITTED;
+    }
+}
+
+static uint16_t server_read(uint16_t conn_handle, uint16_t handle, uint16_t offset, uint8_t * p_data, uint16_t * p_len)
+{
+    const link_t * p_link = &m_links[conn_handle];
+    const char *   p_value;
+    uint16_t       len;
+
+    switch (handle_from_table(handle))
+    {
+        case HANDLE_DEVICE_NAME:
+            p_value = "iPhone";
+            break;
+
+        case HANDLE_MANUFACTURER_NAME:
+            p_value = "Apple Inc.";
+            break;
+
+        case HANDLE_ENTITY_ATTRIBUTE:
+            if (p_link->selected_entity == NO_SELECTION)
+            {
+                return AMS_ERROR_INVALID_STATE;
+            }
+            p_value = m_values[p_link->selected_entity][p_link->selected_attribute];
+            if (*p_value == '\0')
+            {
+                return AMS_ERROR_ABSENT_ATTRIBUTE;
+            }
+            break;
+
+        default:
+            return BLE_GATT_STATUS_ATTERR_READ_NOT_PERMITTED;
+    }
+
+    len = strlen(p_value);
+    if (offset > len)
+    {
+        return BLE_GATT_STATUS_ATTERR_INVALID_OFFSET;
+    }
+
+    *p_len = MIN(*p_len, len - offset);
+    memcpy(p_data, &p_value[offset], *p_len);
+    return BLE_GATT_STATUS_SUCCESS;
+}
+
+static sim_gatt_server_t m_server =
+{
+    .p_attrs    = m_attrs,
+    .attr_count = HANDLE_END - 1,
+    .connect    = server_connect,
+    .conn_event = server_conn_event,
+    .write      = server_write,
+    .read       = server_read,
+};
+
+void sim_ams_server_init(void)
+{
+    uint8_t  entity_id;
+    uint8_t  attribute_id;
+    uint16_t conn_handle;
+
+    memset(m_values, 0, sizeof(m_values));
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    for (entity_id = 0; entity_id < ENTITY_COUNT; entity_id++)
+    {
+        for (attribute_id = 0; attribute_id < m_attribute_count[entity_id]; attribute_id++)
+        {
+            strcpy(m_values[entity_id][attribute_id], m_initial_values[entity_id][attribute_id]);
+        }
+    }
+
+    // Playback state matching the values above.
+    m_supported_commands = SUPPORTED_COMMANDS_ALL;
+    m_playing            = true;
+    m_elapsed_ms         = 16127;
+    m_elapsed_time_us    = sim_time_us();
+    m_duration_ms        = 201990;
+    m_queue_index        = 1;
+    m_queue_count        = 823;
+    m_volume             = 0.5957915;
+    m_shuffle_mode       = 2;
+    m_repeat_mode        = 0;
+
+    sim_ams_server_rc_write_cmd_set(false);
+
+    memset(m_sc_cccd, 0, sizeof(m_sc_cccd));
+    memset(m_sc_pending, 0, sizeof(m_sc_pending));
+    m_table_changed     = false;
+    m_server.p_attrs    = m_attrs;
+    m_server.attr_count = HANDLE_END - 1;
+
+    m_script_length = 0;
+    m_script_pc     = 0;
+    for (conn_handle = 0; conn_handle < SIM_CONN_COUNT; conn_handle++)
+    {
+        server_connect(conn_handle);
+    }
+}
+
+const sim_gatt_server_t * sim_ams_server_get(void)
+{
+    return &m_server;
+}
+
+void sim_ams_server_rc_write_cmd_set(bool enable)
+{
+    m_attrs[HANDLE_REMOTE_COMMAND_DECL - 1].props.write_wo_resp = enable ? 1 : 0;
+    m_attrs[HANDLE_REMOTE_COMMAND - 1].props.write_wo_resp      = enable ? 1 : 0;
+
+    m_attrs_changed[HANDLE_REMOTE_COMMAND_DECL + TABLE_CHANGE_SHIFT - 1].props.write_wo_resp = enable ? 1 : 0;
+    m_attrs_changed[HANDLE_REMOTE_COMMAND + TABLE_CHANGE_SHIFT - 1].props.write_wo_resp      = enable ? 1 : 0;
+}
+
+void sim_ams_server_table_change(void)
+{
+    uint16_t conn_handle;
+
+    m_table_changed     = !m_table_changed;
+    m_server.p_attrs    = m_table_changed ? m_attrs_changed : m_attrs;
+    m_server.attr_count = m_table_changed ? (HANDLE_END - 1 + TABLE_CHANGE_SHIFT) : (HANDLE_END - 1);
+
+    for (conn_handle = 0; conn_handle < SIM_CONN_COUNT; conn_handle++)
+    {
+        m_sc_pending[conn_handle] = true;
+    }
+}
+
+void sim_ams_server_attr_set(uint8_t entity_id, uint8_t attribute_id, const char * p_value)
+{
+    if ((entity_id >= ENTITY_COUNT) || (attribute_id >= m_attribute_count[entity_id]))
+    {
+        return;
+    }
+    value_set(entity_id, attribute_id, p_value);
+}
+
+uint32_t sim_ams_server_script_load(const char * p_script)
+{
+    uint16_t open_blocks[SCRIPT_DEPTH_MAX];
+    uint8_t  depth       = 0;
+    uint16_t length      = 0;
+    uint32_t line_number = 0;
+
+    while (*p_script != '\0')
+    {
+        char         line[SCRIPT_LINE_MAX];
+        size_t       line_length = strcspn(p_script, "\n");
+        char *       p_comment;
+        bool         blank;
+
+        line_number++;
+        if (line_length >= sizeof(line))
+        {
+            fprintf(stderr, "script line %u: too long\n", (unsigned)line_number);
+            return NRF_ERROR_INVALID_LENGTH;
+        }
+        memcpy(line, p_script, line_length);
+        line[line_length] = '\0';
+        p_script         += line_length + ((p_script[line_length] == '\n') ? 1 : 0);
+
+        p_comment = strchr(line, '#');
+        if (p_comment != NULL)
+        {
+            *p_comment = '\0';
+        }
+
+        if (length == SCRIPT_STEP_MAX)
+        {
+            fprintf(stderr, "script line %u: more than %u steps\n", (unsigned)line_number, SCRIPT_STEP_MAX);
+            return NRF_ERROR_NO_MEM;
+        }
+        if (!script_line_parse(line, &m_script[length], &blank))
+        {
+            fprintf(stderr, "script line %u: malformed step\n", (unsigned)line_number);
+            return NRF_ERROR_INVALID_PARAM;
+        }
+        if (blank)
+        {
+            continue;
+        }
+
+        if (m_script[length].op == SCRIPT_OP_REPEAT)
+        {
+            if (depth == SCRIPT_DEPTH_MAX)
+            {
+                fprintf(stderr, "script line %u: repeat nested too deep\n", (unsigned)line_number);
+                return NRF_ERROR_INVALID_PARAM;
+            }
+            open_blocks[depth++] = length;
+        }
+        else if (m_script[length].op == SCRIPT_OP_END)
+        {
+            if (depth == 0)
+            {
+                fprintf(stderr, "script line %u: end without repeat\n", (unsigned)line_number);
+                return NRF_ERROR_INVALID_PARAM;
+            }
+            m_script[length].match                = open_blocks[--depth];
+            m_script[open_blocks[depth]].match    = length;
+        }
+        length++;
+    }
+
+    if (depth != 0)
+    {
+        fprintf(stderr, "script: repeat without end\n");
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_script_length  = length;
+    m_script_pc      = 0;
+    m_script_depth   = 0;
+    m_script_started = false;
+
+    return NRF_SUCCESS;
+}
+
+bool sim_ams_server_script_done(void)
+{
+    return (m_script_pc == m_script_length);
+}
+
+const sim_ams_server_stats_t * sim_ams_server_stats_get(void)
+{
+    return &m_stats;
+}
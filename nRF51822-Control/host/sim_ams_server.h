@@ -0,0 +1,104 @@
+#ifndef SIM_AMS_SERVER_H__
+#define SIM_AMS_SERVER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "sim_softdevice.h"
+
+/**@file
+ *
+ * @brief Simulated Apple Media Service of an iOS device, the GATT server for @ref sim_init.
+ *
+ * @details The attribute table holds the GAP and GATT services, AMS with its Remote Command,
+ *          Entity Update and Entity Attribute characteristics, and a trailing Device Information
+ *          service, so discovery walks the same ranges as on a phone. @ref sim_ams_server_table_change
+ *          moves AMS and indicates Service Changed. The media values start out
+ *          as in the Protocol file. Subscribed attributes are notified when subscribed to and
+ *          whenever they change, values longer than an Entity Update notification are truncated
+ *          and can be read in full through Entity Attribute. Remote commands act on the
+ *          playback state like Music.app does. Every connected master shows the same media
+ *          player, the subscriptions and the Entity Attribute selection are per connection.
+ *
+ *          Playback sessions are described by scripts, one step per line, # starts a comment:
+ *
+ *          - wait MS                       let MS milliseconds pass.
+ *          - queue COUNT                   load a queue of COUNT generated tracks, play the first.
+ *          - next [N], prev [N]            skip N tracks (default 1) through the queue.
+ *          - play, pause                   change the playback state.
+ *          - seek SECONDS                  move the playback position to, or by with +/-, SECONDS.
+ *          - volume VALUE                  set, or change with +/-, the volume (0 to 1).
+ *          - commands LIST                 change the supported remote commands, LIST is a comma
+ *                                          separated list of IDs, all or none.
+ *          - set ENTITY ATTRIBUTE VALUE    set any attribute, ENTITY is player, queue, track or
+ *                                          an ID, VALUE the rest of the line.
+ *          - repeat N ... end              run the steps in between N times, may be nested.
+ *
+ *          A loaded script starts at the next connection event. For example, rapid skips
+ *          through an 823 track queue:
+ *
+ *              queue 823
+ *              repeat 100
+ *                  next
+ *                  wait 50
+ *              end
+ */
+
+#define SIM_AMS_SERVER_VALUE_MAX            64                                                /**< Largest attribute value held by the server. */
+
+/**@brief Counters of the server, reset by @ref sim_ams_server_init and @ref sim_ams_server_script_load. */
+typedef struct
+{
+    uint32_t                            script_steps;                                     /**< Number of script steps run. */
+    uint32_t                            notifications;                                    /**< Number of notifications sent, including those lost in the master queue. */
+    uint32_t                            remote_commands;                                  /**< Number of remote commands received. */
+    uint32_t                            track_changes;                                    /**< Number of tracks loaded. */
+} sim_ams_server_stats_t;
+
+/**@brief Function for resetting the media values and the subscriptions, and unloading the script. */
+void sim_ams_server_init(void);
+
+/**@brief Function for getting the GATT server to pass to @ref sim_init. */
+const sim_gatt_server_t * sim_ams_server_get(void);
+
+/**@brief Function for allowing Remote Command to be written without response.
+ *
+ * @details Only the characteristic properties change, a client finds out on its next discovery.
+ *          Off after @ref sim_ams_server_init.
+ *
+ * @param[in]   enable  Whether Write Command is permitted on Remote Command.
+ */
+void sim_ams_server_rc_write_cmd_set(bool enable);
+
+/**@brief Function for inserting a Battery service in front of AMS, or removing it again, like an
+ *        iOS update might.
+ *
+ * @details The AMS handles move by three. Every master that enabled Service Changed indications
+ *          is indicated on its next connection event, the CCCD is kept across connections like
+ *          for a bonded device. Undone by @ref sim_ams_server_init.
+ */
+void sim_ams_server_table_change(void);
+
+/**@brief Function for changing an attribute, notifying it if subscribed to.
+ *
+ * @param[in]   entity_id       Entity, see @ref ble_ams_entity_id_values_t.
+ * @param[in]   attribute_id    Attribute within the entity.
+ * @param[in]   p_value         NUL terminated UTF-8 value, cut at SIM_AMS_SERVER_VALUE_MAX - 1 bytes.
+ */
+void sim_ams_server_attr_set(uint8_t entity_id, uint8_t attribute_id, const char * p_value);
+
+/**@brief Function for loading a playback session script, replacing the current one.
+ *
+ * @param[in]   p_script    Script text, see the file description.
+ *
+ * @return      NRF_SUCCESS, or an error code if the script is malformed or too long. The faulty
+ *              line is reported on stderr.
+ */
+uint32_t sim_ams_server_script_load(const char * p_script);
+
+/**@brief Function for checking whether every step of the script has run. */
+bool sim_ams_server_script_done(void);
+
+/**@brief Function for getting the counters of the server. */
+const sim_ams_server_stats_t * sim_ams_server_stats_get(void);
+
+#endif // SIM_AMS_SERVER_H__
@@ -0,0 +1,106 @@
+#include "sim_app.h"
+#include <string.h>
+#include "ams_app.h"
+#include "nordic_common.h"
+#include "app_error.h"
+
+#define APP_TIMER_PRESCALER                 0                                                 /**< Value of the RTC1 PRESCALER register. */
+
+#define DEFAULT_CONN_INTERVAL_US            30000                                             /**< Connection interval iOS grants a new connection. */
+#define DEFAULT_PACKETS_PER_EVENT           4                                                 /**< Packets the master sends per connection event. */
+#define DEFAULT_RESPONSE_EVENTS             1                                                 /**< Connection events until the master responds. */
+#define DEFAULT_TX_BUFFERS                  7                                                 /**< Stack TX buffers of the S110. */
+#define DEFAULT_ENCRYPT_EVENTS              2                                                 /**< Connection events until a bonded master has encrypted the link. */
+#define DEFAULT_PAIRING_EVENTS              10                                                /**< Connection events to pair with a new master. */
+#define DEFAULT_MASTER_QUEUE_SIZE           32                                                /**< Packets the master holds for sending. */
+
+static ble_ams_c_t *                    m_clients[SIM_CONN_COUNT];                        /**< Clients served by sim_app_clients_init. */
+static uint8_t                          m_client_count;                                   /**< Number of entries in m_clients. */
+
+static void device_manager_evt_handler(dm_handle_t const * p_handle, dm_event_t const * p_event)
+{
+    ams_app_on_dm_evt(p_handle, p_event);
+}
+
+static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
+{
+    ams_app_on_ble_evt(p_ble_evt);
+}
+
+static void clients_dm_evt_handler(dm_handle_t const * p_handle, dm_event_t const * p_event)
+{
+    uint32_t i;
+
+    for (i = 0; i < m_client_count; i++)
+    {
+        ble_ams_c_on_device_manager_evt(m_clients[i], p_handle, p_event);
+    }
+}
+
+static void clients_ble_evt_dispatch(ble_evt_t * p_ble_evt)
+{
+    uint32_t i;
+
+    for (i = 0; i < m_client_count; i++)
+    {
+        ble_ams_c_on_ble_evt(m_clients[i], p_ble_evt);
+    }
+}
+
+void sim_app_params_default(sim_link_params_t * p_params)
+{
+    memset(p_params, 0, sizeof(sim_link_params_t));
+    p_params->conn_interval_us  = DEFAULT_CONN_INTERVAL_US;
+    p_params->packets_per_event = DEFAULT_PACKETS_PER_EVENT;
+    p_params->response_events   = DEFAULT_RESPONSE_EVENTS;
+    p_params->tx_buffers        = DEFAULT_TX_BUFFERS;
+    p_params->encrypt_events    = DEFAULT_ENCRYPT_EVENTS;
+    p_params->pairing_events    = DEFAULT_PAIRING_EVENTS;
+    p_params->master_queue_size = DEFAULT_MASTER_QUEUE_SIZE;
+}
+
+void sim_app_init(const sim_link_params_t * p_params,
+                  const sim_gatt_server_t * p_server,
+                  ble_ams_c_evt_handler_t   evt_handler)
+{
+    static const sim_handlers_t handlers =
+    {
+        .ble_evt_handler = ble_evt_dispatch,
+        .dm_evt_handler  = device_manager_evt_handler,
+    };
+    ams_app_init_t ams_init;
+
+    sim_init(p_params, &handlers, p_server);
+
+    ams_init.timer_prescaler = APP_TIMER_PRESCALER;
+    ams_init.evt_handler     = evt_handler;
+
+    ams_app_init(&ams_init);
+}
+
+void sim_app_clients_init(const sim_link_params_t * p_params,
+                          const sim_gatt_server_t * p_server,
+                          ble_ams_c_t * const     * pp_clients,
+                          uint8_t                   client_count)
+{
+    static const sim_handlers_t handlers =
+    {
+        .ble_evt_handler = clients_ble_evt_dispatch,
+        .dm_evt_handler  = clients_dm_evt_handler,
+    };
+
+    if (client_count > SIM_CONN_COUNT)
+    {
+        APP_ERROR_HANDLER(NRF_ERROR_INVALID_PARAM);
+    }
+
+    memcpy(m_clients, pp_clients, client_count * sizeof(ble_ams_c_t *));
+    m_client_count = client_count;
+
+    sim_init(p_params, &handlers, p_server);
+}
+
+void sim_app_error_handler(uint32_t nrf_error)
+{
+    APP_ERROR_HANDLER(nrf_error);
+}
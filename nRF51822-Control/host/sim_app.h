@@ -0,0 +1,56 @@
+#ifndef SIM_APP_H__
+#define SIM_APP_H__
+
+#include "ble_ams_c.h"
+#include "sim_softdevice.h"
+
+/**@file
+ *
+ * @brief The example application on the simulated SoftDevice, for the host benchmarks.
+ *
+ * @details Passes the BLE stack and Device Manager events to ams_app like ble_evt_dispatch and
+ *          device_manager_evt_handler of main.c, so the benchmarks run the client as it is
+ *          used on the chip. Use ams_app_client_get to reach the client.
+ */
+
+/**@brief Function for getting the link parameters of an iPhone close by.
+ *
+ * @details A 30 ms connection interval, 4 packets per connection event, responses in the next
+ *          connection event, 7 TX buffers, encryption after 2 connection events, pairing after 10
+ *          and up to 32 packets queued by the master. Callers change what they measure.
+ *
+ * @param[out]  p_params        Link parameters.
+ */
+void sim_app_params_default(sim_link_params_t * p_params);
+
+/**@brief Function for resetting the simulation and initializing the application.
+ *
+ * @param[in]   p_params        Link parameters.
+ * @param[in]   p_server        GATT server of the master.
+ * @param[in]   evt_handler     Called with every client event after the application has handled it.
+ */
+void sim_app_init(const sim_link_params_t * p_params,
+                  const sim_gatt_server_t * p_server,
+                  ble_ams_c_evt_handler_t   evt_handler);
+
+/**@brief Function for resetting the simulation with the events going straight to AMS clients,
+ *        for tests of the client without the application.
+ *
+ * @details Every BLE stack and Device Manager event is passed to every client, in the order
+ *          given. Initialize the clients afterwards, with @ref sim_app_error_handler as their
+ *          error handler.
+ *
+ * @param[in]   p_params        Link parameters.
+ * @param[in]   p_server        GATT server of the master.
+ * @param[in]   pp_clients      Clients to pass the events to, up to SIM_CONN_COUNT.
+ * @param[in]   client_count    Number of clients in pp_clients.
+ */
+void sim_app_clients_init(const sim_link_params_t * p_params,
+                          const sim_gatt_server_t * p_server,
+                          ble_ams_c_t * const     * pp_clients,
+                          uint8_t                   client_count);
+
+/**@brief Function for handling an error of an AMS client or the application, ends the run. */
+void sim_app_error_handler(uint32_t nrf_error);
+
+#endif // SIM_APP_H__
@@ -0,0 +1,1457 @@
+#include "sim_softdevice.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "ble_err.h"
+#include "nrf_soc.h"
+#include "app_util.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_scheduler.h"
+#include "ble_conn_params.h"
+
+#define MASTER_QUEUE_MAX_SIZE               256                                               /**< Largest supported master_queue_size. */
+#define SLAVE_QUEUE_SIZE                    16                                                /**< Number of packets the client can queue for the next connection event. */
+#define ATT_READ_RSP_MAX_LENGTH             (GATT_MTU_SIZE_DEFAULT - 1)                       /**< Largest value in a (Blob) Read Response. */
+#define ATT_WRITE_MAX_LENGTH                (GATT_MTU_SIZE_DEFAULT - 3)                       /**< Largest value in a Write Request. */
+#define ATT_CHAR_DISC_MAX_16                3                                                 /**< Characteristics with 16 bit UUIDs in one Read By Type Response. */
+#define ATT_DESC_DISC_MAX_16                5                                                 /**< Attributes with 16 bit UUIDs in one Find Information Response. */
+#define UUID_PRIMARY_SERVICE                0x2800                                            /**< Type of a primary service declaration. */
+#define UUID_CHARACTERISTIC                 0x2803                                            /**< Type of a characteristic declaration. */
+#define TIMER_COUNT                         8                                                 /**< Number of app_timer instances. */
+#define SCHED_QUEUE_SIZE                    8                                                 /**< Number of app_scheduler events, as in the example application. */
+#define SCHED_EVENT_SIZE                    64                                                /**< Largest app_scheduler event. */
+#define RTC_COUNTER_MASK                    0x00FFFFFF                                        /**< The RTC counter is 24 bits wide. */
+#define CONN_PARAM_UPDATE_EVENTS            6                                                 /**< Connection events from a connection parameter update request to the instant the master applies it. */
+
+/**@brief Storage for a BLE stack event with its variable length data. */
+typedef union
+{
+    ble_evt_t                           evt;
+    uint8_t                             raw[SIM_EVT_BUF_SIZE];
+} evt_buf_t;
+
+/**@brief Packet queued by the master. */
+typedef struct
+{
+    uint32_t                            ready_event;                                      /**< First connection event the packet can be sent in. */
+    evt_buf_t                           buf;                                              /**< Stack event the packet results in. */
+} master_packet_t;
+
+/**@brief Types of packets sent by the client. */
+typedef enum
+{
+    SLAVE_PACKET_PRIM_SRVC_DISC,
+    SLAVE_PACKET_CHAR_DISC,
+    SLAVE_PACKET_DESC_DISC,
+    SLAVE_PACKET_READ,
+    SLAVE_PACKET_WRITE
+} slave_packet_type_t;
+
+/**@brief Packet queued by the client for the next connection event. */
+typedef struct
+{
+    slave_packet_type_t                 type;                                             /**< Type of the packet. */
+    uint16_t                            handle;                                           /**< Attribute, or start of the handle range. */
+    uint16_t                            end_handle;                                       /**< End of the handle range, for discoveries. */
+    uint16_t                            offset;                                           /**< Offset, for reads. */
+    ble_uuid_t                          uuid;                                             /**< Service UUID, for primary service discovery. */
+    uint8_t                             write_op;                                         /**< Write operation, for writes. */
+    uint16_t                            len;                                              /**< Length of data. */
+    uint8_t                             data[ATT_WRITE_MAX_LENGTH];                       /**< Value, for writes. */
+} slave_packet_t;
+
+/**@brief app_timer instance. */
+typedef struct
+{
+    bool                                created;
+    bool                                running;
+    app_timer_mode_t                    mode;
+    app_timer_timeout_handler_t         handler;
+    void *                              p_context;
+    uint64_t                            deadline_us;                                      /**< Virtual time of the next expiry. */
+    uint64_t                            period_us;                                        /**< Timeout, used to restart repeated timers. */
+} sim_timer_t;
+
+/**@brief app_scheduler event. */
+typedef struct
+{
+    app_sched_event_handler_t           handler;
+    uint16_t                            size;
+    uint8_t                             data[SCHED_EVENT_SIZE];
+} sched_event_t;
+
+/**@brief Bond held by the Device Manager. */
+typedef struct
+{
+    bool                                bonded;                                           /**< Whether the entry holds a bond. */
+    bool                                context_valid;                                    /**< Whether an application context has been stored. */
+    uint8_t                             context[DEVICE_MANAGER_APP_CONTEXT_SIZE];         /**< Application context, stands in for flash. */
+} bond_t;
+
+/**@brief State of a connection, the master on connection handle n uses entry n. */
+typedef struct
+{
+    uint16_t                            conn_handle;                                      /**< Handle of the connection. */
+    bool                                connected;
+    uint32_t                            event_counter;                                    /**< Number of the last connection event. */
+    uint64_t                            next_event_us;                                    /**< Virtual time of the next connection event. */
+    ble_gap_conn_params_t               conn_params;                                      /**< Parameters of the connection, the interval in min and max. */
+    ble_gap_conn_params_t               conn_params_update;                               /**< Parameters requested by the client. */
+    uint32_t                            conn_params_event;                                /**< Connection event the requested parameters apply in, 0 if no update is running. */
+    uint32_t                            hvx_ready_event;                                  /**< Connection event for notifications queued by the server now. */
+    master_packet_t                     master_queue[MASTER_QUEUE_MAX_SIZE];
+    uint32_t                            master_head;
+    uint32_t                            master_count;
+    slave_packet_t                      slave_queue[SLAVE_QUEUE_SIZE];
+    uint32_t                            slave_count;
+    bool                                request_pending;                                  /**< Whether an ATT request awaits its response, only one may. */
+    uint8_t                             tx_free;                                          /**< Free stack TX buffers for write commands, unless the links share them. */
+    bool                                local_latency_set;                                /**< Whether the client set a local connection latency since the last parameter update. */
+    uint16_t                            local_latency;                                    /**< Local connection latency granted to the client. */
+    uint16_t                            events_skipped;                                   /**< Connection events skipped since the slave last listened. */
+    dm_handle_t                         dm_handle;                                        /**< Device Manager handle of the connection. */
+    ble_gap_evt_t                       dm_gap_evt;                                       /**< GAP event referenced by Device Manager events. */
+    uint32_t                            security_event;                                   /**< Connection event the security procedure completes in, 0 if none is running. */
+    bool                                secured;
+} conn_t;
+
+static sim_link_params_t                m_params;
+static sim_handlers_t                   m_handlers;
+static const sim_gatt_server_t *        mp_server;
+static sim_stats_t                      m_stats;
+
+static uint64_t                         m_now_us = 0;                                     /**< Virtual time. */
+static conn_t                           m_conns[SIM_CONN_COUNT];
+static const ble_evt_t *                mp_ble_evt = NULL;                                /**< BLE stack event being passed to the application. */
+static bool                             m_critical_region;                                /**< Whether the application is inside a critical region. */
+
+static bond_t                           m_bonds[DEVICE_MANAGER_MAX_BONDS];
+static uint8_t                          m_master_bonds[SIM_CONN_COUNT] =
+                                            { [0 ... SIM_CONN_COUNT - 1] = DM_INVALID_ID }; /**< Bond of each simulated master. */
+
+static sim_timer_t                      m_timers[TIMER_COUNT];
+static sched_event_t                    m_sched_queue[SCHED_QUEUE_SIZE];
+static uint32_t                         m_sched_head;
+static uint32_t                         m_sched_count;
+static bool                             m_kick_pending;                                   /**< Whether SWI3 is pending, accessed atomically as it may be pended from another thread. */
+static uint8_t                          m_tx_pool_free;                                   /**< Free stack TX buffers of all links, if tx_buffers_shared is set. */
+
+void app_error_handler(uint32_t error_code, uint32_t line_num, const uint8_t * p_file_name)
+{
+    fprintf(stderr, "%s:%u: error 0x%04x\n", (const char *)p_file_name, (unsigned)line_num, (unsigned)error_code);
+    exit(EXIT_FAILURE);
+}
+
+/**@brief Function for reading the host clock in nanoseconds.
+ */
+static uint64_t cpu_time_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000000) + now.tv_nsec;
+}
+
+/**@brief Function for running the interrupts pended by the last events, then the main loop.
+ */
+static void context_run(void)
+{
+    uint64_t start = cpu_time_ns();
+    uint64_t elapsed;
+
+    do
+    {
+        while (__atomic_exchange_n(&m_kick_pending, false, __ATOMIC_SEQ_CST))
+        {
+            SWI3_IRQHandler();
+        }
+        app_sched_execute();
+    } while (__atomic_load_n(&m_kick_pending, __ATOMIC_SEQ_CST));
+
+    elapsed                      = cpu_time_ns() - start;
+    m_stats.main_loop_cpu_ns    += elapsed;
+    m_stats.main_loop_cpu_ns_max = MAX(m_stats.main_loop_cpu_ns_max, elapsed);
+}
+
+/**@brief Function for passing a BLE stack event to the application.
+ *
+ * @details The application sees every event of a connection event from the BLE stack interrupt
+ *          before the main loop runs, see @ref context_run.
+ */
+static void ble_evt_deliver(ble_evt_t * p_ble_evt)
+{
+    uint64_t start = cpu_time_ns();
+    uint64_t elapsed;
+
+    mp_ble_evt = p_ble_evt;
+    m_handlers.ble_evt_handler(p_ble_evt);
+    mp_ble_evt = NULL;
+
+    elapsed                    = cpu_time_ns() - start;
+    m_stats.ble_evt_cpu_ns    += elapsed;
+    m_stats.ble_evt_cpu_ns_max = MAX(m_stats.ble_evt_cpu_ns_max, elapsed);
+    m_stats.ble_events++;
+}
+
+/**@brief Function for passing a GAP event without parameters of a connection to the application.
+ */
+static void gap_evt_deliver(conn_t * p_conn, uint16_t evt_id)
+{
+    evt_buf_t buf;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.evt.header.evt_id           = evt_id;
+    buf.evt.header.evt_len          = sizeof(ble_gap_evt_t);
+    buf.evt.evt.gap_evt.conn_handle = p_conn->conn_handle;
+
+    ble_evt_deliver(&buf.evt);
+}
+
+/**@brief Function for passing a Device Manager event of a connection to the application.
+ */
+static void dm_evt_deliver(conn_t * p_conn, uint8_t event_id)
+{
+    dm_event_t event;
+
+    memset(&event, 0, sizeof(event));
+    p_conn->dm_gap_evt.conn_handle = p_conn->conn_handle;
+    event.event_id                 = event_id;
+    event.event_param.p_gap_param  = &p_conn->dm_gap_evt;
+    event.event_paramlen           = sizeof(p_conn->dm_gap_evt);
+
+    m_handlers.dm_evt_handler(&p_conn->dm_handle, &event);
+}
+
+/**@brief Function for getting the state of a connection.
+ *
+ * @return State, or NULL if the handle is not that of a connected master.
+ */
+static conn_t * conn_get(uint16_t conn_handle)
+{
+    if ((conn_handle >= SIM_CONN_COUNT) || !m_conns[conn_handle].connected)
+    {
+        return NULL;
+    }
+    return &m_conns[conn_handle];
+}
+
+/**@brief Function for getting the free stack TX buffers a connection takes write commands from.
+ */
+static uint8_t * tx_free_get(conn_t * p_conn)
+{
+    return m_params.tx_buffers_shared ? &m_tx_pool_free : &p_conn->tx_free;
+}
+
+/**@brief Function for allocating a packet at the tail of the master queue of a connection.
+ *
+ * @details Notifications may fill master_queue_size packets, responses the whole queue.
+ *
+ * @return Event of the packet to fill in, or NULL if the queue is full.
+ */
+static ble_evt_t * master_packet_alloc(conn_t * p_conn, uint16_t evt_id, uint32_t ready_event)
+{
+    master_packet_t * p_packet;
+    uint32_t          limit = (evt_id == BLE_GATTC_EVT_HVX) ? m_params.master_queue_size : MASTER_QUEUE_MAX_SIZE;
+
+    if (p_conn->master_count >= limit)
+    {
+        return NULL;
+    }
+
+    p_packet = &p_conn->master_queue[(p_conn->master_head + p_conn->master_count++) % MASTER_QUEUE_MAX_SIZE];
+    memset(&p_packet->buf, 0, sizeof(p_packet->buf));
+
+    p_packet->ready_event                       = ready_event;
+    p_packet->buf.evt.header.evt_id             = evt_id;
+    p_packet->buf.evt.header.evt_len            = sizeof(ble_gattc_evt_t);
+    p_packet->buf.evt.evt.gattc_evt.conn_handle = p_conn->conn_handle;
+
+    return &p_packet->buf.evt;
+}
+
+/**@brief Function for allocating the response to a request of the client.
+ *
+ * @details Responses are never lost, only one request is outstanding at a time.
+ */
+static ble_gattc_evt_t * response_alloc(conn_t * p_conn, uint16_t evt_id, uint16_t gatt_status)
+{
+    ble_evt_t * p_ble_evt = master_packet_alloc(p_conn, evt_id, p_conn->event_counter + m_params.response_events);
+
+    if (p_ble_evt == NULL)
+    {
+        APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+    }
+
+    p_ble_evt->evt.gattc_evt.gatt_status = gatt_status;
+    return &p_ble_evt->evt.gattc_evt;
+}
+
+/**@brief Function for getting an attribute of the server table.
+ */
+static const sim_gatt_attr_t * attr_get(uint16_t handle)
+{
+    if ((handle == 0) || (handle > mp_server->attr_count))
+    {
+        return NULL;
+    }
+    return &mp_server->p_attrs[handle - 1];
+}
+
+/**@brief Function for getting the attribute type as reported by Find Information.
+ */
+static void attr_uuid_get(const sim_gatt_attr_t * p_attr, ble_uuid_t * p_uuid, bool * p_uuid128)
+{
+    switch (p_attr->type)
+    {
+        case SIM_ATTR_PRIMARY_SERVICE:
+            BLE_UUID_BLE_ASSIGN(*p_uuid, UUID_PRIMARY_SERVICE);
+            *p_uuid128 = false;
+            break;
+
+        case SIM_ATTR_CHAR_DECL:
+            BLE_UUID_BLE_ASSIGN(*p_uuid, UUID_CHARACTERISTIC);
+            *p_uuid128 = false;
+            break;
+
+        default:
+            p_uuid->uuid = p_attr->uuid;
+            p_uuid->type = p_attr->uuid128 ? BLE_UUID_TYPE_VENDOR_BEGIN : BLE_UUID_TYPE_BLE;
+            *p_uuid128   = p_attr->uuid128;
+            break;
+    }
+}
+
+/**@brief Function for answering a primary service discovery, Find By Type Value.
+ */
+static void prim_srvc_disc_serve(conn_t * p_conn, const slave_packet_t * p_packet)
+{
+    bool              uuid128 = (p_packet->uuid.type >= BLE_UUID_TYPE_VENDOR_BEGIN);
+    ble_gattc_evt_t * p_rsp;
+    uint16_t          handle;
+    uint16_t          end;
+
+    for (handle = p_packet->handle; handle <= mp_server->attr_count; handle++)
+    {
+        const sim_gatt_attr_t * p_attr = attr_get(handle);
+
+        if ((p_attr->type == SIM_ATTR_PRIMARY_SERVICE) &&
+            (p_attr->uuid == p_packet->uuid.uuid)      &&
+            (p_attr->uuid128 == uuid128))
+        {
+            break;
+        }
+    }
+
+    if (handle > mp_server->attr_count)
+    {
+        (void)response_alloc(p_conn, BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP, BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND);
+        return;
+    }
+
+    // The group ends before the next service, the last one at the end of the handle space.
+    for (end = handle + 1; (end <= mp_server->attr_count) && (attr_get(end)->type != SIM_ATTR_PRIMARY_SERVICE); end++)
+    {
+    }
+
+    p_rsp = response_alloc(p_conn, BLE_GATTC_EVT_PRIM_SRVC_DISC_RSP, BLE_GATT_STATUS_SUCCESS);
+
+    p_rsp->params.prim_srvc_disc_rsp.count                                = 1;
+    p_rsp->params.prim_srvc_disc_rsp.services[0].uuid                     = p_packet->uuid;
+    p_rsp->params.prim_srvc_disc_rsp.services[0].handle_range.start_handle = handle;
+    p_rsp->params.prim_srvc_disc_rsp.services[0].handle_range.end_handle   = (end > mp_server->attr_count) ? 0xFFFF : (end - 1);
+}
+
+/**@brief Function for answering a characteristic discovery, Read By Type.
+ *
+ * @details A response holds characteristics of one UUID size only, a single one with a 128 bit
+ *          UUID fits the default MTU.
+ */
+static void char_disc_serve(conn_t * p_conn, const slave_packet_t * p_packet)
+{
+    ble_gattc_evt_t * p_rsp = NULL;
+    uint16_t          handle;
+    uint16_t          max   = 0;
+    bool              uuid128 = false;
+
+    if ((p_packet->handle == 0) || (p_packet->handle > p_packet->end_handle))
+    {
+        (void)response_alloc(p_conn, BLE_GATTC_EVT_CHAR_DISC_RSP, BLE_GATT_STATUS_ATTERR_INVALID_HANDLE);
+        return;
+    }
+
+    for (handle = p_packet->handle; (handle <= p_packet->end_handle) && (handle < mp_server->attr_count); handle++)
+    {
+        const sim_gatt_attr_t * p_attr = attr_get(handle);
+        ble_gattc_char_t *      p_char;
+
+        if (p_attr->type != SIM_ATTR_CHAR_DECL)
+        {
+            continue;
+        }
+
+        if (p_rsp == NULL)
+        {
+            p_rsp   = response_alloc(p_conn, BLE_GATTC_EVT_CHAR_DISC_RSP, BLE_GATT_STATUS_SUCCESS);
+            uuid128 = p_attr->uuid128;
+            max     = uuid128 ? 1 : ATT_CHAR_DISC_MAX_16;
+        }
+        else if ((p_attr->uuid128 != uuid128) || (p_rsp->params.char_disc_rsp.count == max))
+        {
+            break;
+        }
+
+        p_char = &p_rsp->params.char_disc_rsp.chars[p_rsp->params.char_disc_rsp.count++];
+
+        p_char->uuid.uuid    = p_attr->uuid;
+        p_char->uuid.type    = uuid128 ? BLE_UUID_TYPE_VENDOR_BEGIN : BLE_UUID_TYPE_BLE;
+        p_char->char_props   = p_attr->props;
+        p_char->handle_decl  = handle;
+        p_char->handle_value = handle + 1;
+    }
+
+    if (p_rsp == NULL)
+    {
+        (void)response_alloc(p_conn, BLE_GATTC_EVT_CHAR_DISC_RSP, BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND);
+    }
+}
+
+/**@brief Function for answering a descriptor discovery, Find Information.
+ *
+ * @details Every attribute in the range is reported, a response holds attributes of one UUID
+ *          size only.
+ */
+static void desc_disc_serve(conn_t * p_conn, const slave_packet_t * p_packet)
+{
+    ble_gattc_evt_t * p_rsp = NULL;
+    uint16_t          handle;
+    uint16_t          max   = 0;
+    bool              first_uuid128 = false;
+
+    if ((p_packet->handle == 0) || (p_packet->handle > p_packet->end_handle))
+    {
+        (void)response_alloc(p_conn, BLE_GATTC_EVT_DESC_DISC_RSP, BLE_GATT_STATUS_ATTERR_INVALID_HANDLE);
+        return;
+    }
+
+    for (handle = p_packet->handle; (handle <= p_packet->end_handle) && (handle <= mp_server->attr_count); handle++)
+    {
+        ble_gattc_desc_t * p_desc;
+        ble_uuid_t         uuid;
+        bool               uuid128;
+
+        attr_uuid_get(attr_get(handle), &uuid, &uuid128);
+
+        if (p_rsp == NULL)
+        {
+            p_rsp         = response_alloc(p_conn, BLE_GATTC_EVT_DESC_DISC_RSP, BLE_GATT_STATUS_SUCCESS);
+            first_uuid128 = uuid128;
+            max           = uuid128 ? 1 : ATT_DESC_DISC_MAX_16;
+        }
+        else if ((uuid128 != first_uuid128) || (p_rsp->params.desc_disc_rsp.count == max))
+        {
+            break;
+        }
+
+        p_desc         = &p_rsp->params.desc_disc_rsp.descs[p_rsp->params.desc_disc_rsp.count++];
+        p_desc->handle = handle;
+        p_desc->uuid   = uuid;
+    }
+
+    if (p_rsp == NULL)
+    {
+        (void)response_alloc(p_conn, BLE_GATTC_EVT_DESC_DISC_RSP, BLE_GATT_STATUS_ATTERR_ATTRIBUTE_NOT_FOUND);
+    }
+}
+
+/**@brief Function for answering a Read or Read Blob Request.
+ */
+static void read_serve(conn_t * p_conn, const slave_packet_t * p_packet)
+{
+    ble_gattc_evt_t * p_rsp = response_alloc(p_conn, BLE_GATTC_EVT_READ_RSP, BLE_GATT_STATUS_SUCCESS);
+    uint16_t          len   = ATT_READ_RSP_MAX_LENGTH;
+
+    p_rsp->params.read_rsp.handle = p_packet->handle;
+    p_rsp->params.read_rsp.offset = p_packet->offset;
+
+    if (attr_get(p_packet->handle) == NULL)
+    {
+        p_rsp->gatt_status = BLE_GATT_STATUS_ATTERR_INVALID_HANDLE;
+        return;
+    }
+
+    p_rsp->gatt_status = mp_server->read(p_conn->conn_handle,
+                                         p_packet->handle,
+                                         p_packet->offset,
+                                         p_rsp->params.read_rsp.data,
+                                         &len);
+    p_rsp->params.read_rsp.len = (p_rsp->gatt_status == BLE_GATT_STATUS_SUCCESS) ? len : 0;
+}
+
+/**@brief Function for handling a Write Request or Command.
+ */
+static void write_serve(conn_t * p_conn, const slave_packet_t * p_packet)
+{
+    uint16_t          status = BLE_GATT_STATUS_ATTERR_INVALID_HANDLE;
+    ble_gattc_evt_t * p_rsp  = NULL;
+
+    // The response goes ahead of the notifications the write causes.
+    if (p_packet->write_op == BLE_GATT_OP_WRITE_REQ)
+    {
+        p_rsp = response_alloc(p_conn, BLE_GATTC_EVT_WRITE_RSP, status);
+
+        p_rsp->params.write_rsp.handle   = p_packet->handle;
+        p_rsp->params.write_rsp.write_op = p_packet->write_op;
+    }
+
+    if (attr_get(p_packet->handle) != NULL)
+    {
+        status = mp_server->write(p_conn->conn_handle, p_packet->handle, p_packet->data, p_packet->len);
+    }
+
+    if (p_rsp != NULL)
+    {
+        p_rsp->gatt_status = status;
+    }
+}
+
+/**@brief Function for handing the packets of the client to the master.
+ *
+ * @details Notifications queued by the server while handling a request follow its response.
+ */
+static void slave_packets_send(conn_t * p_conn)
+{
+    uint8_t  commands = 0;
+    uint32_t i;
+
+    p_conn->hvx_ready_event = p_conn->event_counter + m_params.response_events;
+
+    for (i = 0; i < p_conn->slave_count; i++)
+    {
+        const slave_packet_t * p_packet = &p_conn->slave_queue[i];
+
+        switch (p_packet->type)
+        {
+            case SLAVE_PACKET_PRIM_SRVC_DISC:
+                prim_srvc_disc_serve(p_conn, p_packet);
+                break;
+
+            case SLAVE_PACKET_CHAR_DISC:
+                char_disc_serve(p_conn, p_packet);
+                break;
+
+            case SLAVE_PACKET_DESC_DISC:
+                desc_disc_serve(p_conn, p_packet);
+                break;
+
+            case SLAVE_PACKET_READ:
+                read_serve(p_conn, p_packet);
+                break;
+
+            case SLAVE_PACKET_WRITE:
+                write_serve(p_conn, p_packet);
+                if (p_packet->write_op == BLE_GATT_OP_WRITE_CMD)
+                {
+                    commands++;
+                }
+                break;
+        }
+    }
+    p_conn->slave_count = 0;
+
+    if (commands > 0)
+    {
+        evt_buf_t buf;
+
+        memset(&buf, 0, sizeof(buf));
+        buf.evt.header.evt_id                            = BLE_EVT_TX_COMPLETE;
+        buf.evt.header.evt_len                           = sizeof(ble_common_evt_t);
+        buf.evt.evt.common_evt.conn_handle               = p_conn->conn_handle;
+        buf.evt.evt.common_evt.params.tx_complete.count  = commands;
+
+        *tx_free_get(p_conn) += commands;
+        ble_evt_deliver(&buf.evt);
+    }
+}
+
+/**@brief Function for passing the packets of the master that are due to the client.
+ */
+static void master_packets_send(conn_t * p_conn)
+{
+    uint8_t sent;
+
+    for (sent = 0; (sent < m_params.packets_per_event) && (p_conn->master_count > 0) && p_conn->connected; sent++)
+    {
+        master_packet_t * p_packet = &p_conn->master_queue[p_conn->master_head];
+        evt_buf_t         buf;
+
+        if (p_packet->ready_event > p_conn->event_counter)
+        {
+            break;
+        }
+
+        buf                 = p_packet->buf;
+        p_conn->master_head = (p_conn->master_head + 1) % MASTER_QUEUE_MAX_SIZE;
+        p_conn->master_count--;
+
+        if (buf.evt.header.evt_id == BLE_GATTC_EVT_HVX)
+        {
+            m_stats.notifications++;
+        }
+        else
+        {
+            p_conn->request_pending = false;
+            if (buf.evt.header.evt_id == BLE_GATTC_EVT_WRITE_RSP)
+            {
+                m_stats.write_responses++;
+            }
+        }
+
+        ble_evt_deliver(&buf.evt);
+    }
+}
+
+/**@brief Function for completing the security procedure of a link.
+ *
+ * @details A new master pairs and bonds, the stack reports BLE_GAP_EVT_AUTH_STATUS once the Device
+ *          Manager has stored the bond. A bonded master encrypts with the keys of its bond, which
+ *          the stack asks for with BLE_GAP_EVT_SEC_INFO_REQUEST.
+ */
+static void security_complete(conn_t * p_conn)
+{
+    uint8_t * p_master_bond = &m_master_bonds[p_conn->conn_handle];
+    uint8_t   i;
+
+    p_conn->security_event = 0;
+    p_conn->secured        = true;
+
+    if (*p_master_bond == DM_INVALID_ID)
+    {
+        for (i = 0; (i < DEVICE_MANAGER_MAX_BONDS) && m_bonds[i].bonded; i++)
+        {
+            // Find a free entry.
+        }
+        if (i == DEVICE_MANAGER_MAX_BONDS)
+        {
+            APP_ERROR_HANDLER(NRF_ERROR_NO_MEM);
+        }
+
+        m_bonds[i].bonded           = true;
+        m_bonds[i].context_valid    = false;
+        *p_master_bond              = i;
+        p_conn->dm_handle.device_id = i;
+
+        dm_evt_deliver(p_conn, DM_EVT_SECURITY_SETUP_COMPLETE);
+        dm_evt_deliver(p_conn, DM_EVT_LINK_SECURED);
+        gap_evt_deliver(p_conn, BLE_GAP_EVT_AUTH_STATUS);
+    }
+    else
+    {
+        gap_evt_deliver(p_conn, BLE_GAP_EVT_SEC_INFO_REQUEST);
+        p_conn->dm_handle.device_id = *p_master_bond;
+        dm_evt_deliver(p_conn, DM_EVT_LINK_SECURED);
+    }
+}
+
+/**@brief Function for applying the connection parameters requested by the client.
+ *
+ * @details The master accepts any request and uses the longest acceptable interval.
+ */
+static void conn_params_update_complete(conn_t * p_conn)
+{
+    evt_buf_t buf;
+
+    p_conn->conn_params_event             = 0;
+    p_conn->conn_params                   = p_conn->conn_params_update;
+    p_conn->conn_params.min_conn_interval = p_conn->conn_params.max_conn_interval;
+    p_conn->local_latency_set             = false;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.evt.header.evt_id                                    = BLE_GAP_EVT_CONN_PARAM_UPDATE;
+    buf.evt.header.evt_len                                   = sizeof(ble_gap_evt_t);
+    buf.evt.evt.gap_evt.conn_handle                          = p_conn->conn_handle;
+    buf.evt.evt.gap_evt.params.conn_param_update.conn_params = p_conn->conn_params;
+
+    ble_evt_deliver(&buf.evt);
+}
+
+/**@brief Function for checking whether the slave may skip the current connection event.
+ *
+ * @details The slave listens whenever it has packets to send, and at the latest once it has
+ *          skipped as many events as the local connection latency, or the slave latency if the
+ *          client set none.
+ */
+static bool conn_event_skip(const conn_t * p_conn)
+{
+    uint16_t latency = p_conn->local_latency_set ? p_conn->local_latency
+                                                 : p_conn->conn_params.slave_latency;
+
+    return (p_conn->slave_count == 0) && (p_conn->events_skipped < latency);
+}
+
+/**@brief Function for running one connection event of a link.
+ */
+static void conn_event_process(conn_t * p_conn)
+{
+    bool skip;
+
+    m_now_us = p_conn->next_event_us;
+    p_conn->event_counter++;
+    m_stats.conn_events++;
+
+    // The slave listens at the instant new connection parameters apply.
+    if ((p_conn->conn_params_event != 0) && (p_conn->event_counter >= p_conn->conn_params_event))
+    {
+        conn_params_update_complete(p_conn);
+        skip = false;
+    }
+    else
+    {
+        skip = conn_event_skip(p_conn);
+    }
+    p_conn->next_event_us += (uint64_t)p_conn->conn_params.max_conn_interval * UNIT_1_25_MS;
+
+    if ((p_conn->security_event != 0) && (p_conn->event_counter >= p_conn->security_event))
+    {
+        security_complete(p_conn);
+    }
+
+    if (mp_server->conn_event != NULL)
+    {
+        p_conn->hvx_ready_event = p_conn->event_counter;
+        mp_server->conn_event(p_conn->conn_handle, p_conn->event_counter);
+    }
+
+    if (skip)
+    {
+        // The master's packets wait for the next event the slave listens on.
+        p_conn->events_skipped++;
+        m_stats.conn_events_skipped++;
+    }
+    else
+    {
+        p_conn->events_skipped = 0;
+        slave_packets_send(p_conn);
+        master_packets_send(p_conn);
+    }
+
+    p_conn->hvx_ready_event = p_conn->event_counter + 1;
+}
+
+/**@brief Function for getting the link with the next connection event.
+ */
+static conn_t * conn_next_get(void)
+{
+    conn_t * p_next = NULL;
+    uint32_t i;
+
+    for (i = 0; i < SIM_CONN_COUNT; i++)
+    {
+        if (m_conns[i].connected &&
+            ((p_next == NULL) || (m_conns[i].next_event_us < p_next->next_event_us)))
+        {
+            p_next = &m_conns[i];
+        }
+    }
+    return p_next;
+}
+
+/**@brief Function for getting the running timer expiring first.
+ */
+static sim_timer_t * timer_next_get(void)
+{
+    sim_timer_t * p_next = NULL;
+    uint32_t      i;
+
+    for (i = 0; i < TIMER_COUNT; i++)
+    {
+        if (m_timers[i].running &&
+            ((p_next == NULL) || (m_timers[i].deadline_us < p_next->deadline_us)))
+        {
+            p_next = &m_timers[i];
+        }
+    }
+    return p_next;
+}
+
+/**@brief Function for expiring a timer.
+ */
+static void timer_expire(sim_timer_t * p_timer)
+{
+    m_now_us = p_timer->deadline_us;
+
+    if (p_timer->mode == APP_TIMER_MODE_REPEATED)
+    {
+        p_timer->deadline_us += p_timer->period_us;
+    }
+    else
+    {
+        p_timer->running = false;
+    }
+
+    p_timer->handler(p_timer->p_context);
+}
+
+void sim_init(const sim_link_params_t * p_params,
+              const sim_handlers_t    * p_handlers,
+              const sim_gatt_server_t * p_server)
+{
+    uint16_t i;
+
+    m_params   = *p_params;
+    m_handlers = *p_handlers;
+    mp_server  = p_server;
+
+    if ((m_params.master_queue_size == 0) || (m_params.master_queue_size > MASTER_QUEUE_MAX_SIZE))
+    {
+        m_params.master_queue_size = MASTER_QUEUE_MAX_SIZE;
+    }
+
+    memset(&m_stats, 0, sizeof(m_stats));
+    memset(m_timers, 0, sizeof(m_timers));
+    memset(m_conns, 0, sizeof(m_conns));
+
+    m_now_us       = 0;
+    m_sched_head   = 0;
+    m_sched_count  = 0;
+    m_kick_pending = false;
+    m_tx_pool_free = m_params.tx_buffers;
+
+    for (i = 0; i < SIM_CONN_COUNT; i++)
+    {
+        m_conns[i].conn_handle             = i;
+        m_conns[i].dm_handle.appl_id       = 0;
+        m_conns[i].dm_handle.connection_id = DM_INVALID_ID;
+        m_conns[i].dm_handle.device_id     = DM_INVALID_ID;
+        m_conns[i].dm_handle.service_id    = 0;
+    }
+}
+
+void sim_bonds_clear(void)
+{
+    uint32_t i;
+
+    memset(m_bonds, 0, sizeof(m_bonds));
+    for (i = 0; i < SIM_CONN_COUNT; i++)
+    {
+        m_master_bonds[i] = DM_INVALID_ID;
+    }
+}
+
+void sim_connect(uint16_t conn_handle, bool identified)
+{
+    conn_t *  p_conn;
+    evt_buf_t buf;
+
+    if ((conn_handle >= SIM_CONN_COUNT) || m_conns[conn_handle].connected)
+    {
+        return;
+    }
+    p_conn = &m_conns[conn_handle];
+
+    // The master starts with conn_interval_us, in the 1.25 ms steps of the link layer.
+    memset(&p_conn->conn_params, 0, sizeof(p_conn->conn_params));
+    p_conn->conn_params.min_conn_interval = m_params.conn_interval_us / UNIT_1_25_MS;
+    p_conn->conn_params.max_conn_interval = m_params.conn_interval_us / UNIT_1_25_MS;
+    p_conn->conn_params.conn_sup_timeout  = MSEC_TO_UNITS(4000, UNIT_10_MS);
+
+    p_conn->connected         = true;
+    p_conn->event_counter     = 0;
+    p_conn->next_event_us     = m_now_us + (uint64_t)p_conn->conn_params.max_conn_interval * UNIT_1_25_MS;
+    p_conn->conn_params_event = 0;
+    p_conn->hvx_ready_event   = 1;
+    p_conn->master_head       = 0;
+    p_conn->master_count      = 0;
+    p_conn->slave_count       = 0;
+    p_conn->request_pending   = false;
+    p_conn->tx_free           = m_params.tx_buffers;
+    p_conn->local_latency_set = false;
+    p_conn->events_skipped    = 0;
+    p_conn->secured           = false;
+    p_conn->security_event    = 0;
+
+    mp_server->connect(conn_handle);
+
+    memset(&buf, 0, sizeof(buf));
+    buf.evt.header.evt_id                            = BLE_GAP_EVT_CONNECTED;
+    buf.evt.header.evt_len                           = sizeof(ble_gap_evt_t);
+    buf.evt.evt.gap_evt.conn_handle                  = conn_handle;
+    buf.evt.evt.gap_evt.params.connected.conn_params = p_conn->conn_params;
+
+    p_conn->dm_gap_evt                = buf.evt.evt.gap_evt;
+    p_conn->dm_handle.connection_id   = conn_handle;
+    p_conn->dm_handle.device_id       = identified ? m_master_bonds[conn_handle] : DM_INVALID_ID;
+
+    // The Device Manager sees the stack event first, see ble_evt_dispatch of the application.
+    dm_evt_deliver(p_conn, DM_EVT_CONNECTION);
+    ble_evt_deliver(&buf.evt);
+    context_run();
+
+    if (m_master_bonds[conn_handle] != DM_INVALID_ID)
+    {
+        // A bonded master encrypts the link by itself.
+        p_conn->security_event = MAX(m_params.encrypt_events, 1);
+    }
+}
+
+void sim_disconnect(uint16_t conn_handle)
+{
+    conn_t *  p_conn = conn_get(conn_handle);
+    evt_buf_t buf;
+    uint32_t  i;
+
+    if (p_conn == NULL)
+    {
+        return;
+    }
+
+    // Write commands not sent yet free their buffers without BLE_EVT_TX_COMPLETE.
+    for (i = 0; i < p_conn->slave_count; i++)
+    {
+        if ((p_conn->slave_queue[i].type == SLAVE_PACKET_WRITE) &&
+            (p_conn->slave_queue[i].write_op == BLE_GATT_OP_WRITE_CMD))
+        {
+            (*tx_free_get(p_conn))++;
+        }
+    }
+
+    p_conn->connected         = false;
+    p_conn->security_event    = 0;
+    p_conn->conn_params_event = 0;
+    p_conn->master_count      = 0;
+    p_conn->slave_count       = 0;
+
+    memset(&buf, 0, sizeof(buf));
+    buf.evt.header.evt_id                          = BLE_GAP_EVT_DISCONNECTED;
+    buf.evt.header.evt_len                         = sizeof(ble_gap_evt_t);
+    buf.evt.evt.gap_evt.conn_handle                = conn_handle;
+    buf.evt.evt.gap_evt.params.disconnected.reason = 0x13;
+
+    p_conn->dm_gap_evt = buf.evt.evt.gap_evt;
+    dm_evt_deliver(p_conn, DM_EVT_DISCONNECTION);
+    ble_evt_deliver(&buf.evt);
+    context_run();
+
+    p_conn->dm_handle.connection_id = DM_INVALID_ID;
+    p_conn->dm_handle.device_id     = DM_INVALID_ID;
+}
+
+void sim_run(uint64_t duration_us)
+{
+    uint64_t end = m_now_us + duration_us;
+
+    // Interrupts pended by the caller, e.g. by a remote command, run right away like on the chip.
+    context_run();
+
+    for (;;)
+    {
+        sim_timer_t * p_timer = timer_next_get();
+        conn_t *      p_conn  = conn_next_get();
+
+        if ((p_timer != NULL) &&
+            (p_timer->deadline_us <= end) &&
+            ((p_conn == NULL) || (p_timer->deadline_us <= p_conn->next_event_us)))
+        {
+            timer_expire(p_timer);
+        }
+        else if ((p_conn != NULL) && (p_conn->next_event_us <= end))
+        {
+            conn_event_process(p_conn);
+        }
+        else
+        {
+            break;
+        }
+        context_run();
+    }
+
+    m_now_us = end;
+}
+
+uint32_t sim_hvx_send(uint16_t conn_handle, uint16_t handle, uint8_t type, const uint8_t * p_data, uint16_t len)
+{
+    conn_t *    p_conn = conn_get(conn_handle);
+    ble_evt_t * p_ble_evt;
+
+    if (p_conn == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if (len > ATT_WRITE_MAX_LENGTH)
+    {
+        return NRF_ERROR_DATA_SIZE;
+    }
+
+    p_ble_evt = master_packet_alloc(p_conn, BLE_GATTC_EVT_HVX, p_conn->hvx_ready_event);
+    if (p_ble_evt == NULL)
+    {
+        m_stats.notifications_lost++;
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_ble_evt->evt.gattc_evt.params.hvx.handle = handle;
+    p_ble_evt->evt.gattc_evt.params.hvx.type   = type;
+    p_ble_evt->evt.gattc_evt.params.hvx.len    = len;
+    memcpy(p_ble_evt->evt.gattc_evt.params.hvx.data, p_data, len);
+
+    return NRF_SUCCESS;
+}
+
+const ble_evt_t * sim_ble_evt_get(void)
+{
+    return mp_ble_evt;
+}
+
+uint64_t sim_time_us(void)
+{
+    return m_now_us;
+}
+
+const sim_stats_t * sim_stats_get(void)
+{
+    return &m_stats;
+}
+
+void sim_stats_clear(void)
+{
+    uint16_t local_latency = m_stats.local_latency;
+
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.local_latency = local_latency;
+}
+
+/*****************************************************************************
+* SoftDevice API
+*****************************************************************************/
+
+/**@brief Function for failing a SoftDevice or app_timer call made inside a critical region.
+ *
+ * @details On the chip a call from a critical region either faults (SVC with interrupts
+ *          disabled) or holds off the BLE stack events for as long as it takes.
+ */
+static void critical_region_check(void)
+{
+    if (m_critical_region)
+    {
+        APP_ERROR_HANDLER(NRF_ERROR_INVALID_STATE);
+    }
+}
+
+/**@brief Function for queuing a packet of the client for the next connection event.
+ */
+static uint32_t slave_packet_queue(uint16_t conn_handle, const slave_packet_t * p_packet, bool request)
+{
+    conn_t * p_conn = conn_get(conn_handle);
+
+    critical_region_check();
+
+    if (p_conn == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if ((request && p_conn->request_pending) || (p_conn->slave_count == SLAVE_QUEUE_SIZE))
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    p_conn->slave_queue[p_conn->slave_count++] = *p_packet;
+
+    if (request)
+    {
+        p_conn->request_pending = true;
+        m_stats.requests++;
+    }
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gattc_primary_services_discover(uint16_t conn_handle, uint16_t start_handle, ble_uuid_t const * p_srvc_uuid)
+{
+    slave_packet_t packet;
+
+    memset(&packet, 0, sizeof(packet));
+    packet.type   = SLAVE_PACKET_PRIM_SRVC_DISC;
+    packet.handle = start_handle;
+    packet.uuid   = *p_srvc_uuid;
+
+    return slave_packet_queue(conn_handle, &packet, true);
+}
+
+uint32_t sd_ble_gattc_characteristics_discover(uint16_t conn_handle, ble_gattc_handle_range_t const * p_handle_range)
+{
+    slave_packet_t packet;
+
+    memset(&packet, 0, sizeof(packet));
+    packet.type       = SLAVE_PACKET_CHAR_DISC;
+    packet.handle     = p_handle_range->start_handle;
+    packet.end_handle = p_handle_range->end_handle;
+
+    return slave_packet_queue(conn_handle, &packet, true);
+}
+
+uint32_t sd_ble_gattc_descriptors_discover(uint16_t conn_handle, ble_gattc_handle_range_t const * p_handle_range)
+{
+    slave_packet_t packet;
+
+    memset(&packet, 0, sizeof(packet));
+    packet.type       = SLAVE_PACKET_DESC_DISC;
+    packet.handle     = p_handle_range->start_handle;
+    packet.end_handle = p_handle_range->end_handle;
+
+    return slave_packet_queue(conn_handle, &packet, true);
+}
+
+uint32_t sd_ble_gattc_read(uint16_t conn_handle, uint16_t handle, uint16_t offset)
+{
+    slave_packet_t packet;
+
+    memset(&packet, 0, sizeof(packet));
+    packet.type   = SLAVE_PACKET_READ;
+    packet.handle = handle;
+    packet.offset = offset;
+
+    return slave_packet_queue(conn_handle, &packet, true);
+}
+
+uint32_t sd_ble_gattc_write(uint16_t conn_handle, ble_gattc_write_params_t const * p_write_params)
+{
+    conn_t *       p_conn  = conn_get(conn_handle);
+    slave_packet_t packet;
+    bool           request = (p_write_params->write_op == BLE_GATT_OP_WRITE_REQ);
+    uint32_t       err_code;
+
+    if (p_conn == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if ((p_write_params->len > ATT_WRITE_MAX_LENGTH) ||
+        ((p_write_params->write_op != BLE_GATT_OP_WRITE_REQ) && (p_write_params->write_op != BLE_GATT_OP_WRITE_CMD)))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (!request && (*tx_free_get(p_conn) == 0))
+    {
+        return BLE_ERROR_NO_TX_BUFFERS;
+    }
+
+    memset(&packet, 0, sizeof(packet));
+    packet.type     = SLAVE_PACKET_WRITE;
+    packet.write_op = p_write_params->write_op;
+    packet.handle   = p_write_params->handle;
+    packet.len      = p_write_params->len;
+    memcpy(packet.data, p_write_params->p_value, p_write_params->len);
+
+    err_code = slave_packet_queue(conn_handle, &packet, request);
+    if ((err_code == NRF_SUCCESS) && !request)
+    {
+        (*tx_free_get(p_conn))--;
+        m_stats.write_commands++;
+    }
+    return err_code;
+}
+
+uint32_t sd_ble_gattc_hv_confirm(uint16_t conn_handle, uint16_t handle)
+{
+    UNUSED_PARAMETER(handle);
+    critical_region_check();
+    return (conn_get(conn_handle) != NULL) ? NRF_SUCCESS : BLE_ERROR_INVALID_CONN_HANDLE;
+}
+
+uint32_t sd_ble_tx_buffer_count_get(uint8_t * p_count)
+{
+    *p_count = m_params.tx_buffers;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_opt_set(uint32_t opt_id, ble_opt_t const * p_opt)
+{
+    conn_t * p_conn;
+    uint16_t slave_latency;
+    uint32_t max_events;
+    uint16_t latency;
+
+    critical_region_check();
+    if (opt_id != BLE_GAP_OPT_LOCAL_CONN_LATENCY)
+    {
+        return NRF_ERROR_NOT_SUPPORTED;
+    }
+    p_conn = conn_get(p_opt->gap.local_conn_latency.conn_handle);
+    if (p_conn == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+
+    // Truncated to a multiple of the slave latency that keeps the intervals between two events
+    // the slave listens on within half the supervision timeout.
+    slave_latency = p_conn->conn_params.slave_latency;
+    max_events    = ((uint32_t)p_conn->conn_params.conn_sup_timeout * UNIT_10_MS) /
+                    (2 * (uint32_t)p_conn->conn_params.max_conn_interval * UNIT_1_25_MS);
+    latency       = MIN(p_opt->gap.local_conn_latency.requested_latency, MAX(max_events, 1) - 1);
+    latency       = (slave_latency == 0) ? 0 : latency - (latency % slave_latency);
+
+    p_conn->local_latency_set = true;
+    p_conn->local_latency     = latency;
+    m_stats.local_latency     = latency;
+    if (p_opt->gap.local_conn_latency.p_actual_latency != NULL)
+    {
+        *p_opt->gap.local_conn_latency.p_actual_latency = m_stats.local_latency;
+    }
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_ble_gap_conn_param_update(uint16_t conn_handle, ble_gap_conn_params_t const * p_conn_params)
+{
+    conn_t * p_conn = conn_get(conn_handle);
+
+    critical_region_check();
+
+    if (p_conn == NULL)
+    {
+        return BLE_ERROR_INVALID_CONN_HANDLE;
+    }
+    if ((p_conn_params == NULL) || (p_conn_params->min_conn_interval > p_conn_params->max_conn_interval))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (p_conn->conn_params_event != 0)
+    {
+        return NRF_ERROR_BUSY;
+    }
+
+    p_conn->conn_params_update = *p_conn_params;
+    p_conn->conn_params_event  = p_conn->event_counter + m_params.response_events + CONN_PARAM_UPDATE_EVENTS;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    UNUSED_PARAMETER(IRQn);
+    UNUSED_PARAMETER(priority);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_EnableIRQ(IRQn_Type IRQn)
+{
+    UNUSED_PARAMETER(IRQn);
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_critical_region_enter(uint8_t * p_is_nested_critical_region)
+{
+    // Nothing preempts on the host, interrupts run between events. The region is only tracked
+    // to catch calls that must not be made from it.
+    *p_is_nested_critical_region = m_critical_region ? 1 : 0;
+    m_critical_region            = true;
+    return NRF_SUCCESS;
+}
+
+uint32_t sd_nvic_critical_region_exit(uint8_t is_nested_critical_region)
+{
+    if (is_nested_critical_region == 0)
+    {
+        m_critical_region = false;
+    }
+    return NRF_SUCCESS;
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type IRQn)
+{
+    if (IRQn == SWI3_IRQn)
+    {
+        __atomic_store_n(&m_kick_pending, true, __ATOMIC_SEQ_CST);
+    }
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+    if (IRQn == SWI3_IRQn)
+    {
+        __atomic_store_n(&m_kick_pending, false, __ATOMIC_SEQ_CST);
+    }
+}
+
+/*****************************************************************************
+* Device Manager
+*****************************************************************************/
+
+api_result_t dm_security_setup_req(dm_handle_t * p_handle)
+{
+    conn_t * p_conn = conn_get(p_handle->connection_id);
+
+    // A running procedure or a secured link is left alone, like the pairing of a new master.
+    if ((p_conn != NULL) && !p_conn->secured && (p_conn->security_event == 0))
+    {
+        p_conn->security_event = p_conn->event_counter + MAX(m_params.pairing_events, 1);
+    }
+    return NRF_SUCCESS;
+}
+
+api_result_t dm_application_context_set(dm_handle_t const * p_handle, dm_application_context_t const * p_context)
+{
+    bond_t * p_bond;
+
+    if ((p_handle->device_id >= DEVICE_MANAGER_MAX_BONDS) || !m_bonds[p_handle->device_id].bonded)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (p_context->len > DEVICE_MANAGER_APP_CONTEXT_SIZE)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    p_bond = &m_bonds[p_handle->device_id];
+    memcpy(p_bond->context, p_context->p_data, p_context->len);
+    p_bond->context_valid = true;
+
+    m_stats.flash_bytes_written += p_context->len;
+    return NRF_SUCCESS;
+}
+
+api_result_t dm_application_context_get(dm_handle_t const * p_handle, dm_application_context_t * p_context)
+{
+    bond_t * p_bond;
+
+    if ((p_handle->device_id >= DEVICE_MANAGER_MAX_BONDS) ||
+        !m_bonds[p_handle->device_id].bonded              ||
+        !m_bonds[p_handle->device_id].context_valid)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+
+    p_bond         = &m_bonds[p_handle->device_id];
+    p_context->len = MIN(p_context->len, DEVICE_MANAGER_APP_CONTEXT_SIZE);
+    memcpy(p_context->p_data, p_bond->context, p_context->len);
+
+    return NRF_SUCCESS;
+}
+
+
+/*****************************************************************************
+* app_timer and app_scheduler
+*****************************************************************************/
+
+uint32_t app_timer_create(app_timer_id_t *            p_timer_id,
+                          app_timer_mode_t            mode,
+                          app_timer_timeout_handler_t timeout_handler)
+{
+    uint32_t i;
+
+    for (i = 0; (i < TIMER_COUNT) && m_timers[i].created; i++)
+    {
+        // Find a free timer.
+    }
+    if (i == TIMER_COUNT)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    m_timers[i].created = true;
+    m_timers[i].running = false;
+    m_timers[i].mode    = mode;
+    m_timers[i].handler = timeout_handler;
+
+    *p_timer_id = i;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_start(app_timer_id_t timer_id, uint32_t timeout_ticks, void * p_context)
+{
+    sim_timer_t * p_timer;
+
+    critical_region_check();
+
+    if ((timer_id >= TIMER_COUNT) || !m_timers[timer_id].created)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    // The host build runs app_timer with prescaler 0.
+    p_timer              = &m_timers[timer_id];
+    p_timer->period_us   = ((uint64_t)timeout_ticks * 1000000) / APP_TIMER_CLOCK_FREQ;
+    p_timer->deadline_us = m_now_us + p_timer->period_us;
+    p_timer->p_context   = p_context;
+    p_timer->running     = true;
+
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_stop(app_timer_id_t timer_id)
+{
+    critical_region_check();
+
+    if ((timer_id >= TIMER_COUNT) || !m_timers[timer_id].created)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    m_timers[timer_id].running = false;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_get(uint32_t * p_ticks)
+{
+    *p_ticks = (uint32_t)((m_now_us * APP_TIMER_CLOCK_FREQ) / 1000000) & RTC_COUNTER_MASK;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_timer_cnt_diff_compute(uint32_t ticks_to, uint32_t ticks_from, uint32_t * p_ticks_diff)
+{
+    *p_ticks_diff = (ticks_to - ticks_from) & RTC_COUNTER_MASK;
+    return NRF_SUCCESS;
+}
+
+uint32_t app_sched_event_put(void * p_event_data, uint16_t event_size, app_sched_event_handler_t handler)
+{
+    sched_event_t * p_event;
+
+    if (event_size > SCHED_EVENT_SIZE)
+    {
+        return NRF_ERROR_INVALID_LENGTH;
+    }
+    if (m_sched_count == SCHED_QUEUE_SIZE)
+    {
+        m_stats.sched_queue_full++;
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_event          = &m_sched_queue[(m_sched_head + m_sched_count++) % SCHED_QUEUE_SIZE];
+    p_event->handler = handler;
+    p_event->size    = event_size;
+    memcpy(p_event->data, p_event_data, event_size);
+    m_stats.sched_bytes += event_size;
+
+    return NRF_SUCCESS;
+}
+
+void app_sched_execute(void)
+{
+    while (m_sched_count > 0)
+    {
+        sched_event_t event = m_sched_queue[m_sched_head];
+
+        m_sched_head = (m_sched_head + 1) % SCHED_QUEUE_SIZE;
+        m_sched_count--;
+
+        event.handler(event.data, event.size);
+    }
+}
+
+/*****************************************************************************
+* Connection Parameters module
+*****************************************************************************/
+
+uint32_t ble_conn_params_change_conn_params(ble_gap_conn_params_t * new_params)
+{
+    conn_t * p_conn = conn_get(SIM_CONN_HANDLE);
+
+    // Like the module, which serves a single link, only negotiate if the current interval is not
+    // acceptable.
+    if ((p_conn != NULL) &&
+        (p_conn->conn_params.max_conn_interval >= new_params->min_conn_interval) &&
+        (p_conn->conn_params.max_conn_interval <= new_params->max_conn_interval))
+    {
+        return NRF_SUCCESS;
+    }
+    return sd_ble_gap_conn_param_update(SIM_CONN_HANDLE, new_params);
+}
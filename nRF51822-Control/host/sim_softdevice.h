@@ -0,0 +1,173 @@
+#ifndef SIM_SOFTDEVICE_H__
+#define SIM_SOFTDEVICE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ble.h"
+#include "device_manager.h"
+
+/**@file
+ *
+ * @brief Simulated S110 SoftDevice and Device Manager for running the AMS client on a host.
+ *
+ * @details Time is virtual and advances from one connection event to the next, so a run is
+ *          deterministic and independent of the host speed. In every connection event the
+ *          packets the client queued since the previous event are sent to the GATT server, which
+ *          answers in a later event, and up to packets_per_event packets from the server are
+ *          passed to the client as BLE stack events. The interrupts they pend and the main loop
+ *          run once all events of the connection event have been handled, so deferred work piles
+ *          up like on the chip. Write commands take a stack TX buffer, which BLE_EVT_TX_COMPLETE
+ *          returns at the end of the connection event they are sent in.
+ *          The master accepts every connection parameter update and applies it a few connection
+ *          events later.
+ *
+ *          Without anything to send the slave skips as many connection events as the slave
+ *          latency allows, or the local connection latency once the client has set one. Packets
+ *          of the master wait for the next event the slave listens on. Like on the S110, the
+ *          local latency granted is a multiple of the slave latency within half the supervision
+ *          timeout, and a connection parameter update falls back to the slave latency.
+ *
+ *          Up to SIM_CONN_COUNT masters can be connected at once, master n on connection handle
+ *          n. Each link has its own connection events, queues and bond, they share the GATT
+ *          server table, the timers, the main loop and the counters. The links have TX buffers of
+ *          their own, or take them from one pool if tx_buffers_shared is set.
+ *
+ *          The app_timer, app_scheduler, NVIC, Connection Parameters module, Device Manager
+ *          security request and application context functions are also provided, the
+ *          application contexts stand in for flash and survive @ref sim_init.
+ */
+
+#define SIM_CONN_COUNT                      2                                                 /**< Number of masters that can be connected at once. */
+#define SIM_CONN_HANDLE                     0                                                 /**< Handle of the first master, the one the Connection Parameters module serves. */
+#define SIM_EVT_BUF_SIZE                    128                                               /**< Size of a BLE stack event including its variable length data. */
+
+/**@brief Type of an attribute in the GATT server table. */
+typedef enum
+{
+    SIM_ATTR_PRIMARY_SERVICE,                                                                 /**< Primary service declaration, uuid is the service UUID. */
+    SIM_ATTR_CHAR_DECL,                                                                       /**< Characteristic declaration, uuid and props describe the value that follows. */
+    SIM_ATTR_CHAR_VALUE,                                                                      /**< Characteristic value. */
+    SIM_ATTR_DESCRIPTOR                                                                       /**< Characteristic descriptor, e.g. a CCCD. */
+} sim_attr_type_t;
+
+/**@brief Attribute of the GATT server table, the first entry has handle 1. */
+typedef struct
+{
+    sim_attr_type_t                     type;                                             /**< Type of the attribute. */
+    uint16_t                            uuid;                                             /**< 16 bit UUID, or octets 12-13 of a 128 bit UUID. */
+    bool                                uuid128;                                          /**< Whether uuid is part of a 128 bit UUID. */
+    ble_gatt_char_props_t               props;                                            /**< Properties of the characteristic, for declarations and values. */
+} sim_gatt_attr_t;
+
+/**@brief GATT server on the master side of the link. */
+typedef struct
+{
+    const sim_gatt_attr_t *             p_attrs;                                          /**< Attribute table. */
+    uint16_t                            attr_count;                                       /**< Number of attributes in p_attrs. */
+    void                             (* connect)(uint16_t conn_handle);                   /**< Called on every connection, resets the per connection state. */
+    void                             (* conn_event)(uint16_t conn_handle, uint32_t event_counter); /**< Called at the start of every connection event. May be NULL. */
+    uint16_t                         (* write)(uint16_t conn_handle, uint16_t handle, const uint8_t * p_data, uint16_t len); /**< Handles a write request or command, returns a BLE_GATT_STATUS_* code. */
+    uint16_t                         (* read)(uint16_t conn_handle, uint16_t handle, uint16_t offset, uint8_t * p_data, uint16_t * p_len); /**< Handles a (blob) read, p_len holds the maximum length on entry. Returns a BLE_GATT_STATUS_* code. */
+} sim_gatt_server_t;
+
+/**@brief Event handlers of the application. */
+typedef struct
+{
+    void                             (* ble_evt_handler)(ble_evt_t * p_ble_evt);          /**< BLE stack event dispatch. */
+    void                             (* dm_evt_handler)(dm_handle_t const * p_handle,
+                                                        dm_event_t const  * p_event);     /**< Device Manager event handler. */
+} sim_handlers_t;
+
+/**@brief Link parameters, the same for every master. */
+typedef struct
+{
+    uint32_t                            conn_interval_us;                                 /**< Connection interval the master starts with. */
+    uint8_t                             packets_per_event;                                /**< Number of packets the master sends in one connection event. */
+    uint8_t                             response_events;                                  /**< Number of connection events between a request reaching the master and its response. */
+    uint8_t                             tx_buffers;                                       /**< Number of stack TX buffers for write commands. */
+    bool                                tx_buffers_shared;                                /**< Whether all links take their write commands from one pool of tx_buffers, like on a multi-link SoftDevice, instead of tx_buffers each. */
+    uint8_t                             encrypt_events;                                   /**< Number of connection events until a bonded master has encrypted the link. */
+    uint8_t                             pairing_events;                                   /**< Number of connection events to pair with a new master once requested. */
+    uint16_t                            master_queue_size;                                /**< Number of packets the master can hold for sending, further notifications are lost. */
+} sim_link_params_t;
+
+/**@brief Counters of the simulation over all links, reset by @ref sim_init. */
+typedef struct
+{
+    uint32_t                            conn_events;                                      /**< Number of connection events. */
+    uint32_t                            conn_events_skipped;                              /**< Number of connection events the slave did not listen on, because of slave or local latency. */
+    uint32_t                            requests;                                         /**< Number of ATT requests sent by the client, i.e. GATT round-trips. */
+    uint32_t                            write_commands;                                   /**< Number of write commands sent by the client. */
+    uint32_t                            write_responses;                                  /**< Number of write responses passed to the client. */
+    uint32_t                            notifications;                                    /**< Number of notifications passed to the client. */
+    uint32_t                            notifications_lost;                               /**< Number of notifications lost because the master queue was full. */
+    uint32_t                            flash_bytes_written;                              /**< Number of application context bytes written to flash. */
+    uint32_t                            sched_queue_full;                                 /**< Number of app_scheduler events refused because the queue was full. */
+    uint32_t                            sched_bytes;                                      /**< Number of bytes copied into the app_scheduler queue. */
+    uint16_t                            local_latency;                                    /**< Local connection latency last granted to the client. */
+    uint32_t                            ble_events;                                       /**< Number of BLE stack events passed to the application. */
+    uint64_t                            ble_evt_cpu_ns;                                   /**< Host time spent in the BLE stack event handler. */
+    uint64_t                            ble_evt_cpu_ns_max;                               /**< Longest BLE stack event handler call. */
+    uint64_t                            main_loop_cpu_ns;                                 /**< Host time spent in interrupts pended by the events and in the main loop. */
+    uint64_t                            main_loop_cpu_ns_max;                             /**< Longest main loop run. */
+} sim_stats_t;
+
+/**@brief Function for resetting the simulation. Bonds and their application contexts are kept.
+ *
+ * @param[in]   p_params    Link parameters.
+ * @param[in]   p_handlers  Event handlers of the application.
+ * @param[in]   p_server    GATT server of the master.
+ */
+void sim_init(const sim_link_params_t * p_params,
+              const sim_handlers_t    * p_handlers,
+              const sim_gatt_server_t * p_server);
+
+/**@brief Function for deleting all bonds and their application contexts. */
+void sim_bonds_clear(void);
+
+/**@brief Function for connecting a master.
+ *
+ * @details A bonded master encrypts the link after encrypt_events. It is identified on
+ *          DM_EVT_CONNECTION if identified is set, otherwise only once the link is encrypted,
+ *          like a master using a resolvable private address.
+ *
+ * @param[in]   conn_handle Connection of the master, below SIM_CONN_COUNT.
+ * @param[in]   identified  Whether the bond is known when the connection is established.
+ */
+void sim_connect(uint16_t conn_handle, bool identified);
+
+/**@brief Function for disconnecting a master.
+ *
+ * @param[in]   conn_handle Connection of the master.
+ */
+void sim_disconnect(uint16_t conn_handle);
+
+/**@brief Function for running the simulation.
+ *
+ * @param[in]   duration_us Virtual time to run for.
+ */
+void sim_run(uint64_t duration_us);
+
+/**@brief Function for queuing a notification or indication from a master.
+ *
+ * @return NRF_SUCCESS, NRF_ERROR_NO_MEM if the master queue is full, or
+ *         BLE_ERROR_INVALID_CONN_HANDLE if the master is not connected.
+ */
+uint32_t sim_hvx_send(uint16_t conn_handle, uint16_t handle, uint8_t type, const uint8_t * p_data, uint16_t len);
+
+/**@brief Function for getting the BLE stack event being passed to the application.
+ *
+ * @return The event, or NULL outside of the BLE stack event handler.
+ */
+const ble_evt_t * sim_ble_evt_get(void);
+
+/**@brief Function for getting the virtual time in microseconds. */
+uint64_t sim_time_us(void);
+
+/**@brief Function for getting the counters of the simulation. */
+const sim_stats_t * sim_stats_get(void);
+
+/**@brief Function for resetting the counters of the simulation, e.g. to start a measurement. */
+void sim_stats_clear(void);
+
+#endif // SIM_SOFTDEVICE_H__
@@ -0,0 +1,26 @@
+#ifndef SIM_TEST_H__
+#define SIM_TEST_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/**@file
+ *
+ * @brief Checks for the host tests.
+ *
+ * @details A test is a program exiting with EXIT_SUCCESS once every check has passed. A failed
+ *          check reports its location and ends the test.
+ */
+
+/**@brief Macro for checking a condition of a test. */
+#define CHECK(COND)                                                                       \
+    do                                                                                    \
+    {                                                                                     \
+        if (!(COND))                                                                      \
+        {                                                                                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #COND);      \
+            exit(EXIT_FAILURE);                                                           \
+        }                                                                                 \
+    } while (0)
+
+#endif // SIM_TEST_H__
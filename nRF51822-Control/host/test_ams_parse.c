@@ -0,0 +1,140 @@
+/**@file
+ *
+ * @brief Test of the integer only decimal parsers.
+ *
+ * @details Covers the values AMS sends, signs, fields without a fraction or without an integer
+ *          part, empty and missing fields, the int32_t range in thousandths and characters that
+ *          are not part of a decimal number.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "nrf_error.h"
+#include "ams_parse.h"
+#include "sim_test.h"
+
+/**@brief Function for parsing a whole NUL terminated string as one field.
+ */
+static uint32_t milli_parse(const char * p_text, int32_t * p_milli)
+{
+    return ams_parse_milli((const uint8_t *)p_text, strlen(p_text), AMS_PARSE_SEPARATOR_NONE, p_milli, NULL);
+}
+
+/**@brief Function for checking that a string parses to a value.
+ */
+static bool milli_is(const char * p_text, int32_t expected)
+{
+    int32_t milli = expected + 1;
+
+    return (milli_parse(p_text, &milli) == NRF_SUCCESS) && (milli == expected);
+}
+
+/**@brief Function for checking the error a string is refused with, and that the output is untouched.
+ */
+static bool milli_fails(const char * p_text, uint32_t expected)
+{
+    int32_t milli = 12345;
+
+    return (milli_parse(p_text, &milli) == expected) && (milli == 12345);
+}
+
+static uint32_t list_parse(const char * p_text, int32_t * p_values, uint8_t count)
+{
+    return ams_parse_milli_list((const uint8_t *)p_text, strlen(p_text), ',', p_values, count);
+}
+
+static uint32_t permille_parse(const char * p_text, uint16_t * p_permille)
+{
+    return ams_parse_permille((const uint8_t *)p_text, strlen(p_text), p_permille);
+}
+
+int main(void)
+{
+    int32_t  values[3];
+    int32_t  milli;
+    uint16_t consumed;
+    uint16_t permille;
+
+    // Values as sent by AMS, digits past the third decimal are truncated.
+    CHECK(milli_is("201.990", 201990));
+    CHECK(milli_is("16.127", 16127));
+    CHECK(milli_is("0.5957915", 595));
+    CHECK(milli_is("0.9999", 999));
+    CHECK(milli_is("823", 823000));
+
+    // Sign.
+    CHECK(milli_is("-1.5", -1500));
+    CHECK(milli_is("-0.001", -1));
+    CHECK(milli_is("-0", 0));
+    CHECK(milli_fails("-", NRF_ERROR_INVALID_DATA));
+    CHECK(milli_fails("--1", NRF_ERROR_INVALID_DATA));
+    CHECK(milli_fails("+1", NRF_ERROR_INVALID_DATA));
+    CHECK(milli_fails("1-", NRF_ERROR_INVALID_DATA));
+
+    // Missing fraction or integer part.
+    CHECK(milli_is("7", 7000));
+    CHECK(milli_is("7.", 7000));
+    CHECK(milli_is(".5", 500));
+    CHECK(milli_is("-.25", -250));
+    CHECK(milli_fails(".", NRF_ERROR_INVALID_DATA));
+    CHECK(milli_fails("-.", NRF_ERROR_INVALID_DATA));
+
+    // Empty field.
+    CHECK(milli_fails("", NRF_ERROR_INVALID_DATA));
+    CHECK(ams_parse_milli((const uint8_t *)",1", 2, ',', &milli, NULL) == NRF_ERROR_INVALID_DATA);
+
+    // The int32_t range in thousandths, and fields of up to AMS_PARSE_FIELD_MAX_LENGTH characters.
+    CHECK(milli_is("2147483.647", INT32_MAX));
+    CHECK(milli_is("-2147483.647", -INT32_MAX));
+    CHECK(milli_is("2147483.6479", INT32_MAX));
+    CHECK(milli_is("2147480", 2147480000));
+    CHECK(milli_fails("2147483.648", NRF_ERROR_DATA_SIZE));
+    CHECK(milli_fails("2147484", NRF_ERROR_DATA_SIZE));
+    CHECK(milli_fails("21474836", NRF_ERROR_DATA_SIZE));
+    CHECK(milli_fails("99999999999999999999", NRF_ERROR_DATA_SIZE));
+    CHECK(milli_is("0.0000000000000000000001", 0));
+    CHECK(milli_fails("0.00000000000000000000001", NRF_ERROR_DATA_SIZE));
+
+    // Characters that are not part of a decimal number.
+    CHECK(milli_fails("1a", NRF_ERROR_INVALID_DATA));
+    CHECK(milli_fails("1.2.3", NRF_ERROR_INVALID_DATA));
+    CHECK(milli_fails(" 1", NRF_ERROR_INVALID_DATA));
+    CHECK(milli_fails("1 ", NRF_ERROR_INVALID_DATA));
+    CHECK(milli_fails("1e3", NRF_ERROR_INVALID_DATA));
+    CHECK(milli_fails("0x10", NRF_ERROR_INVALID_DATA));
+    CHECK(milli_fails("1,5", NRF_ERROR_INVALID_DATA));
+
+    // A field ends at the separator, which is consumed with it.
+    CHECK(ams_parse_milli((const uint8_t *)"1,1.0,16.127", 12, ',', &milli, &consumed) == NRF_SUCCESS);
+    CHECK((milli == 1000) && (consumed == 2));
+    CHECK(ams_parse_milli((const uint8_t *)"16.127", 6, ',', &milli, &consumed) == NRF_SUCCESS);
+    CHECK((milli == 16127) && (consumed == 6));
+
+    // Player/PlaybackInfo, fields after the count are ignored.
+    CHECK(list_parse("1,1.0,16.127", values, 3) == NRF_SUCCESS);
+    CHECK((values[0] == 1000) && (values[1] == 1000) && (values[2] == 16127));
+    CHECK(list_parse("0,0.0,0.0,9", values, 3) == NRF_SUCCESS);
+    CHECK((values[0] == 0) && (values[1] == 0) && (values[2] == 0));
+    CHECK(list_parse("3,-2.0,1.5", values, 3) == NRF_SUCCESS);
+    CHECK((values[0] == 3000) && (values[1] == -2000) && (values[2] == 1500));
+    CHECK(list_parse("1,1.0", values, 3) == NRF_ERROR_INVALID_DATA);
+    CHECK(list_parse("1,1.0,", values, 3) == NRF_ERROR_INVALID_DATA);
+    CHECK(list_parse("1,,16.127", values, 3) == NRF_ERROR_INVALID_DATA);
+    CHECK(list_parse("", values, 3) == NRF_ERROR_INVALID_DATA);
+    CHECK(list_parse("1,1.0,x", values, 3) == NRF_ERROR_INVALID_DATA);
+    CHECK(list_parse("1,9999999,0", values, 3) == NRF_ERROR_DATA_SIZE);
+
+    // Player/Volume.
+    CHECK((permille_parse("0.5957915", &permille) == NRF_SUCCESS) && (permille == 595));
+    CHECK((permille_parse("0", &permille) == NRF_SUCCESS) && (permille == 0));
+    CHECK((permille_parse("1", &permille) == NRF_SUCCESS) && (permille == 1000));
+    CHECK((permille_parse("1.0001", &permille) == NRF_SUCCESS) && (permille == 1000));
+    CHECK(permille_parse("1.001", &permille) == NRF_ERROR_INVALID_DATA);
+    CHECK(permille_parse("-0.001", &permille) == NRF_ERROR_INVALID_DATA);
+    CHECK(permille_parse("", &permille) == NRF_ERROR_INVALID_DATA);
+    CHECK(permille_parse("99999999", &permille) == NRF_ERROR_DATA_SIZE);
+
+    printf("test_ams_parse: passed\n");
+    return EXIT_SUCCESS;
+}
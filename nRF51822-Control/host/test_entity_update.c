@@ -0,0 +1,211 @@
+/**@file
+ *
+ * @brief Test of the Entity Update decoder on the samples of the Protocol file.
+ *
+ * @details Two clients receive the same notifications, the first decodes them in the BLE stack
+ *          event context, the second defers them through app_scheduler like ams_app. The first
+ *          must hand out values pointing into the stack event, so no byte is copied. The second
+ *          must copy each notification once, only its received bytes, into the scheduler queue.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+#include "nrf_error.h"
+#include "ble_ams_c.h"
+#include "sim_softdevice.h"
+#include "sim_ams_server.h"
+#include "sim_app.h"
+#include "sim_test.h"
+
+#define SETTLE_TIME_US                      2000000                                           /**< Time for discovery. */
+#define IMMEDIATE                           0                                                 /**< Client decoding in the BLE stack event context. */
+#define DEFERRED                            1                                                 /**< Client decoding from app_scheduler. */
+#define HVX_OVERHEAD                        offsetof(ble_ams_c_hvx_evt_t, data)               /**< Bytes of a deferred notification besides its value. */
+
+/**@brief Entity Update notification and the event it is to be decoded into. */
+typedef struct
+{
+    uint8_t                             entity_id;
+    uint8_t                             attribute_id;
+    uint8_t                             flags;
+    const char *                        p_value;
+} sample_t;
+
+/**@brief Client under test and what it handed to the application. */
+typedef struct
+{
+    ble_ams_c_t                         ams;
+    uint32_t                            updates;                                          /**< Number of Entity Update events. */
+    uint32_t                            bytes_copied;                                     /**< Number of value bytes not pointing into the stack event. */
+    bool                                match;                                            /**< Whether the last event matched m_p_sample. */
+} client_t;
+
+static const sample_t m_samples[] =
+{
+    { BLE_AMS_ENTITY_ID_PLAYER, BLE_AMS_PLAYER_ATTRIBUTE_ID_NAME,          0, "Music" },
+    { BLE_AMS_ENTITY_ID_PLAYER, BLE_AMS_PLAYER_ATTRIBUTE_ID_PLAYBACK_INFO, 0, "1,1.0,16.127" },
+    { BLE_AMS_ENTITY_ID_PLAYER, BLE_AMS_PLAYER_ATTRIBUTE_ID_VOLUME,        0, "0.5957915" },
+    { BLE_AMS_ENTITY_ID_QUEUE,  BLE_AMS_QUEUE_ATTRIBUTE_ID_INDEX,          0, "1" },
+    { BLE_AMS_ENTITY_ID_QUEUE,  BLE_AMS_QUEUE_ATTRIBUTE_ID_COUNT,          0, "823" },
+    { BLE_AMS_ENTITY_ID_QUEUE,  BLE_AMS_QUEUE_ATTRIBUTE_ID_SHUFFLE_MODE,   0, "2" },
+    { BLE_AMS_ENTITY_ID_QUEUE,  BLE_AMS_QUEUE_ATTRIBUTE_ID_REPEAT_MODE,    0, "0" },
+    { BLE_AMS_ENTITY_ID_TRACK,  BLE_AMS_TRACK_ATTRIBUTE_ID_ARTIST,         0, "Nickel Creek" },
+    { BLE_AMS_ENTITY_ID_TRACK,  BLE_AMS_TRACK_ATTRIBUTE_ID_ALBUM,
+      BLE_AMS_ENTITY_UPDATE_FLAG_TRUNCATED, "Reason's Why (The" },
+    { BLE_AMS_ENTITY_ID_TRACK,  BLE_AMS_TRACK_ATTRIBUTE_ID_TITLE,
+      BLE_AMS_ENTITY_UPDATE_FLAG_TRUNCATED, "Jealous of the Mo" },
+    { BLE_AMS_ENTITY_ID_TRACK,  BLE_AMS_TRACK_ATTRIBUTE_ID_DURATION,       0, "201.990" },
+};
+
+static client_t                         m_clients[SIM_CONN_COUNT];
+static const sample_t *                 m_p_sample;                                       /**< Sample last notified. */
+
+/**@brief Function for checking that a value lies within the notification of the stack event
+ *        being dispatched.
+ */
+static bool value_in_ble_evt(const uint8_t * p_value, uint16_t len)
+{
+    const ble_evt_t * p_ble_evt = sim_ble_evt_get();
+    const uint8_t *   p_data;
+
+    if (p_ble_evt == NULL)
+    {
+        return false;
+    }
+    p_data = p_ble_evt->evt.gattc_evt.params.hvx.data;
+    return (p_value >= p_data) && (p_value + len <= p_data + p_ble_evt->evt.gattc_evt.params.hvx.len);
+}
+
+static void evt_handle(client_t * p_client, const ble_ams_c_evt_t * p_evt)
+{
+    const ble_ams_c_evt_entity_update_t * p_update = &p_evt->data.entity_update;
+
+    switch (p_evt->evt_type)
+    {
+        case BLE_AMS_C_EVT_PLAYER_UPDATE:
+        case BLE_AMS_C_EVT_QUEUE_UPDATE:
+        case BLE_AMS_C_EVT_TRACK_UPDATE:
+            p_client->updates++;
+            p_client->match = (m_p_sample != NULL) &&
+                              (p_update->entity_id == m_p_sample->entity_id) &&
+                              (p_update->attribute_id == m_p_sample->attribute_id) &&
+                              (p_update->entity_update_flags == m_p_sample->flags) &&
+                              (p_update->value_len == strlen(m_p_sample->p_value)) &&
+                              (memcmp(p_update->p_value, m_p_sample->p_value, p_update->value_len) == 0);
+            if (!value_in_ble_evt(p_update->p_value, p_update->value_len))
+            {
+                p_client->bytes_copied += p_update->value_len;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+static void immediate_evt_handler(ble_ams_c_evt_t * p_evt)
+{
+    evt_handle(&m_clients[IMMEDIATE], p_evt);
+}
+
+static void deferred_evt_handler(ble_ams_c_evt_t * p_evt)
+{
+    evt_handle(&m_clients[DEFERRED], p_evt);
+}
+
+/**@brief Function for building the Entity Update notification of a sample.
+ */
+static uint16_t sample_encode(const sample_t * p_sample, uint8_t * p_data)
+{
+    uint16_t len = strlen(p_sample->p_value);
+
+    p_data[0] = p_sample->entity_id;
+    p_data[1] = p_sample->attribute_id;
+    p_data[2] = p_sample->flags;
+    memcpy(&p_data[3], p_sample->p_value, len);
+
+    return len + 3;
+}
+
+int main(void)
+{
+    static const ble_ams_c_evt_handler_t evt_handlers[SIM_CONN_COUNT] =
+    {
+        immediate_evt_handler,
+        deferred_evt_handler,
+    };
+    static ble_ams_c_t * const clients[SIM_CONN_COUNT] =
+    {
+        &m_clients[IMMEDIATE].ams,
+        &m_clients[DEFERRED].ams,
+    };
+    sim_link_params_t params;
+    uint32_t          i;
+    uint32_t          s;
+
+    sim_app_params_default(&params);
+
+    sim_bonds_clear();
+    sim_ams_server_init();
+    sim_app_clients_init(&params, sim_ams_server_get(), clients, SIM_CONN_COUNT);
+
+    for (i = 0; i < SIM_CONN_COUNT; i++)
+    {
+        ble_ams_c_init_t init;
+
+        memset(&init, 0, sizeof(init));
+        init.evt_handler   = evt_handlers[i];
+        init.error_handler = sim_app_error_handler;
+        init.tx_policy     = BLE_AMS_C_TX_POLICY_REJECT;
+        init.hvx_deferred  = (i == DEFERRED);
+
+        CHECK(ble_ams_c_init(&m_clients[i].ams, &init) == NRF_SUCCESS);
+        sim_connect(i, true);
+    }
+
+    // Nothing is subscribed to, the server notifies nothing on its own.
+    sim_run(SETTLE_TIME_US);
+    for (i = 0; i < SIM_CONN_COUNT; i++)
+    {
+        CHECK(m_clients[i].ams.client_state == BLE_AMS_C_STATE_RUNNING);
+    }
+
+    for (s = 0; s < sizeof(m_samples) / sizeof(m_samples[0]); s++)
+    {
+        uint8_t  data[BLE_AMS_C_HVX_DATA_MAX];
+        uint16_t len;
+        uint32_t sched_bytes;
+
+        CHECK(strlen(m_samples[s].p_value) + 3 <= sizeof(data));
+        len        = sample_encode(&m_samples[s], data);
+        m_p_sample = &m_samples[s];
+
+        for (i = 0; i < SIM_CONN_COUNT; i++)
+        {
+            m_clients[i].match = false;
+            CHECK(sim_hvx_send(i, m_clients[i].ams.service.entity_update_handle,
+                               BLE_GATT_HVX_NOTIFICATION, data, len) == NRF_SUCCESS);
+        }
+
+        sched_bytes = sim_stats_get()->sched_bytes;
+        sim_run(2 * params.conn_interval_us);
+
+        // One notification copied once into the scheduler queue, by the deferring client.
+        CHECK(sim_stats_get()->sched_bytes - sched_bytes == HVX_OVERHEAD + len);
+        for (i = 0; i < SIM_CONN_COUNT; i++)
+        {
+            CHECK(m_clients[i].updates == s + 1);
+            CHECK(m_clients[i].match);
+        }
+        CHECK(m_clients[IMMEDIATE].bytes_copied == 0);
+    }
+
+    for (i = 0; i < SIM_CONN_COUNT; i++)
+    {
+        sim_disconnect(i);
+    }
+    printf("test_entity_update: passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,99 @@
+/**@file
+ *
+ * @brief Test of the round-trips ams_app spends reading a truncated title through Entity
+ *        Attribute.
+ *
+ * @details The Entity Attribute write is one round-trip, each full Read or Read Blob Response
+ *          asks for another read, and the read ends on the first short response. A title of
+ *          len bytes thus takes 2 + len / 22 round-trips with the default MTU.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "ble_ams_c.h"
+#include "sim_softdevice.h"
+#include "sim_ams_server.h"
+#include "sim_app.h"
+#include "sim_test.h"
+
+#define SETTLE_TIME_US                      2000000                                           /**< Time for discovery, pairing and subscription. */
+#define READ_TIME_US                        1000000                                           /**< Time for a long read. */
+#define READ_RSP_MAX_LENGTH                 (GATT_MTU_SIZE_DEFAULT - 1)                       /**< Value bytes in a full Read or Read Blob Response. */
+#define ENTITY_UPDATE_HEADER_LENGTH         3                                                 /**< Entity ID, Attribute ID and Entity Update flags. */
+#define ENTITY_UPDATE_VALUE_MAX             (GATT_MTU_SIZE_DEFAULT - 3 - ENTITY_UPDATE_HEADER_LENGTH) /**< Longest value fitting an Entity Update notification. */
+
+static bool                             m_discovered;                                     /**< Whether AMS has been discovered. */
+static uint32_t                         m_reads;                                          /**< Number of BLE_AMS_C_EVT_ENTITY_ATTRIBUTE_READ events. */
+static uint32_t                         m_read_requests;                                  /**< GATT round-trips of the simulation at the last read. */
+static uint8_t                          m_round_trips;                                    /**< Round-trips reported by the last read. */
+static char                             m_value[SIM_AMS_SERVER_VALUE_MAX];                /**< Value of the last read, NUL terminated. */
+
+static void on_ams_c_evt(ble_ams_c_evt_t * p_evt)
+{
+    const ble_ams_c_evt_entity_attribute_t * p_attr = &p_evt->data.entity_attribute;
+
+    if (p_evt->evt_type == BLE_AMS_C_EVT_DISCOVER_COMPLETE)
+    {
+        m_discovered = true;
+    }
+    if ((p_evt->evt_type != BLE_AMS_C_EVT_ENTITY_ATTRIBUTE_READ) ||
+        (p_attr->entity_id != BLE_AMS_ENTITY_ID_TRACK) ||
+        (p_attr->attribute_id != BLE_AMS_TRACK_ATTRIBUTE_ID_TITLE))
+    {
+        return;
+    }
+
+    CHECK(!p_attr->truncated);
+    CHECK(p_attr->value_len < sizeof(m_value));
+    memcpy(m_value, p_attr->p_value, p_attr->value_len);
+    m_value[p_attr->value_len] = '\0';
+
+    m_reads++;
+    m_read_requests = sim_stats_get()->requests;
+    m_round_trips   = p_attr->round_trips;
+}
+
+int main(void)
+{
+    static const char * const titles[] =
+    {
+        "Jealous of the Moon",                                                      // 19 bytes, one short read.
+        "The Hand Song (Live at the Ryman Auditorium)",                             // 44 bytes, the last read is empty.
+        "Reasons Why (Live from the Fox Theatre, Oakland, December 2003)",          // 63 bytes.
+    };
+    sim_link_params_t params;
+    uint32_t          i;
+
+    sim_app_params_default(&params);
+
+    sim_bonds_clear();
+    sim_app_init(&params, sim_ams_server_get(), on_ams_c_evt);
+    sim_ams_server_init();
+
+    sim_connect(SIM_CONN_HANDLE, true);
+    sim_run(SETTLE_TIME_US);
+    CHECK(m_discovered);
+
+    for (i = 0; i < sizeof(titles) / sizeof(titles[0]); i++)
+    {
+        uint32_t len      = strlen(titles[i]);
+        uint32_t expected = 2 + len / READ_RSP_MAX_LENGTH;
+        uint32_t reads    = m_reads;
+        uint32_t requests = sim_stats_get()->requests;
+
+        CHECK((len > ENTITY_UPDATE_VALUE_MAX) && (len < SIM_AMS_SERVER_VALUE_MAX));
+        // The application is subscribed to the title, the server notifies it truncated.
+        sim_ams_server_attr_set(BLE_AMS_ENTITY_ID_TRACK, BLE_AMS_TRACK_ATTRIBUTE_ID_TITLE, titles[i]);
+        sim_run(READ_TIME_US);
+
+        CHECK(m_reads == reads + 1);
+        CHECK(strcmp(m_value, titles[i]) == 0);
+        CHECK(m_round_trips == expected);
+        CHECK(m_read_requests - requests == expected);
+    }
+
+    sim_disconnect(SIM_CONN_HANDLE);
+    printf("test_long_read: passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+/**@file
+ *
+ * @brief Test of two AMS clients serving two masters at once.
+ *
+ * @details Both masters allow remote commands to be written without response, and the links take
+ *          their stack TX buffers from one pool like on a multi-link SoftDevice. A burst of
+ *          commands on the first link drains the pool while a command waits on the second link.
+ *          The buffers the first link gets back must serve the waiting command first, every
+ *          command of the burst must arrive, and the buffers of a link closed with commands in
+ *          flight must serve the other link.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "nrf_error.h"
+#include "app_error.h"
+#include "ble_ams_c.h"
+#include "sim_softdevice.h"
+#include "sim_ams_server.h"
+#include "sim_app.h"
+#include "sim_test.h"
+
+#define SETTLE_TIME_US                      2000000                                           /**< Time for discovery and the Remote Command notification. */
+#define TX_BUFFERS                          2                                                 /**< Stack TX buffers of both links, fewer than the burst. */
+#define BURST_LENGTH                        BLE_AMS_C_CMD_QUEUE_SIZE                          /**< Remote commands sent on the first link at once. */
+
+static ble_ams_c_t                      m_ams_c[SIM_CONN_COUNT];
+
+static void evt_handle(ble_ams_c_t * p_ams, const ble_ams_c_evt_t * p_evt)
+{
+    if (p_evt->evt_type == BLE_AMS_C_EVT_DISCOVER_COMPLETE)
+    {
+        APP_ERROR_CHECK(ble_ams_c_enable_notif_remote_control(p_ams));
+    }
+}
+
+static void first_evt_handler(ble_ams_c_evt_t * p_evt)
+{
+    evt_handle(&m_ams_c[0], p_evt);
+}
+
+static void second_evt_handler(ble_ams_c_evt_t * p_evt)
+{
+    evt_handle(&m_ams_c[1], p_evt);
+}
+
+/**@brief Function for getting the number of messages waiting in the TX queue of a client.
+ */
+static uint32_t tx_queued_get(const ble_ams_c_t * p_ams)
+{
+    return p_ams->tx_insert_index - p_ams->tx_index;
+}
+
+/**@brief Function for sending a burst of remote commands on the first link, the command ring
+ *        taking what the TX queue cannot.
+ */
+static void burst_send(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < BURST_LENGTH; i++)
+    {
+        CHECK(ble_ams_send_rc_command(&m_ams_c[0], BLE_AMS_REMOTE_COMMAND_NEXT_TRACK) == NRF_SUCCESS);
+    }
+}
+
+int main(void)
+{
+    static const ble_ams_c_evt_handler_t evt_handlers[SIM_CONN_COUNT] =
+    {
+        first_evt_handler,
+        second_evt_handler,
+    };
+    static ble_ams_c_t * const clients[SIM_CONN_COUNT] =
+    {
+        &m_ams_c[0],
+        &m_ams_c[1],
+    };
+    sim_link_params_t params;
+    uint32_t          commands;
+    uint32_t          i;
+
+    sim_app_params_default(&params);
+    params.tx_buffers        = TX_BUFFERS;
+    params.tx_buffers_shared = true;
+
+    sim_bonds_clear();
+    sim_ams_server_init();
+    sim_ams_server_rc_write_cmd_set(true);
+    sim_app_clients_init(&params, sim_ams_server_get(), clients, SIM_CONN_COUNT);
+
+    for (i = 0; i < SIM_CONN_COUNT; i++)
+    {
+        ble_ams_c_init_t init;
+
+        memset(&init, 0, sizeof(init));
+        init.evt_handler   = evt_handlers[i];
+        init.error_handler = sim_app_error_handler;
+        init.tx_policy     = BLE_AMS_C_TX_POLICY_REJECT;
+
+        CHECK(ble_ams_c_init(&m_ams_c[i], &init) == NRF_SUCCESS);
+    }
+
+    // Each master is served by its own client.
+    for (i = 0; i < SIM_CONN_COUNT; i++)
+    {
+        sim_connect(i, true);
+        CHECK(m_ams_c[i].conn_handle == i);
+    }
+
+    sim_run(SETTLE_TIME_US);
+    for (i = 0; i < SIM_CONN_COUNT; i++)
+    {
+        CHECK(m_ams_c[i].client_state == BLE_AMS_C_STATE_RUNNING);
+        CHECK(m_ams_c[i].supported_commands != BLE_AMS_SUPPORTED_COMMANDS_UNKNOWN);
+        CHECK(tx_queued_get(&m_ams_c[i]) == 0);
+    }
+
+    // The burst takes every buffer, the command on the second link has to wait for one. The
+    // kick interrupt moves the commands into the TX queues when the simulation runs.
+    burst_send();
+    CHECK(ble_ams_send_rc_command(&m_ams_c[1], BLE_AMS_REMOTE_COMMAND_PAUSE) == NRF_SUCCESS);
+    sim_run(0);
+    CHECK(m_ams_c[0].tx_buffers_used == TX_BUFFERS);
+    CHECK(tx_queued_get(&m_ams_c[1]) == 1);
+
+    // The buffers the first link gets back go to the second link before the burst goes on.
+    sim_run(2 * params.conn_interval_us);
+    CHECK(tx_queued_get(&m_ams_c[0]) > 0);
+    CHECK(tx_queued_get(&m_ams_c[1]) == 0);
+
+    // The burst drains at the pace of the first link, nothing is lost.
+    sim_run(2 * BURST_LENGTH * params.conn_interval_us);
+    CHECK(tx_queued_get(&m_ams_c[0]) == 0);
+    CHECK(sim_ams_server_stats_get()->remote_commands == BURST_LENGTH + 1);
+    CHECK(sim_stats_get()->write_commands == BURST_LENGTH + 1);
+
+    // The first link goes away with its buffers in flight, the second link gets them.
+    commands = sim_ams_server_stats_get()->remote_commands;
+    burst_send();
+    sim_run(0);
+    CHECK(m_ams_c[0].tx_buffers_used == TX_BUFFERS);
+    sim_disconnect(0);
+    CHECK(m_ams_c[0].conn_handle == BLE_CONN_HANDLE_INVALID);
+    CHECK(ble_ams_send_rc_command(&m_ams_c[1], BLE_AMS_REMOTE_COMMAND_PLAY) == NRF_SUCCESS);
+    sim_run(0);
+    CHECK(tx_queued_get(&m_ams_c[1]) == 0);
+    sim_run(2 * params.conn_interval_us);
+    CHECK(sim_ams_server_stats_get()->remote_commands == commands + 1);
+
+    sim_disconnect(1);
+    printf("test_multi_link: passed\n");
+    return EXIT_SUCCESS;
+}
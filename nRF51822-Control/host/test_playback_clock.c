@@ -0,0 +1,144 @@
+/**@file
+ *
+ * @brief Test of the playback position the client extrapolates on the virtual RTC.
+ *
+ * @details Each PlaybackInfo is taken at the virtual time the client decodes it. From there
+ *          ble_ams_c_elapsed_ms_get must follow the rate to the millisecond: standing still at
+ *          rate 0 and while paused, at normal speed and at twice the speed. Frequent calls,
+ *          each rebasing the extrapolation, and calls far apart must not make it drift, nor the
+ *          drift reported against the next PlaybackInfo.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf_error.h"
+#include "ble_ams_c.h"
+#include "ams_app.h"
+#include "sim_softdevice.h"
+#include "sim_ams_server.h"
+#include "sim_app.h"
+#include "sim_test.h"
+
+#define SETTLE_TIME_US                      6000000                                           /**< Time for pairing, discovery and the subscriptions. */
+#define DELIVERY_TIME_US                    5000000                                           /**< Time for a PlaybackInfo to reach the client at the idle connection parameters. */
+#define RUN_TIME_US                         5000000                                           /**< Time the position is extrapolated over. */
+#define REBASE_PERIOD_US                    7000                                              /**< Period of the frequent calls, not a multiple of an RTC tick. */
+#define REBASE_TIME_US                      60000000                                          /**< Time the frequent calls run for. */
+#define SPARSE_PERIOD_US                    300000000                                         /**< Period of the calls far apart, within the RTC overflow period. */
+#define SPARSE_CALLS                        4                                                 /**< Number of calls far apart, spanning several RTC overflows. */
+#define TOLERANCE_MS                        1                                                 /**< Largest error allowed, the result is truncated to milliseconds. */
+
+static uint64_t                         m_info_us;                                        /**< Virtual time the last PlaybackInfo was decoded at. */
+
+static void on_ams_c_evt(ble_ams_c_evt_t * p_evt)
+{
+    if ((p_evt->evt_type == BLE_AMS_C_EVT_PLAYER_UPDATE) &&
+        (p_evt->data.entity_update.attribute_id == BLE_AMS_PLAYER_ATTRIBUTE_ID_PLAYBACK_INFO))
+    {
+        m_info_us = sim_time_us();
+    }
+}
+
+/**@brief Function for sending a PlaybackInfo and returning the virtual time it was decoded at.
+ */
+static uint64_t playback_info_set(const char * p_info)
+{
+    m_info_us = 0;
+    sim_ams_server_attr_set(BLE_AMS_ENTITY_ID_PLAYER, BLE_AMS_PLAYER_ATTRIBUTE_ID_PLAYBACK_INFO, p_info);
+    sim_run(DELIVERY_TIME_US);
+    CHECK(m_info_us != 0);
+    return m_info_us;
+}
+
+/**@brief Function for checking the elapsed time against a position at a virtual time and a rate.
+ */
+static void elapsed_check(int64_t base_ms, uint64_t base_us, int64_t rate_milli)
+{
+    uint32_t elapsed_ms;
+    int64_t  expected_ms = base_ms + (((int64_t)(sim_time_us() - base_us) * rate_milli) / 1000000);
+    int64_t  error_ms;
+
+    CHECK(ble_ams_c_elapsed_ms_get(ams_app_client_get(), &elapsed_ms) == NRF_SUCCESS);
+    error_ms = (int64_t)elapsed_ms - expected_ms;
+    CHECK((error_ms >= -TOLERANCE_MS) && (error_ms <= TOLERANCE_MS));
+}
+
+int main(void)
+{
+    sim_link_params_t   params;
+    ble_ams_c_t *       p_ams;
+    uint64_t            base_us;
+    uint64_t            rx_us;
+    uint32_t            elapsed_ms;
+    int64_t             drift_ms;
+    uint32_t            i;
+
+    sim_app_params_default(&params);
+
+    sim_app_init(&params, sim_ams_server_get(), on_ams_c_evt);
+    sim_ams_server_init();
+    sim_bonds_clear();
+    p_ams = ams_app_client_get();
+
+    sim_connect(SIM_CONN_HANDLE, true);
+    sim_run(SETTLE_TIME_US);
+    CHECK(p_ams->client_state == BLE_AMS_C_STATE_RUNNING);
+    CHECK(p_ams->playback.valid);
+
+    // Paused, the position stands still.
+    base_us = playback_info_set("0,0.0,42.500");
+    CHECK(p_ams->playback.state == BLE_AMS_PLAYBACK_STATE_PAUSED);
+    sim_run(RUN_TIME_US);
+    CHECK(ble_ams_c_elapsed_ms_get(p_ams, &elapsed_ms) == NRF_SUCCESS);
+    CHECK(elapsed_ms == 42500);
+
+    // Rate 0 while playing, e.g. buffering, also stands still.
+    base_us = playback_info_set("1,0.0,43.000");
+    CHECK(p_ams->playback.state == BLE_AMS_PLAYBACK_STATE_PLAYING);
+    sim_run(RUN_TIME_US);
+    CHECK(ble_ams_c_elapsed_ms_get(p_ams, &elapsed_ms) == NRF_SUCCESS);
+    CHECK(elapsed_ms == 43000);
+
+    // Normal speed.
+    base_us = playback_info_set("1,1.0,10.000");
+    sim_run(RUN_TIME_US);
+    elapsed_check(10000, base_us, 1000);
+
+    // Twice the speed.
+    base_us = playback_info_set("3,2.0,20.000");
+    CHECK(p_ams->playback.state == BLE_AMS_PLAYBACK_STATE_FAST_FORWARDING);
+    sim_run(RUN_TIME_US);
+    elapsed_check(20000, base_us, 2000);
+
+    // Every call rebases, frequent calls must not add up rounding errors.
+    base_us = playback_info_set("1,1.0,0.000");
+    for (i = 0; i < REBASE_TIME_US / REBASE_PERIOD_US; i++)
+    {
+        sim_run(REBASE_PERIOD_US);
+        elapsed_check(0, base_us, 1000);
+    }
+
+    base_us = playback_info_set("3,2.0,0.000");
+    for (i = 0; i < REBASE_TIME_US / REBASE_PERIOD_US; i++)
+    {
+        sim_run(REBASE_PERIOD_US);
+        elapsed_check(0, base_us, 2000);
+    }
+
+    // Calls far apart, the RTC overflows in between.
+    base_us = playback_info_set("1,1.0,0.000");
+    for (i = 0; i < SPARSE_CALLS; i++)
+    {
+        sim_run(SPARSE_PERIOD_US);
+        elapsed_check(0, base_us, 1000);
+    }
+
+    // A new PlaybackInfo is compared with the position extrapolated over the rebases.
+    rx_us = playback_info_set("1,1.0,1200.000");
+    drift_ms = p_ams->stats.playback_drift_ms - (1200000 - (int64_t)((rx_us - base_us) / 1000));
+    CHECK((drift_ms >= -TOLERANCE_MS) && (drift_ms <= TOLERANCE_MS));
+
+    sim_disconnect(SIM_CONN_HANDLE);
+    printf("test_playback_clock: passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,174 @@
+/**@file
+ *
+ * @brief Stress test of the remote command queue between two threads.
+ *
+ * @details A producer thread calls ble_ams_send_rc_command as fast as it can, like a button
+ *          handler at a higher interrupt priority, retrying whenever the command queue is full.
+ *          The main thread runs the simulation, where BLE_AMS_C_KICK_IRQn drains the queue into
+ *          the TX queue as on the chip, one connection event at a time once the producer has
+ *          filled the command queue, so the link never keeps up. Each accepted command is the
+ *          next one of a repeating sequence of distinct commands that are never merged, so the
+ *          phone must receive exactly the accepted commands, in order, none lost and none twice.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "nordic_common.h"
+#include "nrf_error.h"
+#include "app_error.h"
+#include "ble_ams_c.h"
+#include "sim_softdevice.h"
+#include "sim_ams_server.h"
+#include "sim_app.h"
+#include "sim_test.h"
+
+#define CONN_INTERVAL_US                    7500                                              /**< Connection interval of the master. */
+#define SETTLE_TIME_US                      2000000                                           /**< Time for discovery, and for the queues to empty. */
+#define STEP_US                             CONN_INTERVAL_US                                  /**< Time the simulation runs between checks. */
+#define COMMAND_COUNT                       50000                                             /**< Commands the producer gets accepted. */
+#define TIMEOUT_S                           60                                                /**< Longest host time the simulation waits for the producer. */
+
+/**@brief Sequence of commands the client neither merges nor cancels. */
+static const uint8_t m_sequence[] =
+{
+    BLE_AMS_REMOTE_COMMAND_NEXT_TRACK,
+    BLE_AMS_REMOTE_COMMAND_REPEAT_MODE,
+    BLE_AMS_REMOTE_COMMAND_PREV_TRACK,
+    BLE_AMS_REMOTE_COMMAND_SHUFFLE_MODE,
+};
+
+static ble_ams_c_t                      m_ams_c;
+static sim_gatt_server_t                m_server;                                         /**< sim_ams_server recording the remote commands it receives. */
+static const sim_gatt_server_t *        mp_ams_server;
+static uint8_t                          m_received[COMMAND_COUNT];                        /**< Remote commands in the order they reached the phone. */
+static uint32_t                         m_received_count;
+static bool                             m_received_wrong;                                 /**< Whether more commands than accepted, or malformed ones, arrived. */
+static uint32_t                         m_queue_full;                                     /**< Number of NRF_ERROR_NO_MEM seen by the producer. */
+static volatile bool                    m_producer_done;
+
+static uint16_t server_write(uint16_t conn_handle, uint16_t handle, const uint8_t * p_data, uint16_t len)
+{
+    if (handle == m_ams_c.service.remote_command_handle)
+    {
+        if ((len != 1) || (m_received_count == COMMAND_COUNT))
+        {
+            m_received_wrong = true;
+        }
+        else
+        {
+            m_received[m_received_count++] = p_data[0];
+        }
+    }
+    return mp_ams_server->write(conn_handle, handle, p_data, len);
+}
+
+static void evt_handler(ble_ams_c_evt_t * p_evt)
+{
+    UNUSED_PARAMETER(p_evt);
+}
+
+/**@brief Function for queuing the command sequence from the producer thread.
+ */
+static void * producer_run(void * p_arg)
+{
+    uint32_t accepted = 0;
+
+    UNUSED_PARAMETER(p_arg);
+
+    while (accepted < COMMAND_COUNT)
+    {
+        uint32_t err_code = ble_ams_send_rc_command(&m_ams_c, m_sequence[accepted % sizeof(m_sequence)]);
+
+        if (err_code == NRF_SUCCESS)
+        {
+            accepted++;
+        }
+        else if (err_code == NRF_ERROR_NO_MEM)
+        {
+            m_queue_full++;
+            sched_yield();
+        }
+        else
+        {
+            APP_ERROR_HANDLER(err_code);
+        }
+    }
+
+    m_producer_done = true;
+    return NULL;
+}
+
+int main(void)
+{
+    static ble_ams_c_t * const clients[] = { &m_ams_c };
+    sim_link_params_t params;
+    ble_ams_c_init_t  init;
+    pthread_t         producer;
+    time_t            start;
+    uint32_t          i;
+
+    // The fastest link, but one packet per connection event and a single TX buffer.
+    sim_app_params_default(&params);
+    params.conn_interval_us  = CONN_INTERVAL_US;
+    params.packets_per_event = 1;
+    params.tx_buffers        = 1;
+
+    mp_ams_server  = sim_ams_server_get();
+    m_server       = *mp_ams_server;
+    m_server.write = server_write;
+
+    sim_bonds_clear();
+    sim_ams_server_init();
+    sim_ams_server_rc_write_cmd_set(true);
+    sim_app_clients_init(&params, &m_server, clients, 1);
+
+    memset(&init, 0, sizeof(init));
+    init.evt_handler   = evt_handler;
+    init.error_handler = sim_app_error_handler;
+    init.tx_policy     = BLE_AMS_C_TX_POLICY_REJECT;
+    CHECK(ble_ams_c_init(&m_ams_c, &init) == NRF_SUCCESS);
+
+    sim_connect(SIM_CONN_HANDLE, true);
+    sim_run(SETTLE_TIME_US);
+    CHECK(m_ams_c.client_state == BLE_AMS_C_STATE_RUNNING);
+
+    CHECK(pthread_create(&producer, NULL, producer_run, NULL) == 0);
+
+    start = time(NULL);
+    while (!m_producer_done)
+    {
+        while (!m_producer_done &&
+               ((m_ams_c.cmd_put_index - m_ams_c.cmd_get_index) < BLE_AMS_C_CMD_QUEUE_SIZE))
+        {
+            CHECK(time(NULL) - start < TIMEOUT_S);
+            sched_yield();
+        }
+        CHECK(!m_received_wrong);
+        sim_run(STEP_US);
+    }
+    CHECK(pthread_join(producer, NULL) == 0);
+
+    // At most the command and TX queues are left to send.
+    sim_run(SETTLE_TIME_US);
+
+    // Every accepted command arrived once, in order, and the queue did run full.
+    CHECK(!m_received_wrong);
+    CHECK(m_received_count == COMMAND_COUNT);
+    for (i = 0; i < COMMAND_COUNT; i++)
+    {
+        CHECK(m_received[i] == m_sequence[i % sizeof(m_sequence)]);
+    }
+    CHECK(m_queue_full > 0);
+    CHECK(m_ams_c.stats.rc_queue_full == m_queue_full);
+    CHECK(m_ams_c.stats.tx_dropped == 0);
+    CHECK(m_ams_c.stats.rc_merged == 0);
+    CHECK(m_ams_c.stats.rc_cancelled == 0);
+
+    sim_disconnect(SIM_CONN_HANDLE);
+    printf("test_rc_queue_stress: passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+/**@file
+ *
+ * @brief Test of the service handles a bonded master's discovery leaves in flash.
+ *
+ * @details The first connection discovers AMS and Service Changed, the record is written once
+ *          the link is gone. A bonded reconnection takes the handles from the record, but only
+ *          reports them once the link is encrypted. A Service Changed indication then discovers
+ *          the service again, as the table is unchanged nothing is written. Once the server's
+ *          table changes between connections, the indication on the next one moves the client to
+ *          the new handles and the new record is written.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "nrf_error.h"
+#include "ble_ams_c.h"
+#include "ams_app.h"
+#include "sim_softdevice.h"
+#include "sim_ams_server.h"
+#include "sim_app.h"
+#include "sim_test.h"
+
+#define SETTLE_TIME_US                      6000000                                           /**< Time for pairing, discovery and the subscriptions. */
+#define SERVICE_CHANGED_HANDLE              8                                                 /**< Handle of the Service Changed value in the table of sim_ams_server. */
+
+static uint32_t                         m_discover_complete;                              /**< Number of BLE_AMS_C_EVT_DISCOVER_COMPLETE events. */
+
+static void on_ams_c_evt(ble_ams_c_evt_t * p_evt)
+{
+    if (p_evt->evt_type == BLE_AMS_C_EVT_DISCOVER_COMPLETE)
+    {
+        m_discover_complete++;
+    }
+}
+
+int main(void)
+{
+    static const uint8_t all_handles[] = { 0x01, 0x00, 0xFF, 0xFF };
+    sim_link_params_t    params;
+    ble_ams_c_t *        p_ams;
+    uint32_t             discovery_requests;
+    uint32_t             record_bytes;
+    uint32_t             remote_commands;
+
+    sim_app_params_default(&params);
+
+    sim_bonds_clear();
+    sim_app_init(&params, sim_ams_server_get(), on_ams_c_evt);
+    sim_ams_server_init();
+    p_ams = ams_app_client_get();
+
+    // A new bond, the discovered record is written on disconnection.
+    sim_connect(SIM_CONN_HANDLE, true);
+    sim_run(SETTLE_TIME_US);
+    CHECK(m_discover_complete == 1);
+    discovery_requests = sim_stats_get()->requests;
+    sim_disconnect(SIM_CONN_HANDLE);
+    record_bytes = p_ams->stats.flash_bytes_written;
+    CHECK(record_bytes > 0);
+    CHECK(sim_stats_get()->flash_bytes_written == record_bytes);
+
+    // The bonded master's record is used once the link is encrypted, without a discovery, then
+    // dropped and discovered again unchanged.
+    sim_stats_clear();
+    m_discover_complete = 0;
+    sim_connect(SIM_CONN_HANDLE, true);
+    CHECK(m_discover_complete == 0);
+    sim_run(SETTLE_TIME_US);
+    CHECK(m_discover_complete == 1);
+    CHECK(sim_stats_get()->requests < discovery_requests);
+
+    // An indication on another handle is confirmed but not taken for Service Changed.
+    CHECK(sim_hvx_send(SIM_CONN_HANDLE,
+                       SERVICE_CHANGED_HANDLE - 1,
+                       BLE_GATT_HVX_INDICATION,
+                       all_handles,
+                       sizeof(all_handles)) == NRF_SUCCESS);
+    sim_run(SETTLE_TIME_US);
+    CHECK(p_ams->stats.service_changed == 0);
+    CHECK(m_discover_complete == 1);
+
+    CHECK(sim_hvx_send(SIM_CONN_HANDLE,
+                       SERVICE_CHANGED_HANDLE,
+                       BLE_GATT_HVX_INDICATION,
+                       all_handles,
+                       sizeof(all_handles)) == NRF_SUCCESS);
+    sim_run(SETTLE_TIME_US);
+    CHECK(p_ams->stats.service_changed == 1);
+    CHECK(m_discover_complete == 2);
+
+    sim_disconnect(SIM_CONN_HANDLE);
+    CHECK(p_ams->stats.flash_bytes_written == 0);
+    CHECK(sim_stats_get()->flash_bytes_written == 0);
+
+    // The table changes while disconnected, the server indicates it in the first connection
+    // event, before the link is encrypted: the stale handles are never reported, and remote
+    // commands reach the moved characteristic.
+    sim_stats_clear();
+    sim_ams_server_table_change();
+    sim_connect(SIM_CONN_HANDLE, true);
+    sim_run(SETTLE_TIME_US);
+    CHECK(p_ams->stats.service_changed == 2);
+    CHECK(m_discover_complete == 3);
+
+    remote_commands = sim_ams_server_stats_get()->remote_commands;
+    CHECK(ble_ams_send_rc_command(p_ams, BLE_AMS_REMOTE_COMMAND_PAUSE) == NRF_SUCCESS);
+    sim_run(SETTLE_TIME_US);
+    CHECK(sim_ams_server_stats_get()->remote_commands == remote_commands + 1);
+
+    sim_disconnect(SIM_CONN_HANDLE);
+    CHECK(p_ams->stats.flash_bytes_written == record_bytes);
+    CHECK(sim_stats_get()->flash_bytes_written == record_bytes);
+
+    printf("test_service_store: passed\n");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,169 @@
+/**@file
+ *
+ * @brief Test of the DROP_OLDEST TX policy while the client's own requests are queued.
+ *
+ * @details Remote commands flood the TX queue right after discovery, while the CCCD and
+ *          subscription writes wait in it, and again while an Entity Attribute read is queued.
+ *          Only remote commands may be discarded: the subscriptions must be acknowledged, the
+ *          long read must complete and the client must go idle.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "nrf_error.h"
+#include "app_error.h"
+#include "ble_ams_c.h"
+#include "sim_softdevice.h"
+#include "sim_ams_server.h"
+#include "sim_app.h"
+#include "sim_test.h"
+
+#define SETTLE_TIME_US                      3000000                                           /**< Time for the client to work through its queue. */
+#define MESSAGE_BUFFER_SIZE                 64                                                /**< Size of the buffer for long reads. */
+#define LONG_TITLE                          "A Title Longer Than One Entity Update Notification"
+
+static ble_ams_c_t                      m_ams_c;
+static uint8_t                          m_message_buffer[MESSAGE_BUFFER_SIZE];
+static bool                             m_flood_on_truncated;                             /**< Whether to flood once a truncated Track update arrives. */
+static uint32_t                         m_subscribed_count;                               /**< Number of BLE_AMS_C_EVT_ENTITY_UPDATE_SUBSCRIBED events. */
+static uint32_t                         m_track_updates;
+static uint32_t                         m_title_reads;                                    /**< Number of times LONG_TITLE has been read in full. */
+
+/**@brief Function for filling the remote command queue of the application.
+ *
+ * @details Alternating Play and Volume Up are neither merged nor cancelled, so every command
+ *          takes a TX queue entry, and they leave the Track entity alone.
+ */
+static void rc_command_flood(void)
+{
+    uint32_t i;
+
+    for (i = 0; i < BLE_AMS_C_CMD_QUEUE_SIZE; i++)
+    {
+        ble_ams_remote_command_values_t cmd = (i & 1) ? BLE_AMS_REMOTE_COMMAND_VOLUME_UP
+                                                      : BLE_AMS_REMOTE_COMMAND_PLAY;
+
+        CHECK(ble_ams_send_rc_command(&m_ams_c, cmd) == NRF_SUCCESS);
+    }
+}
+
+static void on_ams_c_evt(ble_ams_c_evt_t * p_evt)
+{
+    static const uint8_t track_attrs[] =
+    {
+        BLE_AMS_TRACK_ATTRIBUTE_ID_ARTIST,
+        BLE_AMS_TRACK_ATTRIBUTE_ID_ALBUM,
+        BLE_AMS_TRACK_ATTRIBUTE_ID_TITLE,
+        BLE_AMS_TRACK_ATTRIBUTE_ID_DURATION
+    };
+    static const uint8_t queue_attrs[] =
+    {
+        BLE_AMS_QUEUE_ATTRIBUTE_ID_INDEX,
+        BLE_AMS_QUEUE_ATTRIBUTE_ID_COUNT
+    };
+
+    switch (p_evt->evt_type)
+    {
+        case BLE_AMS_C_EVT_DISCOVER_COMPLETE:
+            APP_ERROR_CHECK(ble_ams_c_enable_notif_remote_control(&m_ams_c));
+            APP_ERROR_CHECK(ble_ams_c_entity_update_subscribe(&m_ams_c,
+                                                              BLE_AMS_ENTITY_ID_TRACK,
+                                                              track_attrs,
+                                                              sizeof(track_attrs)));
+            APP_ERROR_CHECK(ble_ams_c_entity_update_subscribe(&m_ams_c,
+                                                              BLE_AMS_ENTITY_ID_QUEUE,
+                                                              queue_attrs,
+                                                              sizeof(queue_attrs)));
+            rc_command_flood();
+            break;
+
+        case BLE_AMS_C_EVT_ENTITY_UPDATE_SUBSCRIBED:
+            CHECK(p_evt->data.error_code == NRF_SUCCESS);
+            m_subscribed_count++;
+            break;
+
+        case BLE_AMS_C_EVT_TRACK_UPDATE:
+            m_track_updates++;
+            if (m_flood_on_truncated &&
+                (p_evt->data.entity_update.entity_update_flags & BLE_AMS_ENTITY_UPDATE_FLAG_TRUNCATED))
+            {
+                m_flood_on_truncated = false;
+                rc_command_flood();
+            }
+            break;
+
+        case BLE_AMS_C_EVT_ENTITY_ATTRIBUTE_READ:
+            if ((p_evt->data.entity_attribute.attribute_id == BLE_AMS_TRACK_ATTRIBUTE_ID_TITLE) &&
+                (p_evt->data.entity_attribute.value_len == strlen(LONG_TITLE)) &&
+                (memcmp(p_evt->data.entity_attribute.p_value, LONG_TITLE, strlen(LONG_TITLE)) == 0))
+            {
+                m_title_reads++;
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/**@brief Function for checking that the client has nothing left to do.
+ */
+static void client_idle_check(void)
+{
+    CHECK(m_ams_c.tx_insert_index == m_ams_c.tx_index);
+    CHECK(m_ams_c.subscribe_pending == 0);
+    CHECK(m_ams_c.attr_read.current == 0);
+    CHECK(m_ams_c.attr_read.pending == 0);
+    CHECK(!m_ams_c.busy);
+}
+
+int main(void)
+{
+    static ble_ams_c_t * const clients[] = { &m_ams_c };
+    sim_link_params_t params;
+    ble_ams_c_init_t  init;
+    uint32_t          dropped;
+
+    sim_app_params_default(&params);
+
+    sim_bonds_clear();
+    sim_ams_server_init();
+    sim_app_clients_init(&params, sim_ams_server_get(), clients, 1);
+
+    memset(&init, 0, sizeof(init));
+    init.evt_handler         = on_ams_c_evt;
+    init.error_handler       = sim_app_error_handler;
+    init.message_buffer_size = sizeof(m_message_buffer);
+    init.p_message_buffer    = m_message_buffer;
+    init.tx_policy           = BLE_AMS_C_TX_POLICY_DROP_OLDEST;
+    init.latency_policy      = BLE_AMS_C_LATENCY_POLICY_WAKE_ON_ACTIVITY;
+    init.idle_local_latency  = 3;
+    CHECK(ble_ams_c_init(&m_ams_c, &init) == NRF_SUCCESS);
+
+    // Flood while the CCCD and subscription writes are queued.
+    sim_connect(SIM_CONN_HANDLE, true);
+    sim_run(SETTLE_TIME_US);
+
+    CHECK(m_ams_c.client_state == BLE_AMS_C_STATE_RUNNING);
+    CHECK(m_ams_c.stats.tx_dropped > 0);
+    CHECK(m_subscribed_count == 1);
+    CHECK(m_track_updates > 0);
+    CHECK(sim_ams_server_stats_get()->remote_commands > 0);
+    client_idle_check();
+
+    // Flood while the Entity Attribute write and read of a long title are queued.
+    dropped              = m_ams_c.stats.tx_dropped;
+    m_flood_on_truncated = true;
+    sim_ams_server_attr_set(BLE_AMS_ENTITY_ID_TRACK, BLE_AMS_TRACK_ATTRIBUTE_ID_TITLE, LONG_TITLE);
+    sim_run(SETTLE_TIME_US);
+
+    CHECK(!m_flood_on_truncated);
+    CHECK(m_ams_c.stats.tx_dropped > dropped);
+    CHECK(m_title_reads == 1);
+    client_idle_check();
+
+    sim_disconnect(SIM_CONN_HANDLE);
+    printf("test_tx_policy: passed\n");
+    return EXIT_SUCCESS;
+}
@@ -33,9 +33,11 @@
 #include "ble_srv_common.h"
 #include "ble_advdata.h"
 #include "ble_conn_params.h"
+#include "ams_app.h"
 #include "boards.h"
 #include "softdevice_handler.h"
 #include "app_timer.h"
+#include "app_scheduler.h"
 #include "nrf_gpio.h"
 #include "led.h"
 #include "device_manager.h"
@@ -55,13 +57,19 @@
 
 #define DEVICE_NAME                          "AMS"                               /**< Name of device. Will be included in the advertising data. */
 #define MANUFACTURER_NAME                    "Oltica"                      /**< Manufacturer. Will be passed to Device Information Service. */
-#define APP_ADV_INTERVAL                     40                                         /**< The advertising interval (in units of 0.625 ms. This value corresponds to 25 ms). */
-#define APP_ADV_TIMEOUT_IN_SECONDS           0                                        /**< The advertising timeout in units of seconds. */
+#define APP_ADV_DIRECTED_ENABLED             1                                          /**< Advertise directed to the last bonded central right after it disconnects (high duty, 1.28 seconds). */
+#define APP_ADV_FAST_INTERVAL                40                                         /**< The fast advertising interval (in units of 0.625 ms. This value corresponds to 25 ms). */
+#define APP_ADV_FAST_TIMEOUT_IN_SECONDS      30                                         /**< The fast advertising timeout in units of seconds, slow advertising follows. */
+#define APP_ADV_SLOW_INTERVAL                1636                                       /**< The slow advertising interval (in units of 0.625 ms. This value corresponds to 1022.5 ms). */
+#define APP_ADV_SLOW_TIMEOUT_IN_SECONDS      0                                          /**< The slow advertising timeout in units of seconds, 0 advertises until a central connects. */
 
 #define APP_TIMER_PRESCALER                  0                                          /**< Value of the RTC1 PRESCALER register. */
 #define APP_TIMER_MAX_TIMERS                 4                                          /**< Maximum number of simultaneously created timers. */
 #define APP_TIMER_OP_QUEUE_SIZE              5                                          /**< Size of timer operation queues. */
 
+#define SCHED_MAX_EVENT_DATA_SIZE            BLE_AMS_C_SCHED_EVENT_SIZE                 /**< Maximum size of scheduler events, the AMS client defers notifications. */
+#define SCHED_QUEUE_SIZE                     8                                          /**< Maximum number of events in the scheduler queue. */
+
 #define BATTERY_LEVEL_MEAS_INTERVAL          APP_TIMER_TICKS(2000, APP_TIMER_PRESCALER) /**< Battery level measurement interval (ticks). */
 
 #define HEART_RATE_MEAS_INTERVAL             APP_TIMER_TICKS(1000, APP_TIMER_PRESCALER) /**< Heart rate measurement interval (ticks). */
@@ -73,13 +81,6 @@
 
 #define BUTTON_DETECTION_DELAY               APP_TIMER_TICKS(5, APP_TIMER_PRESCALER)   /**< Delay from a GPIOTE event until a button is reported as pushed (in number of timer ticks). */
 
-#define MESSAGE_BUFFER_SIZE             18
-
-#define MIN_CONN_INTERVAL                    MSEC_TO_UNITS(50, UNIT_1_25_MS)           /**< Minimum acceptable connection interval (0.5 seconds). */
-#define MAX_CONN_INTERVAL                    MSEC_TO_UNITS(500, UNIT_1_25_MS)          /**< Maximum acceptable connection interval (1 second). */
-#define SLAVE_LATENCY                        0                                          /**< Slave latency. */
-#define CONN_SUP_TIMEOUT                     MSEC_TO_UNITS(4000, UNIT_10_MS)            /**< Connection supervisory timeout (4 seconds). */
-
 #define FIRST_CONN_PARAMS_UPDATE_DELAY       APP_TIMER_TICKS(5000, APP_TIMER_PRESCALER) /**< Time from initiating event (connect or start of notification) to first time sd_ble_gap_conn_param_update is called (5 seconds). */
 #define NEXT_CONN_PARAMS_UPDATE_DELAY        APP_TIMER_TICKS(30000, APP_TIMER_PRESCALER)/**< Time between each call to sd_ble_gap_conn_param_update after the first call (30 seconds). */
 #define MAX_CONN_PARAMS_UPDATE_COUNT         3                                          /**< Number of attempts before giving up the connection parameter negotiation. */
@@ -92,17 +93,30 @@
 #define SEC_PARAM_MIN_KEY_SIZE               7                                          /**< Minimum encryption key size. */
 #define SEC_PARAM_MAX_KEY_SIZE               16                                         /**< Maximum encryption key size. */
 
+#define STORAGE_LAYOUT_VERSION               (0x414D5300 | DEVICE_MANAGER_APP_CONTEXT_SIZE) /**< Flash layout of the bonds, changes with the size of the Device Manager application context. */
+
 #define DEAD_BEEF                            0xDEADBEEF                                 /**< Value used as error code on stack dump, can be used to identify stack location on stack unwind. */
 
 
-static ble_ams_c_t                      m_ams_c;
-static uint8_t                          m_apple_message_buffer[MESSAGE_BUFFER_SIZE];
 static ble_gap_adv_params_t             m_adv_params;
 static uint8_t                          m_ams_uuid_type;
 
+/**@brief Advertising phases, entered in this order until a central connects. */
+typedef enum
+{
+    ADV_MODE_DIRECTED,                                                                  /**< High duty directed advertising to the last bonded central. */
+    ADV_MODE_FAST,                                                                      /**< Fast undirected advertising. */
+    ADV_MODE_SLOW                                                                       /**< Slow undirected advertising. */
+} adv_mode_t;
+
+static adv_mode_t                            m_adv_mode = ADV_MODE_FAST;                /**< Advertising phase used by the next advertising_start. */
+static ble_gap_addr_t                        m_peer_addr;                               /**< Address of the current or last central. */
+static bool                                  m_peer_addr_valid = false;                 /**< Whether m_peer_addr belongs to a bonded central. */
+
 static bool                                  m_memory_access_in_progress = false;       /**< Flag to keep track of ongoing operations on persistent memory. */
 static dm_application_instance_t             m_app_handle;                              /**< Application identifier allocated by device manager */
-static dm_handle_t                           m_peer_handle;                                       /**< Identifes the peer that is currently connected. */
+static pstorage_handle_t                     m_layout_handle;                           /**< Flash block holding the layout version of the bonds. */
+static uint32_t                              m_layout_version[PSTORAGE_MIN_BLOCK_SIZE / sizeof(uint32_t)]; /**< Layout version as written, must stay valid until the flash operation completes. */
 static void ble_evt_dispatch(ble_evt_t * p_ble_evt);
 
 static void sys_evt_dispatch(uint32_t sys_evt);
@@ -182,11 +196,11 @@ static void button_event_handler(uint8_t pin_no, uint8_t button_action)
         switch (pin_no)
         {
             case BUTTON_0:
-                ble_ams_send_rc_command(&m_ams_c, BLE_AMS_REMOTE_COMMAND_TOGGLE_PLAY_PAUSE);
+                ble_ams_send_rc_command(ams_app_client_get(), BLE_AMS_REMOTE_COMMAND_TOGGLE_PLAY_PAUSE);
                 break;
                 
             case BUTTON_1:
-                ble_ams_send_rc_command(&m_ams_c, BLE_AMS_REMOTE_COMMAND_NEXT_TRACK);
+                ble_ams_send_rc_command(ams_app_client_get(), BLE_AMS_REMOTE_COMMAND_NEXT_TRACK);
                 break;
                 
             default:
@@ -213,6 +227,14 @@ static void timers_init(void)
 }
 
 
+/**@brief Function for the Event Scheduler initialization.
+ */
+static void scheduler_init(void)
+{
+    APP_SCHED_INIT(SCHED_MAX_EVENT_DATA_SIZE, SCHED_QUEUE_SIZE);
+}
+
+
 /**@brief Function for the GAP initialization.
  *
  * @details This function sets up all the necessary GAP (Generic Access Profile) parameters of the
@@ -236,10 +258,10 @@ static void gap_params_init(void)
 
     memset(&gap_conn_params, 0, sizeof(gap_conn_params));
 
-    gap_conn_params.min_conn_interval = MIN_CONN_INTERVAL;
-    gap_conn_params.max_conn_interval = MAX_CONN_INTERVAL;
-    gap_conn_params.slave_latency     = SLAVE_LATENCY;
-    gap_conn_params.conn_sup_timeout  = CONN_SUP_TIMEOUT;
+    gap_conn_params.min_conn_interval = AMS_APP_IDLE_MIN_CONN_INTERVAL;
+    gap_conn_params.max_conn_interval = AMS_APP_IDLE_MAX_CONN_INTERVAL;
+    gap_conn_params.slave_latency     = AMS_APP_IDLE_SLAVE_LATENCY;
+    gap_conn_params.conn_sup_timeout  = AMS_APP_CONN_SUP_TIMEOUT;
 
     err_code = sd_ble_gap_ppcp_set(&gap_conn_params);
     APP_ERROR_CHECK(err_code);
@@ -250,12 +272,15 @@ static void gap_params_init(void)
  *
  * @details Encodes the required advertising data and passes it to the stack.
  *          Also builds a structure to be passed to the stack when starting advertising.
+ *
+ * @param[in]   adv_flags   Advertising flags, general discoverable unless only bonded centrals
+ *                          may connect.
  */
-static void advertising_init(void)
+static void advertising_init(uint8_t adv_flags)
 {
     uint32_t      err_code;
     ble_advdata_t advdata;
-    uint8_t       flags = BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE;
+    uint8_t       flags = adv_flags;
     ble_uuid_t    ams_uuid;
     
     ams_uuid.uuid = ((ble_ams_base_uuid128.uuid128[12]) | (ble_ams_base_uuid128.uuid128[13] << 8));
@@ -277,35 +302,13 @@ static void advertising_init(void)
     APP_ERROR_CHECK(err_code);
 }
 
-static void on_ams_c_evt(ble_ams_c_evt_t * p_evt)
-{
-    uint32_t err_code = NRF_SUCCESS;
-    
-    switch (p_evt->evt_type)
-    {
-        case BLE_AMS_C_EVT_DISCOVER_COMPLETE:
-            err_code = dm_security_setup_req(&m_peer_handle);
-            APP_ERROR_CHECK(err_code);
-            break;
-            
-        default:
-            //No implementation needed
-            break;
-    }
-}
-
-static void apple_notification_error_handler(uint32_t nrf_error)
-{
-    APP_ERROR_HANDLER(nrf_error);
-}
-
 /**@brief Function for initializing the services that will be used by the application.
  *
  * @details Initialize the Heart Rate, Battery and Device Information services.
  */
 static void services_init(void)
 {
-    ble_ams_c_init_t  ams_init_obj;
+    ams_app_init_t    ams_init;
     ble_uuid_t        service_uuid;
     uint32_t          err_code;
     
@@ -321,22 +324,14 @@ static void services_init(void)
     err_code = sd_ble_uuid_vs_add(&ble_ams_ea_base_uuid128, &service_uuid.type);
     APP_ERROR_CHECK(err_code);
     
-    memset(&ams_init_obj, 0, sizeof(ams_init_obj));
-    memset(m_apple_message_buffer, 0, MESSAGE_BUFFER_SIZE);
-    
-    ams_init_obj.evt_handler         = on_ams_c_evt;
-    ams_init_obj.message_buffer_size = MESSAGE_BUFFER_SIZE;
-    ams_init_obj.p_message_buffer    = m_apple_message_buffer;
-    ams_init_obj.error_handler       = apple_notification_error_handler;
+    ams_init.timer_prescaler = APP_TIMER_PRESCALER;
+    ams_init.evt_handler     = NULL;
     
-    err_code = ble_ams_c_init(&m_ams_c, &ams_init_obj);
-    APP_ERROR_CHECK(err_code);
-    
-    err_code = ble_ams_c_service_load(&m_ams_c);
-    APP_ERROR_CHECK(err_code);
+    ams_app_init(&ams_init);
 }
 
-/**@brief Function for initializing the Connection Parameters module.
+/**@brief Function for initializing the Connection Parameters module, the preferred parameters
+ *        are switched with the AMS activity by ams_app.
  */
 static void conn_params_init(void)
 {
@@ -350,7 +345,7 @@ static void conn_params_init(void)
     cp_init.next_conn_params_update_delay  = NEXT_CONN_PARAMS_UPDATE_DELAY;
     cp_init.max_conn_params_update_count   = MAX_CONN_PARAMS_UPDATE_COUNT;
     cp_init.start_on_notify_cccd_handle    = BLE_GATT_HANDLE_INVALID;
-    cp_init.disconnect_on_fail             = true;
+    cp_init.disconnect_on_fail             = false;
     cp_init.evt_handler                    = NULL;
     cp_init.error_handler                  = conn_params_error_handler;
     
@@ -368,17 +363,73 @@ static uint32_t device_manager_evt_handler(dm_handle_t const    * p_handle,
                                            api_result_t           event_result)
 {
     APP_ERROR_CHECK(event_result);
-    ble_ams_c_on_device_manager_evt(&m_ams_c, p_handle, p_event);
-    switch(p_event->event_id)
+    if (p_event->event_id == DM_EVT_LINK_SECURED)
     {
-        case DM_EVT_CONNECTION:
-            m_peer_handle = (*p_handle);
-            break;
+        // Every central is bonded, so the link may be resumed by directed advertising.
+        m_peer_addr_valid = true;
     }
+    
+    ams_app_on_dm_evt(p_handle, p_event);
     return NRF_SUCCESS;
 }
 
 
+/**@brief Function for handling the result of the flash operations on the layout version.
+ */
+static void storage_layout_callback(pstorage_handle_t * p_handle,
+                                    uint8_t             op_code,
+                                    uint32_t            result,
+                                    uint8_t           * p_data,
+                                    uint32_t            data_len)
+{
+    APP_ERROR_CHECK(result);
+}
+
+
+/**@brief Function for deleting bonds stored by a firmware with another flash layout.
+ *
+ * @details The Device Manager stores the application context of a bond within the bond's
+ *          block, so bonds written with another DEVICE_MANAGER_APP_CONTEXT_SIZE cannot be read
+ *          back. The layout version is kept in a block registered right after the Device
+ *          Manager, in the page that earlier firmware used for the AMS handle cache, so the
+ *          Device Manager's page does not move. Bonds are deleted if the version differs, e.g.
+ *          after an update from such firmware, and the centrals pair again.
+ */
+static void storage_layout_check(void)
+{
+    uint32_t                err_code;
+    pstorage_module_param_t param;
+    
+    param.block_size  = sizeof(m_layout_version);
+    param.block_count = 1;
+    param.cb          = storage_layout_callback;
+    
+    err_code = pstorage_register(&param, &m_layout_handle);
+    APP_ERROR_CHECK(err_code);
+    
+    err_code = pstorage_load((uint8_t *)m_layout_version, &m_layout_handle, sizeof(m_layout_version), 0);
+    APP_ERROR_CHECK(err_code);
+    
+    if (m_layout_version[0] == STORAGE_LAYOUT_VERSION)
+    {
+        return;
+    }
+    
+    err_code = dm_device_delete_all(&m_app_handle);
+    APP_ERROR_CHECK(err_code);
+    
+    memset(m_layout_version, 0, sizeof(m_layout_version));
+    m_layout_version[0] = STORAGE_LAYOUT_VERSION;
+    
+    // Queued behind the deletion of the bonds, pstorage runs the flash operations in order.
+    err_code = pstorage_clear(&m_layout_handle, sizeof(m_layout_version));
+    APP_ERROR_CHECK(err_code);
+    
+    err_code = pstorage_store(&m_layout_handle, (uint8_t *)m_layout_version, sizeof(m_layout_version), 0);
+    APP_ERROR_CHECK(err_code);
+}
+
+
 /**@brief Function for the Device Manager initialization.
  */
 static void device_manager_init(void)
@@ -412,6 +463,8 @@ static void device_manager_init(void)
     
     err_code = dm_register(&m_app_handle, &register_param);
     APP_ERROR_CHECK(err_code);
+    
+    storage_layout_check();
 }
 
 
@@ -484,17 +537,66 @@ static void application_timers_start(void)
  */
 static void advertising_start(void)
 {
-    uint32_t err_code;
+    uint32_t            err_code;
+    ble_gap_whitelist_t whitelist;
+    ble_gap_addr_t    * p_whitelist_addr[BLE_GAP_WHITELIST_ADDR_MAX_COUNT];
+    ble_gap_irk_t     * p_whitelist_irk[BLE_GAP_WHITELIST_IRK_MAX_COUNT];
     
     // Initialize advertising parameters (used when starting advertising).
     memset(&m_adv_params, 0, sizeof(m_adv_params));
     
-    m_adv_params.type        = BLE_GAP_ADV_TYPE_ADV_IND;
-    m_adv_params.p_peer_addr = NULL;                           // Undirected advertisement.
-    m_adv_params.fp          = BLE_GAP_ADV_FP_ANY;
-    
-    m_adv_params.interval = APP_ADV_INTERVAL;
-    m_adv_params.timeout  = 0;
+    if ((m_adv_mode == ADV_MODE_DIRECTED) && m_peer_addr_valid)
+    {
+        // The stack ends high duty directed advertising after 1.28 seconds with a timeout event.
+        // A phone using a resolvable address only answers while that address is still current.
+        m_adv_params.type        = BLE_GAP_ADV_TYPE_ADV_DIRECT_IND;
+        m_adv_params.p_peer_addr = &m_peer_addr;
+        m_adv_params.fp          = BLE_GAP_ADV_FP_ANY;
+        m_adv_params.interval    = 0;
+        m_adv_params.timeout     = 0;
+    }
+    else
+    {
+        if (m_adv_mode == ADV_MODE_DIRECTED)
+        {
+            m_adv_mode = ADV_MODE_FAST;
+        }
+        
+        // Only let bonded centrals connect, unless there are none yet.
+        whitelist.addr_count = BLE_GAP_WHITELIST_ADDR_MAX_COUNT;
+        whitelist.irk_count  = BLE_GAP_WHITELIST_IRK_MAX_COUNT;
+        whitelist.pp_addrs   = p_whitelist_addr;
+        whitelist.pp_irks    = p_whitelist_irk;
+        
+        err_code = dm_whitelist_create(&m_app_handle, &whitelist);
+        APP_ERROR_CHECK(err_code);
+        
+        m_adv_params.type        = BLE_GAP_ADV_TYPE_ADV_IND;
+        m_adv_params.p_peer_addr = NULL;                           // Undirected advertisement.
+        
+        if ((whitelist.addr_count != 0) || (whitelist.irk_count != 0))
+        {
+            advertising_init(BLE_GAP_ADV_FLAG_BR_EDR_NOT_SUPPORTED);
+            m_adv_params.fp          = BLE_GAP_ADV_FP_FILTER_CONNREQ;
+            m_adv_params.p_whitelist = &whitelist;
+        }
+        else
+        {
+            advertising_init(BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE);
+            m_adv_params.fp          = BLE_GAP_ADV_FP_ANY;
+        }
+        
+        if (m_adv_mode == ADV_MODE_FAST)
+        {
+            m_adv_params.interval = APP_ADV_FAST_INTERVAL;
+            m_adv_params.timeout  = APP_ADV_FAST_TIMEOUT_IN_SECONDS;
+        }
+        else
+        {
+            m_adv_params.interval = APP_ADV_SLOW_INTERVAL;
+            m_adv_params.timeout  = APP_ADV_SLOW_TIMEOUT_IN_SECONDS;
+        }
+    }
     
     err_code = sd_ble_gap_adv_start(&m_adv_params);
     APP_ERROR_CHECK(err_code);
@@ -544,6 +646,9 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
             led_stop();
             err_code = app_button_enable();
             m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
+            
+            m_peer_addr       = p_ble_evt->evt.gap_evt.params.connected.peer_addr;
+            m_peer_addr_valid = false;
             break;
             
         case BLE_GAP_EVT_DISCONNECTED:
@@ -553,15 +658,15 @@ static void on_ble_evt(ble_evt_t * p_ble_evt)
             err_code = app_button_disable();
             APP_ERROR_CHECK(err_code);
             
-            err_code = ble_ams_c_service_store();
-            APP_ERROR_CHECK(err_code);
-            
+            m_adv_mode = APP_ADV_DIRECTED_ENABLED ? ADV_MODE_DIRECTED : ADV_MODE_FAST;
             advertising_start();
             break;
             
         case BLE_GAP_EVT_TIMEOUT:
             if (p_ble_evt->evt.gap_evt.params.timeout.src == BLE_GAP_TIMEOUT_SRC_ADVERTISEMENT)
             {
+                // Move on to the next phase, slow advertising repeats until a central connects.
+                m_adv_mode = (m_adv_mode == ADV_MODE_DIRECTED) ? ADV_MODE_FAST : ADV_MODE_SLOW;
                 advertising_start();
             }
             break;
@@ -592,7 +697,7 @@ static void ble_evt_dispatch(ble_evt_t * p_ble_evt)
 {
     dm_ble_evt_handler(p_ble_evt);
     ble_conn_params_on_ble_evt(p_ble_evt);
-    ble_ams_c_on_ble_evt(&m_ams_c, p_ble_evt);
+    ams_app_on_ble_evt(p_ble_evt);
     on_ble_evt(p_ble_evt);
 }
 
@@ -621,6 +726,7 @@ int main(void)
     uint32_t err_code;
 
     timers_init();
+    scheduler_init();
     gpiote_init();
     buttons_init();
     ble_stack_init();
@@ -629,7 +735,7 @@ int main(void)
     // Initialize Bluetooth Stack parameters.
     gap_params_init();
     services_init();
-    advertising_init();
+    advertising_init(BLE_GAP_ADV_FLAGS_LE_ONLY_GENERAL_DISC_MODE);
     conn_params_init();
 
     // Start advertising.
@@ -638,6 +744,9 @@ int main(void)
     // Enter main loop.
     for (;;)
     {
+        // Process the events deferred to the main loop, e.g. AMS notifications.
+        app_sched_execute();
+
         // Switch to a low power state until an event is available for the application
         err_code = sd_app_evt_wait();
         APP_ERROR_CHECK(err_code);